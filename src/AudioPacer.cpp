@@ -0,0 +1,45 @@
+#include <algorithm>
+#include "AudioPacer.h"
+using namespace std;
+
+AudioPacer::AudioPacer(int sampleRate, int targetSamples, double maxAdjustment)
+    : sampleRate(sampleRate), targetSamples(max(1, targetSamples)), maxAdjustment(maxAdjustment),
+      smoothedFill(targetSamples) {
+}
+
+int AudioPacer::frameSamples() {
+    uint64_t next = (frames + 1) * uint64_t(sampleRate) / 60;
+    int samples = int(next - samplesQueued);
+    samplesQueued = next;
+    frames++;
+    return samples;
+}
+
+chrono::nanoseconds AudioPacer::framePeriod(int queuedSamples) {
+    double nominal = 1e9 / 60;
+    if (queuedSamples == 0 && frames > 60) {
+        underruns++;
+    }
+
+    // The device takes samples in blocks, so one reading jumps by a block;
+    // an average over about 16 frames follows the trend instead
+    smoothedFill += (queuedSamples - smoothedFill) / 16;
+    fillSum += smoothedFill;
+
+    if (queuedSamples < targetSamples / 2) {
+        catchUps++;
+        return chrono::nanoseconds(0);
+    }
+    if (queuedSamples > targetSamples * 2) {
+        catchUps++;
+        return chrono::nanoseconds(int64_t(nominal * 2));
+    }
+
+    // More queued than the target: the device is slower than the emulator,
+    // so frames get longer, and the other way round
+    double adjustment = clamp((smoothedFill - targetSamples) / targetSamples * maxAdjustment * 4,
+                              -maxAdjustment, maxAdjustment);
+    minAdjustment = min(minAdjustment, adjustment);
+    maxAdjustmentSeen = max(maxAdjustmentSeen, adjustment);
+    return chrono::nanoseconds(int64_t(nominal * (1 + adjustment)));
+}
@@ -0,0 +1,62 @@
+#ifndef AUDIO_PACER_H
+#define AUDIO_PACER_H
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Paces emulation by the audio device's clock
+ *
+ * Each emulated frame queues exactly rate / 60 samples, spread evenly. The
+ * host's sleep and the sound card's crystal never agree exactly, so the
+ * queue slowly fills or drains until the audio crackles, or the video
+ * stutters when the front end waits for it. Instead, the queue's fill level
+ * is measured every frame and the frame period is stretched or shortened by
+ * at most maxAdjustment, a fraction of a percent that is not audible or
+ * visible, in proportion to how far a smoothed fill is from the target. In
+ * the long run the emulator then runs at exactly the rate the device
+ * consumes samples.
+ *
+ * If the queue runs low (below half the target) the next frame is due at
+ * once, and if it holds twice the target the period doubles, so a stall of
+ * either clock is caught up within a few frames.
+ */
+class AudioPacer {
+public:
+    /**
+     * @param sampleRate Samples per second of the audio device
+     * @param targetSamples Fill level to hold, i.e. the audio latency
+     * @param maxAdjustment Largest change of the frame period, as a fraction
+     */
+    AudioPacer(int sampleRate, int targetSamples, double maxAdjustment = 0.005);
+
+    /**
+     * Samples the next frame queues; call once per frame
+     */
+    int frameSamples();
+
+    /**
+     * Time until the next frame, given the samples queued now
+     */
+    std::chrono::nanoseconds framePeriod(int queuedSamples);
+
+    int target() const { return targetSamples; }
+    int rate() const { return sampleRate; }
+
+    /* Statistics since construction, for the report on exit */
+    uint64_t frames = 0;
+    uint64_t underruns = 0; // Frames that found the queue empty, after the first second
+    uint64_t catchUps = 0; // Frames run at once or held back by the hard limits
+    double minAdjustment = 0;
+    double maxAdjustmentSeen = 0;
+    double fillSum = 0; // Of the smoothed fill, in samples
+
+private:
+    int sampleRate;
+    int targetSamples;
+    double maxAdjustment;
+    double smoothedFill;
+    uint64_t samplesQueued = 0; // Frames * rate / 60 so far, for the even spread
+};
+
+#endif
@@ -0,0 +1,359 @@
+#include <cstring>
+#include "Chip8Batch.h"
+using namespace std;
+
+/**
+ * Constructor
+ */
+template <typename Q>
+Chip8Batch<Q>::Chip8Batch(size_t lanes, int instructionsPerFrame)
+    : memory(lanes * MEMORY_SIZE), rows(lanes * HEIGHT), registers(16 * lanes), stack(16 * lanes),
+      pc(lanes, START_ADDRESS), I(lanes), sp(lanes), delayTimer(lanes), soundTimer(lanes), keys(lanes),
+      rngState(lanes, Chip8<Q>().rngState), drawFlag(lanes), lanes(lanes), instructionsPerFrame(instructionsPerFrame),
+      fetched(lanes) {}
+
+/**
+ * Load the ROM and fonts into every lane
+ *
+ * The memory image is built by the scalar core so both start identical.
+ */
+template <typename Q>
+bool Chip8Batch<Q>::loadRom(uint8_t const* data, size_t size) {
+    Chip8<Q> image;
+    image.loadFonts();
+    if (!image.loadRom(data, size)) {
+        return false;
+    }
+    for (size_t lane = 0; lane < lanes; lane++) {
+        memcpy(memoryOf(lane), image.memory, MEMORY_SIZE);
+    }
+    return true;
+}
+
+/**
+ * Run one frame on every lane and return the displays
+ */
+template <typename Q>
+uint64_t const* Chip8Batch<Q>::step(uint16_t const* actions) {
+    memcpy(keys.data(), actions, lanes * sizeof(uint16_t));
+    for (int i = 0; i < instructionsPerFrame; i++) {
+        cycle();
+    }
+    updateTimers();
+    return rows.data();
+}
+
+/**
+ * Decrement sound and delay timer by 1 if they are greater than 0
+ */
+template <typename Q>
+void Chip8Batch<Q>::updateTimers() {
+    uint8_t* st = soundTimer.data();
+    uint8_t* dt = delayTimer.data();
+    for (size_t l = 0; l < lanes; l++) {
+        st[l] -= st[l] > 0;
+        dt[l] -= dt[l] > 0;
+    }
+}
+
+/**
+ * Fetch every lane's instruction, then execute each run of consecutive lanes
+ * that share an OP code together
+ */
+template <typename Q>
+void Chip8Batch<Q>::cycle() {
+    for (size_t l = 0; l < lanes; l++) {
+        uint8_t const* mem = &memory[l * MEMORY_SIZE];
+        uint16_t address = pc[l];
+        fetched[l] = (mem[address & 0xFFF] << 8) | mem[(address + 1) & 0xFFF];
+        pc[l] = address + 2;
+    }
+
+    size_t begin = 0;
+    while (begin < lanes) {
+        size_t end = begin + 1;
+        while (end < lanes && fetched[end] == fetched[begin]) {
+            end++;
+        }
+        execute(fetched[begin], begin, end);
+        begin = end;
+    }
+}
+
+/**
+ * Draw a sprite on one lane, as Chip8::OP_Dxyn does
+ */
+template <typename Q>
+void Chip8Batch<Q>::draw(uint8_t x, uint8_t y, uint8_t n, size_t l) {
+    uint8_t* v = &registers[l];
+    uint8_t const* mem = &memory[l * MEMORY_SIZE];
+    uint64_t* display = &rows[l * HEIGHT];
+    uint8_t x_coord = v[x * lanes] % WIDTH;
+    uint8_t y_coord = v[y * lanes] % HEIGHT;
+    v[0xF * lanes] = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        // Bits past the right edge shift out of the row
+        uint64_t sprite = uint64_t(mem[(I[l] + i) & 0xFFF]) << 56 >> x_coord;
+        if (display[y_coord] & sprite) {
+            v[0xF * lanes] = 1;
+        }
+        display[y_coord] ^= sprite;
+        y_coord++;
+
+        if (y_coord + 1 >= HEIGHT) {
+            break;
+        }
+    }
+    drawFlag[l] = 1;
+}
+
+/**
+ * Execute one instruction on lanes [begin, end)
+ *
+ * Each case is a loop over lanes with the same sequence of reads and writes
+ * as the matching Chip8::OP_* handler, so register aliasing (x == y, x == F)
+ * behaves the same.
+ */
+template <typename Q>
+void Chip8Batch<Q>::execute(uint16_t instruction, size_t begin, size_t end) {
+    uint8_t b2 = instruction & 0x00FF;
+    uint8_t x = (instruction >> 8) & 0xF;
+    uint8_t y = (instruction >> 4) & 0xF;
+    uint8_t n = instruction & 0xF;
+    uint8_t kk = b2;
+    uint16_t nnn = instruction & 0x0FFF;
+
+    uint8_t* vx = &registers[x * lanes];
+    uint8_t* vy = &registers[y * lanes];
+    uint8_t* vf = &registers[0xF * lanes];
+    uint8_t* v0 = &registers[0];
+    uint16_t* PC = pc.data();
+
+    switch (instruction >> 12) {
+        case 0:
+            if (b2 == 0xE0) {
+                for (size_t l = begin; l < end; l++) {
+                    memset(&rows[l * HEIGHT], 0, HEIGHT * sizeof(uint64_t));
+                    drawFlag[l] = 1;
+                }
+            }
+            else if (b2 == 0xEE) {
+                for (size_t l = begin; l < end; l++) {
+                    sp[l]--;
+                    PC[l] = stack[(sp[l] & 0xF) * lanes + l];
+                    stack[(sp[l] & 0xF) * lanes + l] = 0;
+                }
+            }
+            break;
+
+        case 1:
+            for (size_t l = begin; l < end; l++) PC[l] = nnn;
+            break;
+
+        case 2:
+            for (size_t l = begin; l < end; l++) {
+                stack[(sp[l] & 0xF) * lanes + l] = PC[l];
+                sp[l]++;
+                PC[l] = nnn;
+            }
+            break;
+
+        case 3:
+            for (size_t l = begin; l < end; l++) PC[l] += vx[l] == kk ? 2 : 0;
+            break;
+
+        case 4:
+            for (size_t l = begin; l < end; l++) PC[l] += vx[l] != kk ? 2 : 0;
+            break;
+
+        case 5:
+            for (size_t l = begin; l < end; l++) PC[l] += vx[l] == vy[l] ? 2 : 0;
+            break;
+
+        case 6:
+            for (size_t l = begin; l < end; l++) vx[l] = kk;
+            break;
+
+        case 7:
+            for (size_t l = begin; l < end; l++) vx[l] += kk;
+            break;
+
+        case 8:
+            switch (n) {
+                case 0:
+                    for (size_t l = begin; l < end; l++) vx[l] = vy[l];
+                    break;
+                case 1:
+                    for (size_t l = begin; l < end; l++) vx[l] |= vy[l];
+                    break;
+                case 2:
+                    for (size_t l = begin; l < end; l++) vx[l] &= vy[l];
+                    break;
+                case 3:
+                    for (size_t l = begin; l < end; l++) vx[l] ^= vy[l];
+                    break;
+                case 4:
+                    for (size_t l = begin; l < end; l++) {
+                        vx[l] += vy[l];
+                        vf[l] = vx[l] < vy[l] ? 1 : 0;
+                    }
+                    break;
+                case 5:
+                    for (size_t l = begin; l < end; l++) {
+                        vf[l] = vx[l] > vy[l] ? 1 : 0;
+                        vx[l] -= vy[l];
+                    }
+                    break;
+                case 6:
+                    for (size_t l = begin; l < end; l++) {
+                        if (Q::CP_SHIFT) {
+                            vx[l] = vy[l];
+                        }
+                        vf[l] = vx[l] & 0x1;
+                        vx[l] >>= 1;
+                    }
+                    break;
+                case 7:
+                    for (size_t l = begin; l < end; l++) {
+                        vf[l] = vy[l] > vx[l] ? 1 : 0;
+                        vx[l] = vy[l] - vx[l];
+                    }
+                    break;
+                case 0xE:
+                    for (size_t l = begin; l < end; l++) {
+                        if (Q::CP_SHIFT) {
+                            vx[l] = vy[l];
+                        }
+                        vf[l] = vx[l] & 0x80 ? 1 : 0;
+                        vx[l] <<= 1;
+                    }
+                    break;
+            }
+            break;
+
+        case 9:
+            for (size_t l = begin; l < end; l++) PC[l] += vx[l] != vy[l] ? 2 : 0;
+            break;
+
+        case 0xA:
+            for (size_t l = begin; l < end; l++) I[l] = nnn;
+            break;
+
+        case 0xB:
+            for (size_t l = begin; l < end; l++) PC[l] = nnn + (Q::SC_JUMP ? vx[l] : v0[l]);
+            break;
+
+        case 0xC:
+            for (size_t l = begin; l < end; l++) {
+                uint32_t state = rngState[l];
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                rngState[l] = state;
+                vx[l] = (state & 0xFF) & kk;
+            }
+            break;
+
+        case 0xD:
+            for (size_t l = begin; l < end; l++) draw(x, y, n, l);
+            break;
+
+        case 0xE:
+            if (b2 == 0x9E || b2 == 0xA1) {
+                bool skipIfPressed = b2 == 0x9E;
+                for (size_t l = begin; l < end; l++) {
+                    bool pressed = vx[l] < 16 && (keys[l] >> vx[l]) & 1;
+                    PC[l] += pressed == skipIfPressed ? 2 : 0;
+                }
+            }
+            break;
+
+        case 0xF:
+            switch (b2) {
+                case 0x07:
+                    for (size_t l = begin; l < end; l++) vx[l] = delayTimer[l];
+                    break;
+
+                case 0x0A:
+                    // The lowest key that is down, or wait by executing Fx0A again
+                    for (size_t l = begin; l < end; l++) {
+                        if (keys[l]) {
+                            vx[l] = __builtin_ctz(keys[l]);
+                        }
+                        else {
+                            PC[l] -= 2;
+                        }
+                    }
+                    break;
+
+                case 0x15:
+                    for (size_t l = begin; l < end; l++) delayTimer[l] = vx[l];
+                    break;
+
+                case 0x18:
+                    for (size_t l = begin; l < end; l++) soundTimer[l] = vx[l];
+                    break;
+
+                case 0x1E:
+                    for (size_t l = begin; l < end; l++) I[l] += vx[l];
+                    break;
+
+                case 0x29:
+                    for (size_t l = begin; l < end; l++) I[l] = FONT_ADDRESS + vx[l] * 5;
+                    break;
+
+                case 0x33:
+                    for (size_t l = begin; l < end; l++) {
+                        uint8_t* mem = &memory[l * MEMORY_SIZE];
+                        mem[I[l] & 0xFFF] = vx[l] / 100;
+                        mem[(I[l] + 1) & 0xFFF] = (vx[l] / 10) % 10;
+                        mem[(I[l] + 2) & 0xFFF] = vx[l] % 10;
+                    }
+                    break;
+
+                case 0x55:
+                    for (size_t l = begin; l < end; l++) {
+                        uint8_t* mem = &memory[l * MEMORY_SIZE];
+                        for (int i = 0; i <= x; i++) {
+                            if (Q::COSMAC_MEM) {
+                                mem[I[l] & 0xFFF] = registers[i * lanes + l];
+                                I[l]++;
+                            }
+                            else {
+                                mem[(I[l] + i) & 0xFFF] = registers[i * lanes + l];
+                            }
+                        }
+                    }
+                    break;
+
+                case 0x65:
+                    for (size_t l = begin; l < end; l++) {
+                        uint8_t const* mem = &memory[l * MEMORY_SIZE];
+                        for (int i = 0; i <= x; i++) {
+                            if (Q::COSMAC_MEM) {
+                                registers[i * lanes + l] = mem[I[l] & 0xFFF];
+                                I[l]++;
+                            }
+                            else {
+                                registers[i * lanes + l] = mem[(I[l] + i) & 0xFFF];
+                            }
+                        }
+                    }
+                    break;
+            }
+            break;
+    }
+}
+
+
+/* Instantiations */
+
+template class Chip8Batch<Quirks<false, false, false>>;
+template class Chip8Batch<Quirks<false, false, true>>;
+template class Chip8Batch<Quirks<false, true, false>>;
+template class Chip8Batch<Quirks<false, true, true>>;
+template class Chip8Batch<Quirks<true, false, false>>;
+template class Chip8Batch<Quirks<true, false, true>>;
+template class Chip8Batch<Quirks<true, true, false>>;
+template class Chip8Batch<Quirks<true, true, true>>;
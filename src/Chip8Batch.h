@@ -0,0 +1,90 @@
+#ifndef CHIP8_BATCH_H
+#define CHIP8_BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "chip8.h"
+
+/**
+ * N CHIP-8 machines stepped in lockstep, in structure-of-arrays form
+ *
+ * Batched environment API for reinforcement-learning and search workloads:
+ * step(actions[N]) runs one frame on every machine and returns the packed
+ * displays as observations.
+ *
+ * Every per-machine field is stored as one contiguous array per field
+ * (registers as [16][N], pc as [N], ...), so an instruction applied to a
+ * run of machines is a loop over consecutive lanes that the compiler turns
+ * into SIMD code. Each instruction, the lanes are split into runs that share
+ * the same OP code; divergent lanes end up in runs of one and take the same
+ * code path as a scalar loop. The semantics follow the Chip8::OP_* handlers.
+ *
+ * @param Q - Quirk profile, a Quirks<...> instantiation
+ */
+template <typename Q>
+class Chip8Batch {
+    public:
+        static int const WIDTH = 64;
+        static int const HEIGHT = 32;
+        static int const MEMORY_SIZE = 4096;
+        static int const START_ADDRESS = 0x200;
+        static int const FONT_ADDRESS = 0x50;
+
+        /**
+         * @param lanes - Number of machines
+         * @param instructionsPerFrame - Instructions each machine runs per step()
+         */
+        Chip8Batch(size_t lanes, int instructionsPerFrame = 11);
+
+        /**
+         * Load the same ROM image and the fonts into every machine
+         */
+        bool loadRom(uint8_t const* data, size_t size);
+
+        /**
+         * Run one frame on every machine
+         * @param actions - Key mask per machine, bit k set while key k is held
+         * @return Packed displays, HEIGHT rows of 64 bits per machine
+         */
+        uint64_t const* step(uint16_t const* actions);
+
+        /**
+         * Execute one instruction on every machine
+         */
+        void cycle();
+
+        /**
+         * Decrement every machine's timers
+         */
+        void updateTimers();
+
+        size_t size() const { return lanes; }
+        uint64_t const* display(size_t lane) const { return &rows[lane * HEIGHT]; }
+        uint8_t* memoryOf(size_t lane) { return &memory[lane * MEMORY_SIZE]; }
+        uint8_t registerOf(size_t lane, int r) const { return registers[r * lanes + lane]; }
+
+        /* Structure of arrays: lane i of field f is f[i], or f[r * lanes + i] for per-register fields */
+        std::vector<uint8_t> memory; // [lanes][MEMORY_SIZE]
+        std::vector<uint64_t> rows; // [lanes][HEIGHT], leftmost pixel in the top bit
+        std::vector<uint8_t> registers; // [16][lanes]
+        std::vector<uint16_t> stack; // [16][lanes]
+        std::vector<uint16_t> pc;
+        std::vector<uint16_t> I;
+        std::vector<uint8_t> sp;
+        std::vector<uint8_t> delayTimer;
+        std::vector<uint8_t> soundTimer;
+        std::vector<uint16_t> keys; // Key mask
+        std::vector<uint32_t> rngState;
+        std::vector<uint8_t> drawFlag;
+
+    private:
+        void execute(uint16_t instruction, size_t begin, size_t end);
+        void draw(uint8_t x, uint8_t y, uint8_t n, size_t lane);
+
+        size_t lanes;
+        int instructionsPerFrame;
+        std::vector<uint16_t> fetched; // OP code of each lane this cycle
+};
+
+#endif
@@ -0,0 +1,773 @@
+#include <cctype>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include "Debugger.h"
+using namespace std;
+
+static volatile sig_atomic_t interrupted = 0;
+
+static string hex(unsigned value, int digits) {
+    ostringstream text;
+    text << "0x" << uppercase << setfill('0') << setw(digits) << std::hex << value;
+    return text.str();
+}
+
+
+/* Expressions */
+
+static int const MAX_STACK = 32; // Evaluation stack depth an expression may use
+
+/**
+ * Compile text to postfix
+ */
+bool Expression::parse(string const& text, string& error) {
+    size_t first = text.find_first_not_of(" \t");
+    size_t last = text.find_last_not_of(" \t");
+    source = first == string::npos ? "" : text.substr(first, last - first + 1);
+    program.clear();
+    position = 0;
+    parseError.clear();
+
+    skipSpace();
+    if (position == source.size()) {
+        error = "empty expression";
+        return false;
+    }
+    if (!parseBinary(0)) {
+        error = parseError;
+        return false;
+    }
+    skipSpace();
+    if (position != source.size()) {
+        error = "unexpected '" + source.substr(position) + "'";
+        return false;
+    }
+
+    int depth = 0;
+    for (Node const& node : program) {
+        depth += node.op <= ST_REG ? 1 : node.op >= OR ? -1 : 0;
+        if (depth > MAX_STACK) {
+            error = "expression too deep";
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Parse a chain of binary operators at level and above
+ */
+bool Expression::parseBinary(int level) {
+    // Operators by precedence level, lowest first. Longer tokens are listed
+    // before their prefixes so "<=" is not read as "<".
+    static struct {
+        char const* token;
+        Op op;
+    } const OPERATORS[8][4] = {
+        {{"||", OR}},
+        {{"&&", AND}},
+        {{"|", BIT_OR}},
+        {{"^", BIT_XOR}},
+        {{"&", BIT_AND}},
+        {{"==", EQ}, {"!=", NE}},
+        {{"<=", LE}, {">=", GE}, {"<", LT}, {">", GT}},
+        {{"+", ADD}, {"-", SUB}},
+    };
+
+    if (level == 8) {
+        return parseUnary();
+    }
+    if (!parseBinary(level + 1)) {
+        return false;
+    }
+    while (true) {
+        skipSpace();
+        bool matched = false;
+        for (auto const& candidate : OPERATORS[level]) {
+            if (!candidate.token) {
+                break;
+            }
+            size_t length = strlen(candidate.token);
+            if (source.compare(position, length, candidate.token) != 0) {
+                continue;
+            }
+            // A single | or & must not be the start of || or &&
+            if (length == 1 && position + 1 < source.size() && source[position + 1] == candidate.token[0] &&
+                (candidate.token[0] == '|' || candidate.token[0] == '&')) {
+                continue;
+            }
+            position += length;
+            if (!parseBinary(level + 1)) {
+                return false;
+            }
+            program.push_back({candidate.op, 0});
+            matched = true;
+            break;
+        }
+        if (!matched) {
+            return true;
+        }
+    }
+}
+
+bool Expression::parseUnary() {
+    skipSpace();
+    if (position < source.size()) {
+        char c = source[position];
+        Op op = c == '!' ? NOT : c == '-' ? NEG : c == '~' ? INVERT : PUSH;
+        if (op != PUSH) {
+            position++;
+            if (!parseUnary()) {
+                return false;
+            }
+            program.push_back({op, 0});
+            return true;
+        }
+    }
+    return parsePrimary();
+}
+
+bool Expression::parsePrimary() {
+    skipSpace();
+    if (position == source.size()) {
+        return fail("expression ends early");
+    }
+
+    char c = source[position];
+    if (c == '(' || c == '[') {
+        char close = c == '(' ? ')' : ']';
+        position++;
+        if (!parseBinary(0)) {
+            return false;
+        }
+        skipSpace();
+        if (position == source.size() || source[position] != close) {
+            return fail(string("missing '") + close + "'");
+        }
+        position++;
+        if (close == ']') {
+            program.push_back({LOAD, 0});
+        }
+        return true;
+    }
+
+    if (isdigit(static_cast<unsigned char>(c))) {
+        char const* begin = source.c_str() + position;
+        char* end;
+        long value = strtol(begin, &end, 0);
+        position += end - begin;
+        program.push_back({PUSH, int32_t(value)});
+        return true;
+    }
+
+    size_t begin = position;
+    while (position < source.size() && isalnum(static_cast<unsigned char>(source[position]))) {
+        position++;
+    }
+    string name = source.substr(begin, position - begin);
+    for (char& ch : name) {
+        ch = toupper(static_cast<unsigned char>(ch));
+    }
+
+    if (name.size() == 2 && name[0] == 'V' && isxdigit(static_cast<unsigned char>(name[1]))) {
+        program.push_back({REGISTER, int32_t(strtol(name.c_str() + 1, nullptr, 16))});
+    }
+    else if (name == "I") program.push_back({I_REG, 0});
+    else if (name == "PC") program.push_back({PC_REG, 0});
+    else if (name == "SP") program.push_back({SP_REG, 0});
+    else if (name == "DT") program.push_back({DT_REG, 0});
+    else if (name == "ST") program.push_back({ST_REG, 0});
+    else if (name.empty()) return fail(string("unexpected '") + c + "'");
+    else return fail("unknown name '" + name + "'");
+    return true;
+}
+
+void Expression::skipSpace() {
+    while (position < source.size() && isspace(static_cast<unsigned char>(source[position]))) {
+        position++;
+    }
+}
+
+bool Expression::fail(string const& message) {
+    parseError = message;
+    return false;
+}
+
+/**
+ * Evaluate the compiled program on a fixed stack
+ */
+int32_t Expression::evaluate(ExpressionContext const& context) const {
+    int32_t stack[MAX_STACK];
+    int top = -1;
+
+    for (Node const& node : program) {
+        int32_t b = top >= 0 ? stack[top] : 0;
+        switch (node.op) {
+            case PUSH: stack[++top] = node.value; break;
+            case REGISTER: stack[++top] = context.registers[node.value]; break;
+            case I_REG: stack[++top] = context.I; break;
+            case PC_REG: stack[++top] = context.pc; break;
+            case SP_REG: stack[++top] = context.sp; break;
+            case DT_REG: stack[++top] = context.delayTimer; break;
+            case ST_REG: stack[++top] = context.soundTimer; break;
+            case LOAD: stack[top] = context.memory[b & 0xFFF]; break;
+            case NOT: stack[top] = !b; break;
+            case NEG: stack[top] = -b; break;
+            case INVERT: stack[top] = ~b; break;
+            default: {
+                int32_t a = stack[--top];
+                int32_t result = 0;
+                switch (node.op) {
+                    case OR: result = a || b; break;
+                    case AND: result = a && b; break;
+                    case BIT_OR: result = a | b; break;
+                    case BIT_XOR: result = a ^ b; break;
+                    case BIT_AND: result = a & b; break;
+                    case EQ: result = a == b; break;
+                    case NE: result = a != b; break;
+                    case LT: result = a < b; break;
+                    case LE: result = a <= b; break;
+                    case GT: result = a > b; break;
+                    case GE: result = a >= b; break;
+                    case ADD: result = a + b; break;
+                    case SUB: result = a - b; break;
+                    default: break;
+                }
+                stack[top] = result;
+            }
+        }
+    }
+    return top >= 0 ? stack[top] : 0;
+}
+
+
+/* Debugger */
+
+/**
+ * Constructor
+ */
+template <typename Q>
+Debugger<Q>::Debugger(Chip8<Q>& chip8, int instructionsPerFrame, ostream& out)
+    : chip8(chip8), instructionsPerFrame(instructionsPerFrame), out(out), breakAt(4096) {}
+
+template <typename Q>
+void Debugger<Q>::interrupt() {
+    interrupted = 1;
+}
+
+template <typename Q>
+ExpressionContext Debugger<Q>::context() const {
+    return {chip8.registers, chip8.memory, chip8.pc, chip8.I, chip8.sp, chip8.delayTimer, chip8.soundTimer};
+}
+
+/**
+ * Execute one instruction, keeping the frame's timer ticks in step
+ *
+ * @param checkFirst - Stop before executing if a breakpoint matches pc
+ */
+template <typename Q>
+typename Debugger<Q>::Stop Debugger<Q>::execute(bool checkFirst) {
+    if (checkFirst && breakHere()) {
+        return BREAKPOINT;
+    }
+
+    uint16_t address = chip8.pc;
+    uint16_t oldI = chip8.I;
+    uint16_t instruction = chip8.cycle();
+    if (++phase == instructionsPerFrame) {
+        chip8.updateTimers();
+        phase = 0;
+        frame++;
+    }
+
+    if (!watchpoints.empty() && checkWatchpoints(instruction, oldI)) {
+        out << "  by " << hex(address, 3) << ": " << disassemble(instruction) << endl;
+        return WATCHPOINT;
+    }
+    return NONE;
+}
+
+/**
+ * Run instruction by instruction, checking breakpoints and watchpoints
+ *
+ * @param frames - Stop after this many frames, or never if negative
+ * @param returnPc - With returnDepth, stop when pc reaches this address, or any address if negative
+ * @param returnDepth - Stop when sp is back at this depth, or ignore sp if negative
+ */
+template <typename Q>
+typename Debugger<Q>::Stop Debugger<Q>::runInstrumented(long frames, int returnPc, int returnDepth) {
+    long endFrame = frames < 0 ? LONG_MAX : frame + frames;
+    interrupted = 0;
+
+    // The first instruction runs even if a breakpoint sits on it, so
+    // continuing from a breakpoint makes progress
+    bool first = true;
+    while (frame < endFrame) {
+        Stop stop = execute(!first);
+        first = false;
+        if (stop != NONE) {
+            return stop;
+        }
+        if (returnDepth >= 0 && chip8.sp == returnDepth && (returnPc < 0 || chip8.pc == returnPc)) {
+            return DONE;
+        }
+        if (interrupted) {
+            return INTERRUPTED;
+        }
+    }
+    return DONE;
+}
+
+/**
+ * Run whole frames through Chip8::runFrame with no per-instruction checks
+ */
+template <typename Q>
+typename Debugger<Q>::Stop Debugger<Q>::runFast(long frames) {
+    long endFrame = frames < 0 ? LONG_MAX : frame + frames;
+    interrupted = 0;
+
+    if (phase != 0 && frame < endFrame) {
+        finishFrame();
+    }
+    while (frame < endFrame && !interrupted) {
+        chip8.runFrame(instructionsPerFrame);
+        frame++;
+    }
+    return interrupted ? INTERRUPTED : DONE;
+}
+
+/**
+ * Execute the rest of a frame left partly done by stepping
+ */
+template <typename Q>
+void Debugger<Q>::finishFrame() {
+    while (phase != 0) {
+        execute(false);
+    }
+}
+
+/**
+ * Check the breakpoints on the current pc and their conditions
+ */
+template <typename Q>
+bool Debugger<Q>::breakHere() {
+    uint16_t address = chip8.pc & 0xFFF;
+    if (!breakAt[address]) {
+        return false;
+    }
+    for (Breakpoint& breakpoint : breakpoints) {
+        if (breakpoint.address == address &&
+            (!breakpoint.conditional || breakpoint.condition.evaluate(context()))) {
+            breakpoint.hits++;
+            hitId = breakpoint.id;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Report watched values changed by the instruction just executed
+ *
+ * Only OP_Fx33 and OP_Fx55 write memory, so memory watchpoints are compared
+ * against their shadow copy only after those.
+ */
+template <typename Q>
+bool Debugger<Q>::checkWatchpoints(uint16_t instruction, uint16_t oldI) {
+    bool writesMemory = (instruction & 0xF0FF) == 0xF033 || (instruction & 0xF0FF) == 0xF055;
+    bool hit = false;
+
+    for (Watchpoint& watchpoint : watchpoints) {
+        if (watchpoint.onI) {
+            if (chip8.I != oldI) {
+                out << "Watchpoint " << watchpoint.id << ": I " << hex(oldI, 3) << " -> " << hex(chip8.I, 3) << endl;
+                hitId = watchpoint.id;
+                hit = true;
+            }
+            continue;
+        }
+        if (!writesMemory) {
+            continue;
+        }
+        for (int address = watchpoint.begin; address < watchpoint.end; address++) {
+            uint8_t& seen = watchpoint.shadow[address - watchpoint.begin];
+            if (chip8.memory[address] != seen) {
+                out << "Watchpoint " << watchpoint.id << ": memory[" << hex(address, 3) << "] "
+                    << hex(seen, 2) << " -> " << hex(chip8.memory[address], 2) << endl;
+                seen = chip8.memory[address];
+                hitId = watchpoint.id;
+                hit = true;
+            }
+        }
+    }
+    return hit;
+}
+
+template <typename Q>
+bool Debugger<Q>::parseNumber(string const& text, long& value) {
+    char* end;
+    value = strtol(text.c_str(), &end, 0);
+    if (text.empty() || *end != '\0') {
+        out << "Not a number: " << text << endl;
+        return false;
+    }
+    return true;
+}
+
+template <typename Q>
+void Debugger<Q>::printLocation() {
+    uint16_t pc = chip8.pc & 0xFFF;
+    uint16_t instruction = (chip8.memory[pc] << 8) | chip8.memory[(pc + 1) & 0xFFF];
+    out << "frame " << frame << " +" << phase << "  " << hex(pc, 3) << ": "
+        << hex(instruction, 4).substr(2) << "  " << disassemble(instruction) << endl;
+}
+
+template <typename Q>
+void Debugger<Q>::printRegisters() {
+    for (int r = 0; r < 16; r++) {
+        out << "V" << "0123456789ABCDEF"[r] << "=" << hex(chip8.registers[r], 2).substr(2)
+            << (r % 8 == 7 ? "\n" : " ");
+    }
+    out << "I=" << hex(chip8.I, 3) << " PC=" << hex(chip8.pc, 3) << " SP=" << int(chip8.sp)
+        << " DT=" << int(chip8.delayTimer) << " ST=" << int(chip8.soundTimer) << endl;
+    if (chip8.sp > 0) {
+        out << "stack:";
+        for (int i = 0; i < chip8.sp && i < 16; i++) {
+            out << " " << hex(chip8.stack[i], 3);
+        }
+        out << endl;
+    }
+}
+
+template <typename Q>
+void Debugger<Q>::printMemory(uint16_t address, int count) {
+    for (int i = 0; i < count; i++) {
+        int a = (address + i) & 0xFFF;
+        if (i % 16 == 0) {
+            out << (i ? "\n" : "") << hex(a, 3) << ":";
+        }
+        out << " " << hex(chip8.memory[a], 2).substr(2);
+    }
+    out << endl;
+}
+
+template <typename Q>
+void Debugger<Q>::printListing(uint16_t address, int count) {
+    for (int i = 0; i < count; i++) {
+        int a = (address + 2 * i) & 0xFFF;
+        uint16_t instruction = (chip8.memory[a] << 8) | chip8.memory[(a + 1) & 0xFFF];
+        out << (a == (chip8.pc & 0xFFF) ? "=> " : "   ") << (breakAt[a] ? "* " : "  ")
+            << hex(a, 3) << ": " << hex(instruction, 4).substr(2) << "  " << disassemble(instruction) << endl;
+    }
+}
+
+template <typename Q>
+void Debugger<Q>::printScreen() {
+    for (int y = 0; y < Chip8<Q>::HEIGHT; y++) {
+        for (int x = 0; x < Chip8<Q>::WIDTH; x++) {
+            out << (chip8.pixel(x, y) ? '#' : '.');
+        }
+        out << endl;
+    }
+}
+
+template <typename Q>
+void Debugger<Q>::printBreakpoints() {
+    if (breakpoints.empty() && watchpoints.empty()) {
+        out << "No breakpoints or watchpoints" << endl;
+    }
+    for (Breakpoint const& breakpoint : breakpoints) {
+        out << breakpoint.id << ": break " << hex(breakpoint.address, 3);
+        if (breakpoint.conditional) {
+            out << " if " << breakpoint.condition.text();
+        }
+        out << " (" << breakpoint.hits << " hits)" << endl;
+    }
+    for (Watchpoint const& watchpoint : watchpoints) {
+        out << watchpoint.id << ": watch ";
+        if (watchpoint.onI) {
+            out << "I" << endl;
+        }
+        else {
+            out << hex(watchpoint.begin, 3) << " " << watchpoint.end - watchpoint.begin << endl;
+        }
+    }
+}
+
+template <typename Q>
+void Debugger<Q>::report(Stop stop, long frames, double seconds) {
+    if (stop == BREAKPOINT) {
+        out << "Breakpoint " << hitId << endl;
+    }
+    else if (stop == INTERRUPTED) {
+        out << "Interrupted" << endl;
+    }
+    if (seconds > 0.1) {
+        out << "Ran " << frames << " frames in " << fixed << setprecision(2) << seconds << " s ("
+            << setprecision(0) << frames / seconds << " frames/s)" << endl;
+        out.unsetf(ios::floatfield);
+    }
+    printLocation();
+}
+
+/**
+ * Parse and execute one command
+ */
+template <typename Q>
+bool Debugger<Q>::command(string const& input) {
+    string line = input.find_first_not_of(" \t") == string::npos ? lastCommand : input;
+    lastCommand = line;
+
+    istringstream words(line);
+    string name;
+    words >> name;
+    if (name.empty()) {
+        return true;
+    }
+
+    if (name == "q" || name == "quit") {
+        return false;
+    }
+
+    if (name == "h" || name == "help") {
+        out << "step [n]                 Execute n instructions (s)\n"
+               "next                     Execute one instruction, stepping over CALL (n)\n"
+               "finish                   Run until the current subroutine returns\n"
+               "continue [frames]        Run until a breakpoint, watchpoint or Ctrl-C (c)\n"
+               "break <addr> [if <expr>] Break before executing addr (b)\n"
+               "watch <addr> [length]    Stop when OP_Fx33/OP_Fx55 change memory\n"
+               "watch I                  Stop when I changes\n"
+               "delete <id>              Remove a breakpoint or watchpoint (d)\n"
+               "info                     List breakpoints and watchpoints\n"
+               "regs                     Show registers, timers and the stack (r)\n"
+               "print <expr>             Evaluate an expression (p)\n"
+               "x <addr> [count]         Dump memory\n"
+               "list [addr] [count]      Disassemble, by default at pc (l)\n"
+               "screen                   Show the display\n"
+               "key <k> <0|1>            Release or hold key k\n"
+               "quit                     Exit (q)\n"
+               "Expressions use V0-VF, I, PC, SP, DT, ST, [addr] and C operators, e.g. V3 == 2 && [I] > 0x10\n";
+        return true;
+    }
+
+    auto start = chrono::steady_clock::now();
+    long startFrame = frame;
+
+    if (name == "s" || name == "step") {
+        long count = 1;
+        string argument;
+        if (words >> argument && !parseNumber(argument, count)) {
+            return true;
+        }
+        Stop stop = NONE;
+        for (long i = 0; i < count && stop == NONE; i++) {
+            stop = execute(i > 0);
+        }
+        if (stop == BREAKPOINT) {
+            out << "Breakpoint " << hitId << endl;
+        }
+        printLocation();
+        return true;
+    }
+
+    if (name == "n" || name == "next" || name == "finish") {
+        Stop stop;
+        uint16_t pc = chip8.pc & 0xFFF;
+        if (name == "finish") {
+            if (chip8.sp == 0) {
+                out << "Not in a subroutine" << endl;
+                return true;
+            }
+            stop = runInstrumented(-1, -1, chip8.sp - 1);
+        }
+        else if ((chip8.memory[pc] >> 4) == 0x2) {
+            stop = runInstrumented(-1, (chip8.pc + 2) & 0xFFFF, chip8.sp);
+        }
+        else {
+            stop = execute(false);
+        }
+        report(stop, frame - startFrame, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        return true;
+    }
+
+    if (name == "c" || name == "continue") {
+        long frames = -1;
+        string argument;
+        if (words >> argument && !parseNumber(argument, frames)) {
+            return true;
+        }
+        Stop stop = instrumented() ? runInstrumented(frames, -1, -1) : runFast(frames);
+        report(stop, frame - startFrame, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        return true;
+    }
+
+    if (name == "b" || name == "break") {
+        string argument;
+        long address;
+        if (!(words >> argument) || !parseNumber(argument, address) || address < 0 || address > 0xFFF) {
+            out << "Usage: break <addr 0-0xFFF> [if <expr>]" << endl;
+            return true;
+        }
+        Breakpoint breakpoint{nextId, uint16_t(address), false, Expression(), 0};
+        string keyword;
+        if (words >> keyword) {
+            string condition;
+            getline(words, condition);
+            string error;
+            if (keyword != "if" || !breakpoint.condition.parse(condition, error)) {
+                out << "Bad condition: " << (keyword != "if" ? "expected 'if'" : error) << endl;
+                return true;
+            }
+            breakpoint.conditional = true;
+        }
+        breakpoints.push_back(breakpoint);
+        breakAt[address]++;
+        out << "Breakpoint " << nextId++ << " at " << hex(address, 3) << endl;
+        return true;
+    }
+
+    if (name == "watch") {
+        string argument;
+        if (!(words >> argument)) {
+            out << "Usage: watch <addr> [length] | watch I" << endl;
+            return true;
+        }
+        Watchpoint watchpoint{nextId, false, 0, 0, {}};
+        if (argument == "I" || argument == "i") {
+            watchpoint.onI = true;
+        }
+        else {
+            long address;
+            long length = 1;
+            string lengthText;
+            if (!parseNumber(argument, address) || (words >> lengthText && !parseNumber(lengthText, length))) {
+                return true;
+            }
+            if (address < 0 || length < 1 || address + length > 4096) {
+                out << "Watched range must be inside memory" << endl;
+                return true;
+            }
+            watchpoint.begin = address;
+            watchpoint.end = address + length;
+            watchpoint.shadow.assign(chip8.memory + address, chip8.memory + address + length);
+        }
+        watchpoints.push_back(watchpoint);
+        out << "Watchpoint " << nextId++ << endl;
+        return true;
+    }
+
+    if (name == "d" || name == "delete") {
+        long id;
+        string argument;
+        if (!(words >> argument) || !parseNumber(argument, id)) {
+            return true;
+        }
+        for (size_t i = 0; i < breakpoints.size(); i++) {
+            if (breakpoints[i].id == id) {
+                breakAt[breakpoints[i].address]--;
+                breakpoints.erase(breakpoints.begin() + i);
+                return true;
+            }
+        }
+        for (size_t i = 0; i < watchpoints.size(); i++) {
+            if (watchpoints[i].id == id) {
+                watchpoints.erase(watchpoints.begin() + i);
+                return true;
+            }
+        }
+        out << "No breakpoint or watchpoint " << id << endl;
+        return true;
+    }
+
+    if (name == "info") {
+        printBreakpoints();
+        return true;
+    }
+
+    if (name == "r" || name == "regs") {
+        printRegisters();
+        return true;
+    }
+
+    if (name == "p" || name == "print") {
+        string text;
+        getline(words, text);
+        Expression expression;
+        string error;
+        if (!expression.parse(text, error)) {
+            out << "Bad expression: " << error << endl;
+            return true;
+        }
+        int32_t value = expression.evaluate(context());
+        out << value << " (" << hex(uint32_t(value), 1) << ")" << endl;
+        return true;
+    }
+
+    if (name == "x") {
+        string argument;
+        long address;
+        long count = 16;
+        if (!(words >> argument) || !parseNumber(argument, address)) {
+            out << "Usage: x <addr> [count]" << endl;
+            return true;
+        }
+        if (words >> argument && !parseNumber(argument, count)) {
+            return true;
+        }
+        printMemory(address, count);
+        return true;
+    }
+
+    if (name == "l" || name == "list") {
+        long address = chip8.pc;
+        long count = 10;
+        string argument;
+        if (words >> argument && !parseNumber(argument, address)) {
+            return true;
+        }
+        if (words >> argument && !parseNumber(argument, count)) {
+            return true;
+        }
+        printListing(address, count);
+        return true;
+    }
+
+    if (name == "screen") {
+        printScreen();
+        return true;
+    }
+
+    if (name == "key") {
+        string keyText;
+        string stateText;
+        long key;
+        long state;
+        if (!(words >> keyText >> stateText) || !parseNumber(keyText, key) || !parseNumber(stateText, state) ||
+            key < 0 || key > 0xF) {
+            out << "Usage: key <0-0xF> <0|1>" << endl;
+            return true;
+        }
+        chip8.setKey(key, state != 0);
+        return true;
+    }
+
+    out << "Unknown command '" << name << "', try help" << endl;
+    return true;
+}
+
+
+/* Instantiations */
+
+template class Debugger<Quirks<false, false, false>>;
+template class Debugger<Quirks<false, false, true>>;
+template class Debugger<Quirks<false, true, false>>;
+template class Debugger<Quirks<false, true, true>>;
+template class Debugger<Quirks<true, false, false>>;
+template class Debugger<Quirks<true, false, true>>;
+template class Debugger<Quirks<true, true, false>>;
+template class Debugger<Quirks<true, true, true>>;
@@ -0,0 +1,153 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "chip8.h"
+#include "Disassembler.h"
+
+/**
+ * Machine state an Expression is evaluated against
+ */
+struct ExpressionContext {
+    uint8_t const* registers;
+    uint8_t const* memory;
+    uint16_t pc;
+    uint16_t I;
+    uint8_t sp;
+    uint8_t delayTimer;
+    uint8_t soundTimer;
+};
+
+/**
+ * Integer expression over the machine state, used for breakpoint conditions
+ * and the print command
+ *
+ * C syntax and precedence: || && | ^ & == != < <= > >= + - and unary ! - ~,
+ * with parentheses. Operands are numbers (decimal or 0x hex), the registers
+ * V0-VF, I, PC, SP, DT, ST, and [expr] for the memory byte at expr.
+ * The expression is compiled to postfix once and evaluated without allocating.
+ */
+class Expression {
+    public:
+        /**
+         * Compile text, returning false and setting error if it is not valid
+         */
+        bool parse(std::string const& text, std::string& error);
+
+        int32_t evaluate(ExpressionContext const& context) const;
+
+        std::string const& text() const { return source; }
+
+    private:
+        enum Op : uint8_t {
+            PUSH, REGISTER, I_REG, PC_REG, SP_REG, DT_REG, ST_REG, LOAD,
+            NOT, NEG, INVERT,
+            OR, AND, BIT_OR, BIT_XOR, BIT_AND, EQ, NE, LT, LE, GT, GE, ADD, SUB
+        };
+        struct Node {
+            Op op;
+            int32_t value; // Constant for PUSH, register index for REGISTER
+        };
+
+        bool parseBinary(int level);
+        bool parseUnary();
+        bool parsePrimary();
+        void skipSpace();
+        bool fail(std::string const& message);
+
+        std::string source;
+        std::vector<Node> program;
+        size_t position = 0; // Parser cursor into source
+        std::string parseError;
+};
+
+/**
+ * Interactive debugger for the headless core
+ *
+ * Supports single-stepping, stepping over OP_2nnn calls, running until the
+ * current subroutine returns through OP_00EE, breakpoints on pc with optional
+ * conditions, and watchpoints on memory ranges and on I.
+ *
+ * The core has no debug hooks. While no breakpoints or watchpoints exist,
+ * continue runs whole frames through Chip8::runFrame, the same loop the front
+ * end uses. Only while some exist does it switch to an instrumented loop that
+ * checks them around every instruction.
+ *
+ * @param Q - Quirk profile of the debugged core
+ */
+template <typename Q>
+class Debugger {
+    public:
+        /**
+         * @param chip8 - Core to debug, with the ROM and fonts loaded
+         * @param instructionsPerFrame - Instructions per 60Hz frame
+         * @param out - Stream for all debugger output
+         */
+        Debugger(Chip8<Q>& chip8, int instructionsPerFrame, std::ostream& out);
+
+        /**
+         * Execute one command line, returning false on quit
+         *
+         * An empty line repeats the previous command.
+         */
+        bool command(std::string const& line);
+
+        /**
+         * Interrupt a running continue, finish or next, e.g. from a SIGINT handler
+         */
+        static void interrupt();
+
+    private:
+        struct Breakpoint {
+            int id;
+            uint16_t address;
+            bool conditional;
+            Expression condition;
+            long hits;
+        };
+        struct Watchpoint {
+            int id;
+            bool onI; // Watch I instead of memory
+            uint16_t begin; // Watched memory is [begin, end)
+            uint16_t end;
+            std::vector<uint8_t> shadow; // Last seen contents
+        };
+        enum Stop { NONE, BREAKPOINT, WATCHPOINT, INTERRUPTED, DONE };
+
+        /* Execution */
+        Stop execute(bool checkFirst);
+        Stop runInstrumented(long frames, int returnPc, int returnDepth);
+        Stop runFast(long frames);
+        void finishFrame();
+        bool breakHere();
+        bool checkWatchpoints(uint16_t instruction, uint16_t oldI);
+        bool instrumented() const { return !breakpoints.empty() || !watchpoints.empty(); }
+
+        /* Commands */
+        void printLocation();
+        void printRegisters();
+        void printMemory(uint16_t address, int count);
+        void printListing(uint16_t address, int count);
+        void printScreen();
+        void printBreakpoints();
+        void report(Stop stop, long frames, double seconds);
+        bool parseNumber(std::string const& text, long& value);
+        ExpressionContext context() const;
+
+        Chip8<Q>& chip8;
+        int instructionsPerFrame;
+        std::ostream& out;
+        int phase = 0; // Instructions already executed in the current frame
+        long frame = 0;
+        std::vector<Breakpoint> breakpoints;
+        std::vector<Watchpoint> watchpoints;
+        std::vector<uint8_t> breakAt; // Number of breakpoints per address, checked every instruction
+        int nextId = 1;
+        std::string lastCommand;
+        int hitId = 0; // Breakpoint or watchpoint that stopped execution
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include <iomanip>
+#include <sstream>
+#include "Disassembler.h"
+using namespace std;
+
+static string hex(unsigned value, int digits) {
+    ostringstream text;
+    text << "0x" << uppercase << setfill('0') << setw(digits) << std::hex << value;
+    return text.str();
+}
+
+string disassemble(uint16_t instruction) {
+    uint8_t n1 = instruction >> 12;
+    string vx = "V" + string(1, "0123456789ABCDEF"[(instruction >> 8) & 0xF]);
+    string vy = "V" + string(1, "0123456789ABCDEF"[(instruction >> 4) & 0xF]);
+    uint8_t n = instruction & 0xF;
+    uint8_t kk = instruction & 0xFF;
+    string nnn = hex(instruction & 0xFFF, 3);
+    string byte = hex(kk, 2);
+
+    switch (n1) {
+        case 0:
+            if (kk == 0xE0) return "CLS";
+            if (kk == 0xEE) return "RET";
+            return "SYS " + nnn;
+        case 1: return "JP " + nnn;
+        case 2: return "CALL " + nnn;
+        case 3: return "SE " + vx + ", " + byte;
+        case 4: return "SNE " + vx + ", " + byte;
+        case 5: return "SE " + vx + ", " + vy;
+        case 6: return "LD " + vx + ", " + byte;
+        case 7: return "ADD " + vx + ", " + byte;
+        case 8:
+            switch (n) {
+                case 0x0: return "LD " + vx + ", " + vy;
+                case 0x1: return "OR " + vx + ", " + vy;
+                case 0x2: return "AND " + vx + ", " + vy;
+                case 0x3: return "XOR " + vx + ", " + vy;
+                case 0x4: return "ADD " + vx + ", " + vy;
+                case 0x5: return "SUB " + vx + ", " + vy;
+                case 0x6: return "SHR " + vx + ", " + vy;
+                case 0x7: return "SUBN " + vx + ", " + vy;
+                case 0xE: return "SHL " + vx + ", " + vy;
+            }
+            break;
+        case 9: return "SNE " + vx + ", " + vy;
+        case 0xA: return "LD I, " + nnn;
+        case 0xB: return "JP V0, " + nnn;
+        case 0xC: return "RND " + vx + ", " + byte;
+        case 0xD: return "DRW " + vx + ", " + vy + ", " + to_string(n);
+        case 0xE:
+            if (kk == 0x9E) return "SKP " + vx;
+            if (kk == 0xA1) return "SKNP " + vx;
+            break;
+        case 0xF:
+            switch (kk) {
+                case 0x07: return "LD " + vx + ", DT";
+                case 0x0A: return "LD " + vx + ", K";
+                case 0x15: return "LD DT, " + vx;
+                case 0x18: return "LD ST, " + vx;
+                case 0x1E: return "ADD I, " + vx;
+                case 0x29: return "LD F, " + vx;
+                case 0x33: return "LD B, " + vx;
+                case 0x55: return "LD [I], " + vx;
+                case 0x65: return "LD " + vx + ", [I]";
+            }
+            break;
+    }
+    return "DW " + hex(instruction, 4);
+}
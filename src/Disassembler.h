@@ -0,0 +1,15 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Disassemble one instruction, e.g. "LD V3, 0x1F"
+ *
+ * Mnemonics follow the OP code comments in chip8.h. Words that are not
+ * instructions are shown as data, e.g. "DW 0x0123".
+ */
+std::string disassemble(uint16_t instruction);
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "Predecoded.h"
+#include "chip8.h"
+
+/**
+ * Runtime settings a headless session is created with
+ */
+struct EmulatorConfig {
+    bool cpShift = false;
+    bool scJump = false;
+    bool cosmacMem = false;
+    bool vipTiming = false; // Use the COSMAC VIP timing model instead of speed
+    int speed = 700; // Instructions per second in flat-rate mode
+    TranslationCache* translations = nullptr; // If set, run on Predecoded with translations from this cache
+};
+
+/**
+ * A headless CHIP-8 core behind a quirk-independent interface
+ *
+ * Lets code that hosts many sessions with different quirk profiles hold them
+ * in one container. The virtual call is made once per frame; the execution
+ * loop inside runFrame() runs on the specialized core.
+ */
+class Emulator {
+public:
+    static int const WIDTH = 64;
+    static int const HEIGHT = 32;
+
+    virtual ~Emulator() = default;
+
+    /**
+     * Load a ROM image and the fonts
+     * @return False if the ROM does not fit in memory
+     */
+    virtual bool loadRom(uint8_t const* data, size_t size) = 0;
+
+    /**
+     * Run one 60Hz frame
+     */
+    virtual void runFrame() = 0;
+
+    /**
+     * Set the state of one key of the keypad
+     */
+    virtual void setKey(int key, bool pressed) = 0;
+
+    /**
+     * A row of the display as 64 bits, leftmost pixel in the top bit
+     */
+    virtual uint64_t row(int y) const = 0;
+
+    virtual uint8_t delayTimer() const = 0;
+    virtual uint8_t soundTimer() const = 0;
+};
+
+/**
+ * Emulator implementation for one quirk profile
+ */
+template <typename Q>
+class EmulatorCore : public Emulator {
+public:
+    explicit EmulatorCore(EmulatorConfig const& config) : config(config) {}
+
+    bool loadRom(uint8_t const* data, size_t size) override {
+        chip8.loadFonts();
+        return chip8.loadRom(data, size);
+    }
+
+    void runFrame() override {
+        if (config.vipTiming) {
+            chip8.runFrameVip();
+        }
+        else {
+            chip8.runFrame((frame + 1) * config.speed / 60 - frame * config.speed / 60);
+        }
+        frame++;
+    }
+
+    void setKey(int key, bool pressed) override {
+        chip8.setKey(key & 0xF, pressed);
+    }
+
+    uint64_t row(int y) const override {
+        return chip8.display[y];
+    }
+
+    uint8_t delayTimer() const override { return chip8.delayTimer; }
+    uint8_t soundTimer() const override { return chip8.soundTimer; }
+
+private:
+    Chip8<Q> chip8;
+    EmulatorConfig config;
+    long frame = 0;
+};
+
+/**
+ * Emulator implementation on the predecoded core, for hosts that start the
+ * same ROMs over and over
+ */
+template <typename Q>
+class PredecodedEmulatorCore : public Emulator {
+public:
+    explicit PredecodedEmulatorCore(EmulatorConfig const& config) : core(config.translations), config(config) {}
+
+    bool loadRom(uint8_t const* data, size_t size) override {
+        return core.loadRom(data, size);
+    }
+
+    void runFrame() override {
+        if (config.vipTiming) {
+            core.runFrameVip();
+        }
+        else {
+            core.runFrame((frame + 1) * config.speed / 60 - frame * config.speed / 60);
+        }
+        frame++;
+    }
+
+    void setKey(int key, bool pressed) override {
+        core.chip8.setKey(key & 0xF, pressed);
+    }
+
+    uint64_t row(int y) const override {
+        return core.chip8.display[y];
+    }
+
+    uint8_t delayTimer() const override { return core.chip8.delayTimer; }
+    uint8_t soundTimer() const override { return core.chip8.soundTimer; }
+
+private:
+    Predecoded<Q> core;
+    EmulatorConfig config;
+    long frame = 0;
+};
+
+/**
+ * Create a headless emulator specialized for the configured quirk profile
+ */
+inline std::unique_ptr<Emulator> makeEmulator(EmulatorConfig const& config) {
+    return withQuirks(config.cpShift, config.scJump, config.cosmacMem, [&](auto quirks) -> std::unique_ptr<Emulator> {
+        if (config.translations) {
+            return std::make_unique<PredecodedEmulatorCore<decltype(quirks)>>(config);
+        }
+        return std::make_unique<EmulatorCore<decltype(quirks)>>(config);
+    });
+}
+
+#endif
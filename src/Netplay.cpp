@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "Netplay.h"
+#include "QuirkDetect.h"
+using namespace std;
+
+/* Packets */
+
+static void put(uint8_t* data, size_t offset, uint64_t value, int bytes) {
+    for (int b = 0; b < bytes; b++) {
+        data[offset + b] = uint8_t(value >> (8 * b));
+    }
+}
+
+static uint64_t get(uint8_t const* data, size_t offset, int bytes) {
+    uint64_t value = 0;
+    for (int b = 0; b < bytes; b++) {
+        value |= uint64_t(data[offset + b]) << (8 * b);
+    }
+    return value;
+}
+
+#define PUT_FIELD(data, packet, field) put(data, offsetof(NetplayPacket, field), packet.field, sizeof(packet.field))
+#define GET_FIELD(data, packet, field) packet.field = decltype(packet.field)(get(data, offsetof(NetplayPacket, field), sizeof(packet.field)))
+
+/**
+ * Write a packet in its wire format
+ * @return Bytes used in data, at most sizeof(NetplayPacket)
+ */
+static size_t encodePacket(NetplayPacket const& packet, uint8_t* data) {
+    PUT_FIELD(data, packet, magic);
+    PUT_FIELD(data, packet, session);
+    PUT_FIELD(data, packet, ack);
+    PUT_FIELD(data, packet, first);
+    PUT_FIELD(data, packet, checksumFrame);
+    PUT_FIELD(data, packet, checksum);
+    PUT_FIELD(data, packet, count);
+    for (int i = 0; i < packet.count; i++) {
+        put(data, offsetof(NetplayPacket, inputs) + i * sizeof(uint16_t), packet.inputs[i], sizeof(uint16_t));
+    }
+    return offsetof(NetplayPacket, inputs) + packet.count * sizeof(uint16_t);
+}
+
+/**
+ * Read a packet from its wire format
+ * @return False if size is too short for the header or the inputs it announces
+ */
+static bool decodePacket(uint8_t const* data, size_t size, NetplayPacket& packet) {
+    size_t header = offsetof(NetplayPacket, inputs);
+    if (size < header) {
+        return false;
+    }
+    GET_FIELD(data, packet, magic);
+    GET_FIELD(data, packet, session);
+    GET_FIELD(data, packet, ack);
+    GET_FIELD(data, packet, first);
+    GET_FIELD(data, packet, checksumFrame);
+    GET_FIELD(data, packet, checksum);
+    GET_FIELD(data, packet, count);
+    if (packet.count > sizeof(packet.inputs) / sizeof(uint16_t) || size < header + packet.count * sizeof(uint16_t)) {
+        return false;
+    }
+    for (int i = 0; i < packet.count; i++) {
+        packet.inputs[i] = uint16_t(get(data, header + i * sizeof(uint16_t), sizeof(uint16_t)));
+    }
+    return true;
+}
+
+
+/* UdpLink */
+
+UdpLink::~UdpLink() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool UdpLink::open(NetplayConfig const& config, string& error) {
+    this->config = config;
+    random.seed(config.seed);
+
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* peer = nullptr;
+    int status = getaddrinfo(config.peerHost.c_str(), to_string(config.peerPort).c_str(), &hints, &peer);
+    if (status != 0) {
+        error = "Unable to resolve " + config.peerHost + ": " + gai_strerror(status);
+        return false;
+    }
+    address.assign(reinterpret_cast<uint8_t*>(peer->ai_addr), reinterpret_cast<uint8_t*>(peer->ai_addr) + peer->ai_addrlen);
+    freeaddrinfo(peer);
+
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(config.port);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) < 0) {
+        error = "Unable to bind UDP port " + to_string(config.port) + ": " + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+void UdpLink::send(void const* data, size_t size) {
+    if (config.loss > 0 && uniform_real_distribution<double>(0, 1)(random) < config.loss) {
+        dropped++;
+        return;
+    }
+    if (config.latencyMs <= 0 && config.jitterMs <= 0) {
+        sendto(fd, data, size, 0, reinterpret_cast<sockaddr const*>(address.data()), address.size());
+        sent++;
+        return;
+    }
+
+    int delay = config.latencyMs + (config.jitterMs > 0 ? uniform_int_distribution<int>(0, config.jitterMs)(random) : 0);
+    uint8_t const* bytes = static_cast<uint8_t const*>(data);
+    Delayed packet{chrono::steady_clock::now() + chrono::milliseconds(delay), vector<uint8_t>(bytes, bytes + size)};
+    // Kept in order of due time, so jitter reorders packets like a real network
+    auto position = upper_bound(delayed.begin(), delayed.end(), packet.due,
+                                [](auto due, Delayed const& other) { return due < other.due; });
+    delayed.insert(position, std::move(packet));
+}
+
+void UdpLink::flush() {
+    auto now = chrono::steady_clock::now();
+    while (!delayed.empty() && delayed.front().due <= now) {
+        vector<uint8_t> const& data = delayed.front().data;
+        sendto(fd, data.data(), data.size(), 0, reinterpret_cast<sockaddr const*>(address.data()), address.size());
+        sent++;
+        delayed.pop_front();
+    }
+}
+
+int UdpLink::receive(void* buffer, size_t capacity) {
+    ssize_t size = recv(fd, buffer, capacity, 0);
+    return size < 0 ? -1 : int(size);
+}
+
+
+/* NetplaySession */
+
+template <typename Q>
+NetplaySession<Q>::NetplaySession(Chip8<Q> const& start, uint32_t session, RollbackConfig const& rollbackConfig,
+                                  NetplayConfig const& config)
+    : config(config), session(session), rollback(new Rollback<Q>(start, config.player, rollbackConfig)) {
+}
+
+template <typename Q>
+bool NetplaySession<Q>::tick(uint16_t keys, bool advancing) {
+    receive();
+    rollback->synchronize();
+    compareChecksum();
+
+    bool ran = false;
+    if (advancing) {
+        if (rollback->canAdvance()) {
+            rollback->advance(keys);
+            ran = true;
+        }
+        else {
+            statistics.stalls++;
+        }
+    }
+
+    send();
+    link.flush();
+    return ran;
+}
+
+template <typename Q>
+bool NetplaySession<Q>::settled(uint32_t frame) const {
+    return rollback->confirmedFrames() >= frame && remoteAck >= frame;
+}
+
+template <typename Q>
+void NetplaySession<Q>::receive() {
+    uint8_t data[sizeof(NetplayPacket)];
+    NetplayPacket packet;
+    int size;
+    while ((size = link.receive(data, sizeof(data))) >= 0) {
+        if (!decodePacket(data, size, packet) || packet.magic != NETPLAY_MAGIC || packet.session != session) {
+            statistics.foreignPackets++;
+            continue;
+        }
+        statistics.packetsReceived++;
+
+        for (int i = 0; i < packet.count; i++) {
+            rollback->addRemoteInput(packet.first + i, packet.inputs[i]);
+        }
+        remoteAck = max(remoteAck, packet.ack);
+        if (remoteChecksumFrame == UINT32_MAX || packet.checksumFrame > remoteChecksumFrame) {
+            remoteChecksumFrame = packet.checksumFrame;
+            remoteChecksum = packet.checksum;
+        }
+    }
+}
+
+template <typename Q>
+void NetplaySession<Q>::send() {
+    NetplayPacket packet;
+    packet.magic = NETPLAY_MAGIC;
+    packet.checksum = 0;
+    packet.session = session;
+    packet.ack = rollback->confirmedFrames();
+    packet.first = remoteAck;
+    packet.count = uint8_t(min<uint32_t>(rollback->currentFrame() - remoteAck, Rollback<Q>::RING));
+    for (int i = 0; i < packet.count; i++) {
+        packet.inputs[i] = rollback->localInput(packet.first + i);
+    }
+    packet.checksumFrame = rollback->finalFrame();
+    rollback->checksum(packet.checksumFrame, packet.checksum);
+    uint8_t data[sizeof(NetplayPacket)];
+    link.send(data, encodePacket(packet, data));
+}
+
+/**
+ * Compare the peer's newest checksum with this peer's, once this peer has
+ * the same frame final
+ */
+template <typename Q>
+void NetplaySession<Q>::compareChecksum() {
+    uint64_t hash;
+    if (remoteChecksumFrame == UINT32_MAX || !rollback->checksum(remoteChecksumFrame, hash)) {
+        return;
+    }
+    statistics.checksumsCompared++;
+    if (hash != remoteChecksum && !statistics.desynced) {
+        statistics.desynced = true;
+        statistics.desyncFrame = remoteChecksumFrame;
+    }
+    remoteChecksumFrame = UINT32_MAX;
+}
+
+uint32_t netplaySession(uint8_t const* rom, size_t size, int quirkProfile, RollbackConfig const& config) {
+    uint64_t hash = romHash(rom, size);
+    hash = (hash ^ uint32_t(quirkProfile)) * 0x100000001B3ull;
+    hash = (hash ^ uint32_t(config.speed)) * 0x100000001B3ull;
+    hash = (hash ^ uint32_t(config.vipTiming)) * 0x100000001B3ull;
+    return uint32_t(hash ^ (hash >> 32));
+}
+
+
+/* Instantiations */
+
+template class NetplaySession<Quirks<false, false, false>>;
+template class NetplaySession<Quirks<false, false, true>>;
+template class NetplaySession<Quirks<false, true, false>>;
+template class NetplaySession<Quirks<false, true, true>>;
+template class NetplaySession<Quirks<true, false, false>>;
+template class NetplaySession<Quirks<true, false, true>>;
+template class NetplaySession<Quirks<true, true, false>>;
+template class NetplaySession<Quirks<true, true, true>>;
@@ -0,0 +1,160 @@
+#ifndef NETPLAY_H
+#define NETPLAY_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "Rollback.h"
+
+/**
+ * How to reach the other peer, and the impairments to add on the way
+ */
+struct NetplayConfig {
+    int player = 0; // 0 or 1, which keypad half this peer plays (see PLAYER_KEYS)
+    uint16_t port = 7001; // Local UDP port
+    std::string peerHost = "127.0.0.1";
+    uint16_t peerPort = 7002;
+    int latencyMs = 0; // Added to every packet sent
+    int jitterMs = 0; // Up to this much more, so packets can arrive out of order
+    double loss = 0; // Share of packets dropped before sending
+    uint32_t seed = 1; // For the jitter and loss
+};
+
+/**
+ * One netplay datagram: the sender's keys for every frame the receiver has
+ * not acknowledged, what the sender has received, and the checksum of its
+ * newest final frame
+ *
+ * Every packet repeats the unacknowledged frames, so a lost packet only
+ * delays input until the next one arrives. On the wire the fields follow
+ * each other at the offsets of this packed structure, every integer
+ * little-endian whatever the host's byte order, and only count inputs are sent.
+ */
+#pragma pack(push, 1)
+struct NetplayPacket {
+    uint32_t magic; // NETPLAY_MAGIC
+    uint32_t session; // Hash of the ROM and RollbackConfig; packets from other sessions are dropped
+    uint32_t ack; // The sender has the receiver's keys for every frame before this
+    uint32_t first; // Frame of inputs[0]
+    uint32_t checksumFrame;
+    uint64_t checksum; // Rollback::checksum of checksumFrame
+    uint8_t count; // Entries of inputs used
+    uint16_t inputs[Rollback<Quirks<false, false, false>>::RING];
+};
+#pragma pack(pop)
+
+static uint32_t const NETPLAY_MAGIC = 0x504E3843; // "C8NP"
+
+/**
+ * A UDP socket to one peer, with an optional latency, jitter and loss shim
+ * on the sending side
+ *
+ * The shim holds delayed packets until flush() finds them due, so it needs
+ * flush() called often, e.g. every frame.
+ */
+class UdpLink {
+    public:
+        ~UdpLink();
+
+        bool open(NetplayConfig const& config, std::string& error);
+
+        void send(void const* data, size_t size);
+
+        /**
+         * Send the delayed packets that are due
+         */
+        void flush();
+
+        /**
+         * Receive one datagram without blocking
+         * @return Its size, or -1 if none is waiting
+         */
+        int receive(void* buffer, size_t capacity);
+
+        uint64_t sent = 0;
+        uint64_t dropped = 0; // By the shim
+
+    private:
+        struct Delayed {
+            std::chrono::steady_clock::time_point due;
+            std::vector<uint8_t> data;
+        };
+
+        int fd = -1;
+        std::vector<uint8_t> address; // sockaddr of the peer
+        NetplayConfig config;
+        std::mt19937 random;
+        std::deque<Delayed> delayed;
+};
+
+struct NetplayStats {
+    uint64_t stalls = 0; // Frames waited because the peer was too far behind
+    uint64_t packetsReceived = 0;
+    uint64_t foreignPackets = 0; // Wrong magic or session
+    uint64_t checksumsCompared = 0;
+    bool desynced = false;
+    uint32_t desyncFrame = 0; // First frame whose checksums differed
+};
+
+/**
+ * A rollback session with a remote peer over UDP
+ *
+ * Call tick() once per 60Hz frame with the local keys: it takes every packet
+ * waiting, rolls back if the remote keys contradict the prediction, runs the
+ * next frame if the peer is not too far behind, and sends this peer's
+ * unacknowledged keys. core() is then the state to present.
+ *
+ * @param Q - Quirk profile of the core; both peers must use the same
+ */
+template <typename Q>
+class NetplaySession {
+    public:
+        NetplaySession(Chip8<Q> const& start, uint32_t session, RollbackConfig const& rollbackConfig,
+                       NetplayConfig const& config);
+
+        bool open(std::string& error) { return link.open(config, error); }
+
+        /**
+         * Exchange packets and run the next frame unless advancing is false
+         * or the peer is too far behind
+         * @return True if a frame ran
+         */
+        bool tick(uint16_t keys, bool advancing = true);
+
+        /**
+         * True once both peers have every input before frame, so its state is
+         * final on both sides
+         */
+        bool settled(uint32_t frame) const;
+
+        Chip8<Q> const& core() const { return rollback->core(); }
+        Rollback<Q> const& simulation() const { return *rollback; }
+        NetplayStats const& stats() const { return statistics; }
+        UdpLink const& connection() const { return link; }
+
+    private:
+        void receive();
+        void send();
+        void compareChecksum();
+
+        NetplayConfig config;
+        uint32_t session;
+        std::unique_ptr<Rollback<Q>> rollback;
+        UdpLink link;
+        uint32_t remoteAck = 0; // The peer has this peer's keys for every frame before this
+        uint32_t remoteChecksumFrame = UINT32_MAX; // Newest checksum from the peer not compared yet
+        uint64_t remoteChecksum = 0;
+        NetplayStats statistics;
+};
+
+/**
+ * Hash of what both peers must agree on before they can play together
+ */
+uint32_t netplaySession(uint8_t const* rom, size_t size, int quirkProfile, RollbackConfig const& config);
+
+#endif
@@ -0,0 +1,308 @@
+#include "PerfCounters.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static char const* const EVENT_NAMES[PERF_EVENTS] = {
+    "cycles", "instructions", "branch-misses", "L1D-misses", "LLC-misses", "ns",
+};
+
+static char const* const CLASS_NAMES[16] = {
+    "0 CLS/RET", "1 JP", "2 CALL", "3 SE", "4 SNE", "5 SE", "6 LD", "7 ADD",
+    "8 ALU", "9 SNE", "A LD I", "B JP V0", "C RND", "D DRW", "E SKP", "F misc",
+};
+
+static int const CALIBRATION_READS = 1001;
+
+/**
+ * One hardware event, or a closed slot if it is unavailable
+ */
+struct PerfCounter {
+    int fd = -1;
+    void* page = nullptr; // perf_event_mmap_page for rdpmc, null if it could not be mapped
+    std::string error; // Why the event is unavailable
+};
+
+/**
+ * Events charged to one OP code class
+ */
+struct PerfClass {
+    uint64_t count = 0;
+    int64_t sums[PERF_EVENTS] = {};
+};
+
+static PerfCounter counters[PERF_NANOSECONDS];
+static int sampleInterval = 8;
+static uint64_t overhead[PERF_EVENTS]; // Median cost of one read
+static bool opened = false;
+
+static uint64_t frame = 0;
+static uint64_t frameStart[PERF_EVENTS];
+static uint64_t frameTotals[PERF_EVENTS];
+static uint64_t measuredFrames = 0;
+static uint64_t measuredInstructions = 0;
+static uint64_t sampledFrames = 0;
+static PerfClass classes[16];
+
+static std::chrono::steady_clock::time_point startTime;
+
+#ifdef __linux__
+/**
+ * Why perf_event_open failed, in terms of what to do about it
+ */
+static std::string describeError(int error) {
+    switch (error) {
+        case ENOENT:
+        case EOPNOTSUPP:
+            return "not supported by this CPU or VM";
+        case EACCES:
+        case EPERM:
+            return "not permitted, see /proc/sys/kernel/perf_event_paranoid";
+        case ENOSYS:
+            return "perf_event_open is not available";
+        default:
+            return strerror(error);
+    }
+}
+
+static void openCounter(PerfCounter& counter, uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // A pinned event is never multiplexed, so its count needs no scaling; if
+    // it cannot get a counter it reads as end of file instead
+    attr.pinned = 1;
+
+    counter.fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (counter.fd < 0) {
+        counter.error = describeError(errno);
+        return;
+    }
+    uint64_t value;
+    if (::read(counter.fd, &value, sizeof(value)) != sizeof(value)) {
+        counter.error = "no hardware counter free";
+        close(counter.fd);
+        counter.fd = -1;
+        return;
+    }
+    void* page = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, counter.fd, 0);
+    counter.page = page == MAP_FAILED ? nullptr : page;
+}
+
+/**
+ * Read one event with rdpmc if the kernel has it on a counter and lets user
+ * space read it, otherwise with read()
+ */
+static uint64_t readCounter(PerfCounter const& counter) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (counter.page) {
+        perf_event_mmap_page volatile* page = static_cast<perf_event_mmap_page volatile*>(counter.page);
+        uint32_t sequence;
+        uint64_t count;
+        bool direct;
+        do {
+            sequence = page->lock;
+            asm volatile("" ::: "memory");
+            uint32_t index = page->index;
+            direct = page->cap_user_rdpmc && index != 0;
+            count = page->offset;
+            if (direct) {
+                int shift = 64 - page->pmc_width;
+                count += int64_t(uint64_t(__builtin_ia32_rdpmc(index - 1)) << shift) >> shift;
+            }
+            asm volatile("" ::: "memory");
+        } while (page->lock != sequence);
+        if (direct) {
+            return count;
+        }
+    }
+#endif
+    uint64_t value = 0;
+    if (::read(counter.fd, &value, sizeof(value)) != sizeof(value)) {
+        return 0;
+    }
+    return value;
+}
+#endif
+
+bool PerfCounters::start(int sampleEvery) {
+    sampleInterval = std::max(sampleEvery, 1);
+    startTime = std::chrono::steady_clock::now();
+
+#ifdef __linux__
+    uint64_t const CACHE_READ_MISS = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    openCounter(counters[PERF_CYCLES], PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    openCounter(counters[PERF_INSTRUCTIONS], PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    openCounter(counters[PERF_BRANCH_MISSES], PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    openCounter(counters[PERF_L1D_MISSES], PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | CACHE_READ_MISS);
+    openCounter(counters[PERF_LLC_MISSES], PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | CACHE_READ_MISS);
+#else
+    for (PerfCounter& counter : counters) {
+        counter.error = "perf_event_open is Linux only";
+    }
+#endif
+    opened = true;
+
+    // The median of back-to-back reads is what one reading adds to the next
+    std::vector<uint64_t> samples[PERF_EVENTS];
+    uint64_t before[PERF_EVENTS];
+    uint64_t after[PERF_EVENTS];
+    for (int i = 0; i < CALIBRATION_READS; i++) {
+        read(before);
+        read(after);
+        for (int event = 0; event < PERF_EVENTS; event++) {
+            samples[event].push_back(after[event] - before[event]);
+        }
+    }
+    for (int event = 0; event < PERF_EVENTS; event++) {
+        std::nth_element(samples[event].begin(), samples[event].begin() + CALIBRATION_READS / 2, samples[event].end());
+        overhead[event] = samples[event][CALIBRATION_READS / 2];
+    }
+
+    return std::any_of(std::begin(counters), std::end(counters), [](PerfCounter const& counter) { return counter.fd >= 0; });
+}
+
+void PerfCounters::stop() {
+#ifdef __linux__
+    for (PerfCounter& counter : counters) {
+        if (counter.page) {
+            munmap(counter.page, sysconf(_SC_PAGESIZE));
+            counter.page = nullptr;
+        }
+        if (counter.fd >= 0) {
+            close(counter.fd);
+            counter.fd = -1;
+        }
+    }
+#endif
+    opened = false;
+    sampled = false;
+}
+
+void PerfCounters::read(uint64_t (&values)[PERF_EVENTS]) {
+    for (int event = 0; event < PERF_NANOSECONDS; event++) {
+#ifdef __linux__
+        values[event] = counters[event].fd >= 0 ? readCounter(counters[event]) : 0;
+#else
+        values[event] = 0;
+#endif
+    }
+    values[PERF_NANOSECONDS] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+}
+
+void PerfCounters::beginFrame() {
+    if (!opened) {
+        return;
+    }
+    sampled = frame % sampleInterval == uint64_t(sampleInterval - 1);
+    if (!sampled) {
+        read(frameStart);
+    }
+}
+
+void PerfCounters::endFrame(int instructions) {
+    if (!opened) {
+        return;
+    }
+    frame++;
+    if (sampled) {
+        sampled = false;
+        sampledFrames++;
+        return;
+    }
+    uint64_t now[PERF_EVENTS];
+    read(now);
+    for (int event = 0; event < PERF_EVENTS; event++) {
+        uint64_t delta = now[event] - frameStart[event];
+        frameTotals[event] += delta > overhead[event] ? delta - overhead[event] : 0;
+    }
+    measuredFrames++;
+    measuredInstructions += instructions;
+}
+
+void PerfCounters::instruction(uint16_t opcode, uint64_t const (&before)[PERF_EVENTS]) {
+    uint64_t after[PERF_EVENTS];
+    read(after);
+    // Kept signed: a reading below the median overhead is noise that the
+    // readings above it balance out over many instructions
+    PerfClass& opClass = classes[opcode >> 12];
+    opClass.count++;
+    for (int event = 0; event < PERF_EVENTS; event++) {
+        opClass.sums[event] += int64_t(after[event] - before[event]) - int64_t(overhead[event]);
+    }
+}
+
+void PerfCounters::report(std::ostream& out) {
+    bool available[PERF_EVENTS];
+    for (int event = 0; event < PERF_EVENTS; event++) {
+        available[event] = event == PERF_NANOSECONDS || counters[event].error.empty();
+    }
+
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed;
+    out << "Perf counters: " << measuredFrames << " frames, " << measuredInstructions << " instructions ("
+        << sampledFrames << " more frames sampled per instruction)" << std::endl;
+    out << std::left << std::setw(16) << "event" << std::right << std::setw(14) << "per frame"
+        << std::setw(18) << "per instruction" << std::endl;
+    for (int event = 0; event < PERF_EVENTS; event++) {
+        if (!available[event]) {
+            continue;
+        }
+        out << std::left << std::setw(16) << EVENT_NAMES[event] << std::right << std::setprecision(1)
+            << std::setw(14) << double(frameTotals[event]) / std::max<uint64_t>(measuredFrames, 1)
+            << std::setprecision(3)
+            << std::setw(18) << double(frameTotals[event]) / std::max<uint64_t>(measuredInstructions, 1) << std::endl;
+    }
+
+    uint64_t sampledInstructions = 0;
+    for (PerfClass const& opClass : classes) {
+        sampledInstructions += opClass.count;
+    }
+    if (sampledInstructions > 0) {
+        out << "By OP code class, per instruction, less the cost of a read:" << std::endl;
+        out << std::left << std::setw(12) << "class" << std::right << std::setw(8) << "share";
+        for (int event = 0; event < PERF_EVENTS; event++) {
+            if (available[event]) {
+                out << std::setw(14) << EVENT_NAMES[event];
+            }
+        }
+        out << std::endl;
+        for (int n1 = 0; n1 < 16; n1++) {
+            PerfClass const& opClass = classes[n1];
+            if (opClass.count == 0) {
+                continue;
+            }
+            out << std::left << std::setw(12) << CLASS_NAMES[n1] << std::right << std::setprecision(1)
+                << std::setw(7) << 100.0 * opClass.count / sampledInstructions << "%" << std::setprecision(2);
+            for (int event = 0; event < PERF_EVENTS; event++) {
+                if (available[event]) {
+                    out << std::setw(14) << std::max(0.0, double(opClass.sums[event]) / opClass.count);
+                }
+            }
+            out << std::endl;
+        }
+    }
+
+    for (int event = 0; event < PERF_NANOSECONDS; event++) {
+        if (!available[event]) {
+            out << EVENT_NAMES[event] << " unavailable: " << counters[event].error << std::endl;
+        }
+    }
+    out.flags(flags);
+}
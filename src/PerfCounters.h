@@ -0,0 +1,80 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <iosfwd>
+
+/**
+ * Host events counted around the execution loop
+ */
+enum PerfEvent {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES, // L1 data cache read misses
+    PERF_LLC_MISSES, // Last-level cache read misses
+    PERF_NANOSECONDS, // Steady clock, counted even when no hardware event is available
+    PERF_EVENTS,
+};
+
+/**
+ * Hardware performance counters around the execution loop, read with Linux
+ * perf_event_open
+ *
+ * The events count the thread that called start(), in user space only. The
+ * front end brackets each frame with beginFrame() and endFrame(). Every
+ * sampleEvery-th frame is sampled instead: the core reads the counters around
+ * each instruction (Chip8::profiledCycle) and charges the difference to the
+ * instruction's class, its first nibble. Sampled frames are left out of the
+ * frame totals, which their extra reads would inflate, and the cost of one
+ * read, measured by start(), is taken off every per-instruction reading.
+ *
+ * Counters are read with rdpmc where the kernel allows it, which costs tens
+ * of cycles, and with read() otherwise. Events the host cannot count (a VM
+ * without a virtual PMU, perf_event_paranoid too high, no Linux) are reported
+ * as unavailable and the rest still work.
+ */
+class PerfCounters {
+public:
+    /**
+     * Open the counters on the calling thread and measure the cost of a read
+     * @param sampleEvery Sample one frame in this many
+     * @return True if any hardware event could be opened
+     */
+    static bool start(int sampleEvery = 8);
+
+    /**
+     * Close the counters; the totals are kept for report()
+     */
+    static void stop();
+
+    /**
+     * True while the current frame is sampled per instruction, on the thread
+     * that called start() only
+     */
+    static bool sampling() { return sampled; }
+
+    static void beginFrame();
+    static void endFrame(int instructions);
+
+    /**
+     * Read every event; unavailable events read as 0
+     */
+    static void read(uint64_t (&values)[PERF_EVENTS]);
+
+    /**
+     * Charge the events since before to the class of instruction
+     */
+    static void instruction(uint16_t opcode, uint64_t const (&before)[PERF_EVENTS]);
+
+    /**
+     * Print the totals per frame and per emulated instruction, the breakdown
+     * by OP code class and the events that were unavailable
+     */
+    static void report(std::ostream& out);
+
+private:
+    static inline thread_local bool sampled = false;
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include <cstring>
+#include "Predecoded.h"
+#include "QuirkDetect.h"
+using namespace std;
+
+/**
+ * Translation of an empty machine, so a core runs (no-ops) before loadRom()
+ */
+static shared_ptr<Translation const> blankTranslation() {
+    static uint8_t const memory[Translation::ENTRIES] = {};
+    static shared_ptr<Translation const> const blank = make_shared<Translation const>(memory);
+    return blank;
+}
+
+template <typename Q>
+Predecoded<Q>::Predecoded(TranslationCache* cache) : cache(cache), translation(blankTranslation()) {
+    ops = translation->ops();
+}
+
+/**
+ * Reset the machine, load the fonts and the ROM, and take the translation of
+ * the image from the cache
+ */
+template <typename Q>
+bool Predecoded<Q>::loadRom(uint8_t const* data, size_t size) {
+    // Start from a blank machine, so the image is exactly what the key names
+    chip8 = Chip8<Q>();
+    chip8.loadFonts();
+    if (!chip8.loadRom(data, size)) {
+        return false;
+    }
+
+    own.reset();
+    if (cache) {
+        uint32_t profile = Q::CP_SHIFT << 2 | Q::SC_JUMP << 1 | Q::COSMAC_MEM;
+        translation = cache->get({romHash(data, size), uint32_t(size), profile}, chip8.memory);
+    }
+    else {
+        translation = make_shared<Translation const>(chip8.memory);
+    }
+    ops = translation->ops();
+    return true;
+}
+
+template <typename Q>
+void Predecoded<Q>::retranslate() {
+    if (!own) {
+        own.reset(new DecodedOp[Translation::ENTRIES]);
+    }
+    for (int address = 0; address < Translation::ENTRIES; address++) {
+        own[address] = decodeOp(chip8.memory[address], chip8.memory[(address + 1) & 0xFFF]);
+    }
+    ops = own.get();
+}
+
+template <typename Q>
+TranslationSource Predecoded<Q>::source() const {
+    return translation->source;
+}
+
+template <typename Q>
+string const& Predecoded<Q>::rejected() const {
+    return translation->rejected;
+}
+
+/**
+ * The table to change, copied from the shared translation the first time
+ */
+template <typename Q>
+DecodedOp* Predecoded<Q>::writableOps() {
+    if (!own) {
+        own.reset(new DecodedOp[Translation::ENTRIES]);
+        memcpy(own.get(), ops, Translation::ENTRIES * sizeof(DecodedOp));
+        ops = own.get();
+    }
+    return own.get();
+}
+
+/**
+ * Mark the instructions that overlap length bytes stored at address stale
+ */
+template <typename Q>
+void Predecoded<Q>::invalidate(uint16_t address, int length) {
+    DecodedOp* table = writableOps();
+    // The instruction starting one byte before address ends in it
+    for (int i = -1; i < length; i++) {
+        table[(address + i) & 0xFFF].handler = DECODED_STALE;
+    }
+}
+
+/**
+ * Decode the instruction at a stale address from memory and keep it
+ */
+template <typename Q>
+DecodedOp Predecoded<Q>::redecode(uint16_t address) {
+    address &= 0xFFF;
+    DecodedOp op = decodeOp(chip8.memory[address], chip8.memory[(address + 1) & 0xFFF]);
+    writableOps()[address] = op;
+    return op;
+}
+
+/**
+ * Execute one instruction
+ */
+template <typename Q>
+void Predecoded<Q>::cycle() {
+    DecodedOp op = ops[chip8.pc & 0xFFF];
+    chip8.pc += 2;
+    execute(op);
+}
+
+/**
+ * Run one 60Hz frame, as Chip8::runFrame()
+ */
+template <typename Q>
+void Predecoded<Q>::runFrame(int instructions) {
+    for (int i = 0; i < instructions; i++) {
+        cycle();
+    }
+    chip8.updateTimers();
+}
+
+/**
+ * Run one 60Hz frame on the COSMAC VIP clock, as Chip8::runFrameVip(), with
+ * each instruction's cost taken from the table
+ *
+ * @return Number of instructions executed this frame
+ */
+template <typename Q>
+int Predecoded<Q>::runFrameVip() {
+    int executed = 0;
+    chip8.vipCycles += Chip8<Q>::VIP_CYCLES_PER_FRAME - Chip8<Q>::VIP_INTERRUPT_CYCLES;
+    while (chip8.vipCycles > 0) {
+        DecodedOp op = ops[chip8.pc & 0xFFF];
+        if (op.handler == DECODED_STALE) {
+            // Needed before the cost is charged
+            op = redecode(chip8.pc);
+        }
+        chip8.pc += 2;
+        execute(op);
+        executed++;
+        if (op.handler == DECODED_Dxyn) {
+            chip8.vipCycles = -int32_t(op.vipCost);
+            break;
+        }
+        chip8.vipCycles -= op.vipCost;
+    }
+    chip8.updateTimers();
+    return executed;
+}
+
+/**
+ * Run a decoded instruction on the machine's OP_* handlers
+ *
+ * x is masked again because a mapped table is only as trustworthy as the
+ * cache directory.
+ */
+template <typename Q>
+void Predecoded<Q>::execute(DecodedOp op) {
+    uint8_t x = op.x & 0xF;
+    uint8_t kk = op.kk;
+    uint8_t y = kk >> 4;
+    uint16_t nnn = x << 8 | kk;
+
+    switch (op.handler) {
+        case DECODED_00E0: chip8.OP_00E0(); break;
+        case DECODED_00EE: chip8.OP_00EE(); break;
+        case DECODED_1nnn: chip8.OP_1nnn(nnn); break;
+        case DECODED_2nnn: chip8.OP_2nnn(nnn); break;
+        case DECODED_3xkk: chip8.OP_3xkk(x, kk); break;
+        case DECODED_4xkk: chip8.OP_4xkk(x, kk); break;
+        case DECODED_5xy0: chip8.OP_5xy0(x, y); break;
+        case DECODED_6xkk: chip8.OP_6xkk(x, kk); break;
+        case DECODED_7xkk: chip8.OP_7xkk(x, kk); break;
+        case DECODED_8xy0: chip8.OP_8xy0(x, y); break;
+        case DECODED_8xy1: chip8.OP_8xy1(x, y); break;
+        case DECODED_8xy2: chip8.OP_8xy2(x, y); break;
+        case DECODED_8xy3: chip8.OP_8xy3(x, y); break;
+        case DECODED_8xy4: chip8.OP_8xy4(x, y); break;
+        case DECODED_8xy5: chip8.OP_8xy5(x, y); break;
+        case DECODED_8xy6: chip8.OP_8xy6(x, y); break;
+        case DECODED_8xy7: chip8.OP_8xy7(x, y); break;
+        case DECODED_8xyE: chip8.OP_8xyE(x, y); break;
+        case DECODED_9xy0: chip8.OP_9xy0(x, y); break;
+        case DECODED_Annn: chip8.OP_Annn(nnn); break;
+        case DECODED_Bnnn: chip8.OP_Bnnn(nnn); break;
+        case DECODED_Cxkk: chip8.OP_Cxkk(x, kk); break;
+        case DECODED_Dxyn: chip8.OP_Dxyn(x, y, kk & 0xF); break;
+        case DECODED_Ex9E: chip8.OP_Ex9E(x); break;
+        case DECODED_ExA1: chip8.OP_ExA1(x); break;
+        case DECODED_Fx07: chip8.OP_Fx07(x); break;
+        case DECODED_Fx0A: chip8.OP_Fx0A(x); break;
+        case DECODED_Fx15: chip8.OP_Fx15(x); break;
+        case DECODED_Fx18: chip8.OP_Fx18(x); break;
+        case DECODED_Fx1E: chip8.OP_Fx1E(x); break;
+        case DECODED_Fx29: chip8.OP_Fx29(x); break;
+        case DECODED_Fx65: chip8.OP_Fx65(x); break;
+
+        // The only OP codes that store to memory, and so may change code
+        case DECODED_Fx33: {
+            uint16_t address = chip8.I;
+            chip8.OP_Fx33(x);
+            invalidate(address, 3);
+            break;
+        }
+        case DECODED_Fx55: {
+            uint16_t address = chip8.I;
+            chip8.OP_Fx55(x);
+            invalidate(address, x + 1);
+            break;
+        }
+
+        case DECODED_STALE:
+            execute(redecode(chip8.pc - 2));
+            break;
+
+        default:
+            chip8.invalidOpcodes++;
+            break;
+    }
+}
+
+
+/* Instantiations */
+
+template class Predecoded<Quirks<false, false, false>>;
+template class Predecoded<Quirks<false, false, true>>;
+template class Predecoded<Quirks<false, true, false>>;
+template class Predecoded<Quirks<false, true, true>>;
+template class Predecoded<Quirks<true, false, false>>;
+template class Predecoded<Quirks<true, false, true>>;
+template class Predecoded<Quirks<true, true, false>>;
+template class Predecoded<Quirks<true, true, true>>;
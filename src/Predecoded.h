@@ -0,0 +1,88 @@
+#ifndef PREDECODED_H
+#define PREDECODED_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "TranslationCache.h"
+#include "chip8.h"
+
+/**
+ * The CHIP-8 core running from a predecoded instruction table
+ *
+ * Chip8::cycle() fetches two bytes and decodes them through nested switches
+ * on every instruction. Here each address of the loaded image is decoded
+ * once, into a Translation of handler, operands and VIP cost, and an
+ * instruction is one table load and one dense switch. The VIP frame loop
+ * charges the predecoded cost instead of looking it up.
+ *
+ * The translation comes from a TranslationCache when one is given, so a ROM
+ * started again, in this process or another, maps the table decoded by the
+ * first start instead of decoding it. It is shared and read-only, so the
+ * first store (Fx33, Fx55) gives this core a private copy of the table. A
+ * store marks the entries it overlaps stale, and each is decoded again when
+ * it is next executed, so self-modifying code runs the new instructions and
+ * stores to data cost no decoding at all.
+ *
+ * Behaves exactly as Chip8<Q> (difftest checks this), except that it has no
+ * trace or profiling variant of the loop. Memory changed other than through
+ * loadRom() and the OP codes needs retranslate().
+ *
+ * @param Q - Quirk profile, a Quirks<...> instantiation
+ */
+template <typename Q>
+class Predecoded {
+    public:
+        Chip8<Q> chip8; // The machine state
+
+        /**
+         * @param cache - Where loadRom() takes translations from, or null to decode privately
+         */
+        explicit Predecoded(TranslationCache* cache = nullptr);
+
+        Predecoded(Predecoded const&) = delete;
+        Predecoded& operator=(Predecoded const&) = delete;
+
+        /**
+         * Load the fonts and a ROM image, and translate the result
+         */
+        bool loadRom(uint8_t const* data, size_t size);
+
+        /**
+         * Decode the whole memory again, into a private table
+         */
+        void retranslate();
+
+        void cycle();
+        void runFrame(int instructions);
+        int runFrameVip();
+        void updateTimers() { chip8.updateTimers(); }
+
+        /**
+         * How the translation loadRom() started from was made
+         */
+        TranslationSource source() const;
+
+        /**
+         * Why a cache file was not used, empty if none was rejected
+         */
+        std::string const& rejected() const;
+
+        /**
+         * True while the core runs from the shared table, false after a store made it copy it
+         */
+        bool shared() const { return !own; }
+
+    private:
+        void execute(DecodedOp op);
+        void invalidate(uint16_t address, int length);
+        DecodedOp redecode(uint16_t address);
+        DecodedOp* writableOps();
+
+        TranslationCache* cache;
+        std::shared_ptr<Translation const> translation;
+        std::unique_ptr<DecodedOp[]> own; // Private table once the code changed
+        DecodedOp const* ops;
+};
+
+#endif
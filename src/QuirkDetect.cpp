@@ -0,0 +1,167 @@
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+#include "QuirkDetect.h"
+#include "WorkerPool.h"
+#include "chip8.h"
+using namespace std;
+
+string QuirkFlags::describe() const {
+    string text;
+    if (cpShift) text += " --cp_shift";
+    if (scJump) text += " --sc_jump";
+    if (cosmacMem) text += " --cosmac_mem";
+    return text.empty() ? "none" : text.substr(1);
+}
+
+uint64_t romHash(uint8_t const* rom, size_t size) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ rom[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static double const DIVERGENCE_BONUS = 5; // Added to a faultless run that differs from the default
+
+/**
+ * Run the ROM under one profile and fill in everything but flags and score
+ */
+template <typename Q>
+static void runProfile(uint8_t const* rom, size_t size, int frames, int instructionsPerFrame, QuirkRun& run) {
+    Chip8<Q> chip8;
+    chip8.loadFonts();
+    chip8.loadRom(rom, size);
+
+    unordered_set<uint64_t> displays;
+    uint64_t trace = 0xCBF29CE484222325ull;
+    uint32_t rng = 0x2545F491;
+    for (int frame = 0; frame < frames; frame++) {
+        // The same key script for every profile, so their runs only differ by the quirks
+        if ((frame & 7) == 0) {
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            chip8.keys ^= 1 << (rng & 0xF);
+        }
+        chip8.runFrame(instructionsPerFrame);
+
+        if (chip8.drawFlag) {
+            chip8.drawFlag = false;
+            uint64_t display = chip8.frameHash();
+            displays.insert(display);
+            trace = (trace ^ display) * 0x100000001B3ull;
+            run.drawFrames++;
+        }
+        if (chip8.sp > 16) {
+            run.stackFaults++;
+        }
+        uint16_t pc = chip8.pc & 0xFFF;
+        if (pc < Chip8<Q>::START_ADDRESS || pc >= Chip8<Q>::START_ADDRESS + size) {
+            run.strayFrames++;
+        }
+    }
+
+    // Runs that drew the same but ended in different states did diverge
+    run.trace = romHash(chip8.registers, sizeof(chip8.registers)) ^ (trace * 31 + chip8.pc) ^ (uint64_t(chip8.I) << 48);
+    run.invalidOpcodes = chip8.invalidOpcodes;
+    run.distinctFrames = displays.size();
+}
+
+QuirkDetection detectQuirks(uint8_t const* rom, size_t size, int frames, int instructionsPerFrame) {
+    auto start = chrono::steady_clock::now();
+    QuirkDetection detection;
+
+    WorkerPool pool(8);
+    pool.parallelFor(8, [&](size_t profile, size_t) {
+        QuirkRun& run = detection.runs[profile];
+        run.flags.cpShift = profile & 4;
+        run.flags.scJump = profile & 2;
+        run.flags.cosmacMem = profile & 1;
+        withQuirks(run.flags.cpShift, run.flags.scJump, run.flags.cosmacMem, [&](auto quirks) {
+            runProfile<decltype(quirks)>(rom, size, frames, instructionsPerFrame, run);
+        });
+        run.score = run.distinctFrames + run.drawFrames / 10.0
+                  - 10.0 * run.invalidOpcodes - 10.0 * run.strayFrames - 100.0 * run.stackFaults;
+    });
+
+    // A profile only counts if each of its flags changed the run: with the
+    // same trace as the profile without a flag, that flag had no effect and
+    // the profile without it stands for both. Quirks the ROM never exercises
+    // stay off this way, even when two different runs happen to score the same.
+    bool effective[8];
+    for (int profile = 0; profile < 8; profile++) {
+        effective[profile] = true;
+        for (int flag = 1; flag < 8; flag <<= 1) {
+            if ((profile & flag) && detection.runs[profile].trace == detection.runs[profile & ~flag].trace) {
+                effective[profile] = false;
+            }
+        }
+
+        // Diverging from the default without any fault is a sign the quirk is expected
+        QuirkRun& run = detection.runs[profile];
+        if (profile && effective[profile] && run.trace != detection.runs[0].trace &&
+            !run.invalidOpcodes && !run.strayFrames && !run.stackFaults) {
+            run.score += DIVERGENCE_BONUS;
+        }
+    }
+
+    int best = 0;
+    for (int profile = 1; profile < 8; profile++) {
+        QuirkRun const& run = detection.runs[profile];
+        QuirkRun const& leader = detection.runs[best];
+        if (effective[profile] && (run.score > leader.score ||
+            (run.score == leader.score && __builtin_popcount(profile) < __builtin_popcount(best)))) {
+            best = profile;
+        }
+    }
+    detection.flags = detection.runs[best].flags;
+    detection.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return detection;
+}
+
+static filesystem::path cachePath() {
+    char const* cache = getenv("XDG_CACHE_HOME");
+    char const* home = getenv("HOME");
+    if (cache && *cache) {
+        return filesystem::path(cache) / "chip8" / "quirks";
+    }
+    return home ? filesystem::path(home) / ".cache" / "chip8" / "quirks" : filesystem::path();
+}
+
+QuirkDetection detectQuirksCached(uint8_t const* rom, size_t size) {
+    auto start = chrono::steady_clock::now();
+    uint64_t hash = romHash(rom, size);
+    filesystem::path path = cachePath();
+
+    // One line per ROM: hash and the three flags; a later line wins
+    QuirkDetection detection;
+    ifstream in{path};
+    string line;
+    while (getline(in, line)) {
+        istringstream fields(line);
+        uint64_t key;
+        int cpShift, scJump, cosmacMem;
+        if (fields >> hex >> key >> dec >> cpShift >> scJump >> cosmacMem && key == hash) {
+            detection.flags = {cpShift != 0, scJump != 0, cosmacMem != 0};
+            detection.cached = true;
+        }
+    }
+    if (detection.cached) {
+        detection.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return detection;
+    }
+
+    detection = detectQuirks(rom, size);
+    if (!path.empty()) {
+        error_code error;
+        filesystem::create_directories(path.parent_path(), error);
+        ofstream out{path, ios::app};
+        out << hex << hash << dec << " " << detection.flags.cpShift << " " << detection.flags.scJump << " "
+            << detection.flags.cosmacMem << "\n";
+    }
+    return detection;
+}
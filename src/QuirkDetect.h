@@ -0,0 +1,76 @@
+#ifndef QUIRK_DETECT_H
+#define QUIRK_DETECT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * A quirk profile as the runtime flags withQuirks() takes
+ */
+struct QuirkFlags {
+    bool cpShift = false;
+    bool scJump = false;
+    bool cosmacMem = false;
+
+    /**
+     * The flags as command-line options, e.g. "--cp_shift --sc_jump", or "none"
+     */
+    std::string describe() const;
+};
+
+/**
+ * What one profile did during detection
+ */
+struct QuirkRun {
+    QuirkFlags flags;
+    uint64_t invalidOpcodes = 0; // OP codes the core does not implement
+    uint64_t stackFaults = 0; // Frames that ended with sp outside the stack
+    uint64_t strayFrames = 0; // Frames that ended with pc outside the ROM
+    uint64_t drawFrames = 0; // Frames that drew
+    uint64_t distinctFrames = 0; // Distinct displays among the frames that drew
+    uint64_t trace = 0; // Hash of every display in order; equal traces mean the runs behaved the same
+    double score = 0;
+};
+
+/**
+ * Outcome of detectQuirks()
+ */
+struct QuirkDetection {
+    QuirkFlags flags; // The chosen profile
+    QuirkRun runs[8]; // Indexed like withQuirks(): cpShift << 2 | scJump << 1 | cosmacMem
+    bool cached = false; // Taken from the cache; runs is empty
+    double seconds = 0;
+};
+
+/**
+ * Pick a quirk profile for a ROM by running it under every profile
+ *
+ * The 8 profiles run in parallel on a WorkerPool for the same frames of
+ * scripted input. Each run is scored: displays that keep changing count for
+ * it; invalid OP codes, a stack that over- or underflowed and pc straying
+ * outside the ROM count heavily against it, and a faultless run that
+ * diverges from the default profile's counts for it. Divergence is decided
+ * by the runs' traces: a profile with a flag whose run has the same trace as
+ * the profile without that flag is out, so quirks the ROM never exercises
+ * stay off. The best score among the rest wins, ties going to the profile
+ * with the fewest flags.
+ *
+ * @param frames - Frames to run each profile for; 600 is 10 seconds of play
+ */
+QuirkDetection detectQuirks(uint8_t const* rom, size_t size, int frames = 600, int instructionsPerFrame = 11);
+
+/**
+ * detectQuirks() behind a cache of earlier results keyed by the ROM's hash
+ *
+ * The cache is a text file in $XDG_CACHE_HOME/chip8 (or ~/.cache/chip8).
+ * Failing to read or write it only costs a detection.
+ */
+QuirkDetection detectQuirksCached(uint8_t const* rom, size_t size);
+
+/**
+ * 64-bit FNV-1a hash of a ROM image
+ */
+uint64_t romHash(uint8_t const* rom, size_t size);
+
+#endif
@@ -0,0 +1,200 @@
+#include "Recorder.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+static int const SAMPLE_RATE = 44100;
+static int const AMPLITUDE = 28000;
+static int const FREQUENCY = 440;
+
+/**
+ * Store the low bytes of value at data + offset, little-endian
+ */
+static void put(uint8_t* data, size_t offset, uint64_t value, int bytes) {
+    for (int b = 0; b < bytes; b++) {
+        data[offset + b] = uint8_t(value >> (8 * b));
+    }
+}
+
+Recorder::Recorder(std::string const& path, bool raw) {
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Unable to open " << path << " for recording" << std::endl;
+        return;
+    }
+
+    uint8_t header[14] = {'C', '8', 'R', 'E', 'C', 0};
+    put(header, 6, VERSION, 2);
+    put(header, 8, WIDTH, 2);
+    put(header, 10, HEIGHT, 2);
+    put(header, 12, FPS, 2);
+    fwrite(header, 1, sizeof(header), file);
+    written += sizeof(header);
+
+    if (raw) {
+        y4m = fopen((path + ".y4m").c_str(), "wb");
+        wav = fopen((path + ".wav").c_str(), "wb");
+        if (y4m) {
+            fprintf(y4m, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", WIDTH, HEIGHT, FPS);
+        }
+        if (wav) {
+            // Sizes are patched in by finishWav()
+            uint8_t wavHeader[44]{};
+            fwrite(wavHeader, 1, sizeof(wavHeader), wav);
+        }
+    }
+
+    writer = std::thread(&Recorder::writerLoop, this);
+}
+
+Recorder::~Recorder() {
+    if (!file) {
+        return;
+    }
+    stopping.store(true, std::memory_order_release);
+    writer.join();
+
+    fclose(file);
+    if (y4m) {
+        fclose(y4m);
+    }
+    if (wav) {
+        finishWav();
+        fclose(wav);
+    }
+}
+
+/**
+ * Copy the display and hand it to the writer thread
+ */
+void Recorder::push(uint64_t const* rows, bool beep) {
+    if (!file) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    Frame frame;
+    frame.number = frameNumber++;
+    frame.beep = beep;
+    memcpy(frame.rows, rows, sizeof(frame.rows));
+
+    if (!queue.tryPush(frame)) {
+        dropped++;
+    }
+    pushNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Drain the queue until the recorder is destroyed
+ */
+void Recorder::writerLoop() {
+    Frame frame;
+    while (true) {
+        if (queue.tryPop(frame)) {
+            writeFrame(frame);
+            continue;
+        }
+        if (stopping.load(std::memory_order_acquire)) {
+            // Frames pushed before stopping was set are still in the queue
+            while (queue.tryPop(frame)) {
+                writeFrame(frame);
+            }
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(4));
+    }
+}
+
+/**
+ * Delta-encode one frame against the previous record
+ */
+void Recorder::writeFrame(Frame const& frame) {
+    uint8_t record[7 + HEIGHT * 8];
+    uint16_t gap = wroteAny ? uint16_t(frame.number - lastNumber) : 1;
+    uint32_t rowMask = 0;
+    size_t length = 7;
+
+    for (int y = 0; y < HEIGHT; y++) {
+        if (!wroteAny || frame.rows[y] != previous[y]) {
+            rowMask |= 1u << y;
+            put(record, length, frame.rows[y], 8);
+            length += 8;
+        }
+    }
+    record[0] = frame.beep ? 1 : 0;
+    put(record, 1, gap, 2);
+    put(record, 3, rowMask, 4);
+    fwrite(record, 1, length, file);
+    written.fetch_add(length, std::memory_order_relaxed);
+
+    if (y4m || wav) {
+        // Hold the last recorded frame through any dropped ones
+        Frame held;
+        held.beep = frame.beep;
+        memcpy(held.rows, previous, sizeof(previous));
+        for (uint16_t i = 1; wroteAny && i < gap; i++) {
+            writeRaw(held);
+        }
+        writeRaw(frame);
+    }
+
+    memcpy(previous, frame.rows, sizeof(previous));
+    lastNumber = frame.number;
+    wroteAny = true;
+}
+
+/**
+ * Append one frame of Y4M video and 1/60 s of WAV audio
+ */
+void Recorder::writeRaw(Frame const& frame) {
+    if (y4m) {
+        uint8_t luma[WIDTH * HEIGHT];
+        for (int y = 0; y < HEIGHT; y++) {
+            for (int x = 0; x < WIDTH; x++) {
+                luma[y * WIDTH + x] = (frame.rows[y] >> (WIDTH - 1 - x)) & 1 ? 0xFF : 0x00;
+            }
+        }
+        uint8_t chroma[WIDTH * HEIGHT / 2]; // Neutral U and V planes at 4:2:0
+        memset(chroma, 0x80, sizeof(chroma));
+        fputs("FRAME\n", y4m);
+        fwrite(luma, 1, sizeof(luma), y4m);
+        fwrite(chroma, 1, sizeof(chroma), y4m);
+    }
+
+    if (wav) {
+        uint8_t samples[SAMPLE_RATE / FPS * sizeof(int16_t)];
+        int period = SAMPLE_RATE / FREQUENCY;
+        for (int i = 0; i < SAMPLE_RATE / FPS; i++) {
+            int16_t sample = frame.beep ? (audioPhase < uint32_t(period / 2) ? AMPLITUDE : -AMPLITUDE) : 0;
+            put(samples, i * sizeof(int16_t), uint16_t(sample), 2);
+            audioPhase = (audioPhase + 1) % period;
+        }
+        fwrite(samples, 1, sizeof(samples), wav);
+        audioSamples += SAMPLE_RATE / FPS;
+    }
+}
+
+/**
+ * Write the RIFF header now that the length of the audio is known
+ */
+void Recorder::finishWav() {
+    uint32_t dataBytes = audioSamples * sizeof(int16_t);
+
+    // RIFF is little-endian whatever the host
+    uint8_t header[44];
+    memcpy(header, "RIFF", 4);
+    put(header, 4, 36 + dataBytes, 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put(header, 16, 16, 4); // Format chunk size
+    put(header, 20, 1, 2); // PCM
+    put(header, 22, 1, 2); // Channels
+    put(header, 24, SAMPLE_RATE, 4);
+    put(header, 28, SAMPLE_RATE * sizeof(int16_t), 4); // Byte rate
+    put(header, 32, sizeof(int16_t), 2); // Block align
+    put(header, 34, 16, 2); // Bits per sample
+    memcpy(header + 36, "data", 4);
+    put(header, 40, dataBytes, 4);
+
+    fseek(wav, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), wav);
+}
@@ -0,0 +1,103 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include "SpscQueue.h"
+
+/**
+ * Records gameplay without stalling emulation
+ *
+ * The emulation thread packs each frame into a 1bpp snapshot and pushes it
+ * onto a lock-free queue; it never waits on the disk. A background thread
+ * delta-encodes the frames into a compact file, and can also export raw Y4M
+ * video and WAV audio. Frames are dropped, and counted, when the queue is full.
+ *
+ * Compact format (little-endian on any host):
+ *   Header: "C8REC" 0x00, uint16 version, uint16 width, uint16 height, uint16 fps
+ *   Frame:  uint8 flags (bit 0: beep), uint16 frames since the previous
+ *           record (more than 1 after dropped frames), uint32 row mask, then
+ *           8 bytes for every row whose bit is set. Rows are diffed against
+ *           the previous record; the first record carries every row.
+ */
+class Recorder {
+public:
+    static int const WIDTH = 64;
+    static int const HEIGHT = 32;
+    static int const FPS = 60;
+    static uint16_t const VERSION = 1;
+
+    /**
+     * Constructor for the Recorder class, starts the writer thread
+     * @param path Path of the compact recording
+     * @param raw Also write path.y4m and path.wav
+     */
+    Recorder(std::string const& path, bool raw);
+
+    /**
+     * Destructor for the Recorder class, drains the queue and closes the files
+     */
+    ~Recorder();
+
+    Recorder(Recorder const&) = delete;
+    Recorder& operator=(Recorder const&) = delete;
+
+    /**
+     * True if the output files were opened
+     */
+    bool isOpen() const { return file != nullptr; }
+
+    /**
+     * Capture one emulated frame. Never blocks.
+     * @param rows The 64x32 display, one row per word with the leftmost pixel in the top bit
+     * @param beep True if the beep is playing this frame
+     */
+    void push(uint64_t const* rows, bool beep);
+
+    uint64_t framesCaptured() const { return frameNumber; }
+    uint64_t framesDropped() const { return dropped; }
+    uint64_t bytesWritten() const { return written.load(std::memory_order_relaxed); }
+
+    /**
+     * Wall time spent in push(), to report the cost to the emulation thread
+     */
+    double pushSeconds() const { return pushNanoseconds / 1e9; }
+
+private:
+    struct Frame {
+        uint32_t number;
+        bool beep;
+        uint64_t rows[HEIGHT];
+    };
+
+    void writerLoop();
+    void writeFrame(Frame const& frame);
+    void writeRaw(Frame const& frame);
+    void finishWav();
+
+    SpscQueue<Frame, 256> queue; // ~4 seconds of frames
+    FILE* file = nullptr;
+    FILE* y4m = nullptr;
+    FILE* wav = nullptr;
+    std::thread writer;
+    std::atomic<bool> stopping{false};
+
+    // Emulation thread only
+    uint32_t frameNumber = 0;
+    uint64_t dropped = 0;
+    uint64_t pushNanoseconds = 0;
+
+    // Writer thread only
+    uint64_t previous[HEIGHT]{};
+    bool wroteAny = false;
+    uint32_t lastNumber = 0;
+    uint32_t audioPhase = 0;
+    uint32_t audioSamples = 0;
+    std::atomic<uint64_t> written{0};
+};
+
+#endif
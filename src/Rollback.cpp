@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <chrono>
+#include "Rollback.h"
+#include "Search.h"
+#include "Trace.h"
+using namespace std;
+
+template <typename Q>
+Rollback<Q>::Rollback(Chip8<Q> const& start, int localPlayer, RollbackConfig const& config)
+    : config(config), localPlayer(localPlayer), current(start) {
+    this->config.maxPrediction = clamp(config.maxPrediction, 1, MAX_PREDICTION);
+    recordChecksums();
+}
+
+/**
+ * Run frame f on the current state, saving the state it starts from
+ */
+template <typename Q>
+void Rollback<Q>::runFrame(uint32_t f) {
+    snapshots[f % RING] = current;
+    current.keys = localInputs[f % RING] | remoteInputs[f % RING];
+    if (config.vipTiming) {
+        current.runFrameVip();
+    }
+    else {
+        int64_t speed = config.speed;
+        current.runFrame(int((f + 1) * speed / 60 - f * speed / 60));
+    }
+    // Nothing presents the display from here; the front end compares it
+    current.drawFlag = false;
+}
+
+template <typename Q>
+void Rollback<Q>::advance(uint16_t localKeys) {
+    localInputs[frame % RING] = localKeys & localMask();
+    if (frame >= remoteConfirmed) {
+        // Predict that the remote player still holds what they last did
+        remoteInputs[frame % RING] = remoteConfirmed > 0 ? remoteInputs[(remoteConfirmed - 1) % RING] : 0;
+    }
+    runFrame(frame);
+    frame++;
+    recordChecksums();
+}
+
+template <typename Q>
+void Rollback<Q>::addRemoteInput(uint32_t remoteFrame, uint16_t keys) {
+    if (remoteFrame != remoteConfirmed || remoteFrame >= frame + RING / 2) {
+        return;
+    }
+    keys &= PLAYER_KEYS[1 - localPlayer];
+    if (remoteFrame < frame && remoteInputs[remoteFrame % RING] != keys) {
+        rollbackFrom = min(rollbackFrom, remoteFrame);
+    }
+    remoteInputs[remoteFrame % RING] = keys;
+    remoteConfirmed++;
+}
+
+template <typename Q>
+void Rollback<Q>::synchronize() {
+    if (rollbackFrom == UINT32_MAX) {
+        recordChecksums();
+        return;
+    }
+
+    auto start = chrono::steady_clock::now();
+    uint32_t from = rollbackFrom;
+    rollbackFrom = UINT32_MAX;
+
+    // Frames still unconfirmed are predicted again from the newest keys
+    uint16_t latest = remoteInputs[(remoteConfirmed - 1) % RING];
+    for (uint32_t f = remoteConfirmed; f < frame; f++) {
+        remoteInputs[f % RING] = latest;
+    }
+
+    // Re-run frames are thrown-away history, so they are not traced again
+    uint8_t categories = Trace::pause();
+    current = snapshots[from % RING];
+    for (uint32_t f = from; f < frame; f++) {
+        runFrame(f);
+    }
+    Trace::resume(categories);
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    statistics.rollbacks++;
+    statistics.resimulatedFrames += frame - from;
+    statistics.maxDepth = max(statistics.maxDepth, int(frame - from));
+    statistics.rollbackSeconds += seconds;
+    statistics.maxRollbackSeconds = max(statistics.maxRollbackSeconds, seconds);
+    recordChecksums();
+}
+
+template <typename Q>
+uint32_t Rollback<Q>::finalFrame() const {
+    return min(min(frame, remoteConfirmed), rollbackFrom);
+}
+
+/**
+ * Hash the start state of every frame that became final since the last call
+ */
+template <typename Q>
+void Rollback<Q>::recordChecksums() {
+    uint32_t last = finalFrame();
+    for (; checksummed <= last; checksummed++) {
+        Chip8<Q> const& state = checksummed == frame ? current : snapshots[checksummed % RING];
+        checksums[checksummed % RING] = InputSearch<Q>::stateHash(state);
+    }
+}
+
+template <typename Q>
+bool Rollback<Q>::checksum(uint32_t f, uint64_t& hash) const {
+    if (f >= checksummed || f + RING <= checksummed) {
+        return false;
+    }
+    hash = checksums[f % RING];
+    return true;
+}
+
+
+/* Instantiations */
+
+template class Rollback<Quirks<false, false, false>>;
+template class Rollback<Quirks<false, false, true>>;
+template class Rollback<Quirks<false, true, false>>;
+template class Rollback<Quirks<false, true, true>>;
+template class Rollback<Quirks<true, false, false>>;
+template class Rollback<Quirks<true, false, true>>;
+template class Rollback<Quirks<true, true, false>>;
+template class Rollback<Quirks<true, true, true>>;
@@ -0,0 +1,118 @@
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+#include <cstdint>
+#include "chip8.h"
+
+/**
+ * Keypad halves for two players, as bit masks of keys. On the 4x4 keypad
+ * (1 2 3 C / 4 5 6 D / 7 8 9 E / A 0 B F) player 1 has the left two columns
+ * and player 2 the right two.
+ */
+static uint16_t const PLAYER_KEYS[2] = {
+    1 << 0x1 | 1 << 0x2 | 1 << 0x4 | 1 << 0x5 | 1 << 0x7 | 1 << 0x8 | 1 << 0xA | 1 << 0x0,
+    1 << 0x3 | 1 << 0xC | 1 << 0x6 | 1 << 0xD | 1 << 0x9 | 1 << 0xE | 1 << 0xB | 1 << 0xF,
+};
+
+/**
+ * Settings both peers must share, or their simulations drift apart
+ */
+struct RollbackConfig {
+    int speed = 700; // Instructions per second, spread over frames as in the emulator
+    bool vipTiming = false;
+    int maxPrediction = 8; // Frames run ahead of the last confirmed remote input
+};
+
+struct RollbackStats {
+    uint64_t rollbacks = 0; // Mispredictions corrected
+    uint64_t resimulatedFrames = 0;
+    int maxDepth = 0; // Most frames re-run by one rollback
+    double rollbackSeconds = 0; // Spent restoring and re-running
+    double maxRollbackSeconds = 0; // Longest single rollback
+};
+
+/**
+ * Rollback simulation of a two-player session
+ *
+ * Each frame runs at once with the local player's keys and a prediction of
+ * the remote player's: the last keys confirmed for them. The state at the
+ * start of every frame goes into a ring of snapshots. When the remote keys
+ * for a frame arrive and differ from the prediction, the core is restored to
+ * that frame's snapshot and re-run up to the current frame with the real keys.
+ * A snapshot is a 4.4KB copy and a frame is a few microseconds, so rolling
+ * back maxPrediction frames fits easily within one frame.
+ *
+ * Nothing here touches the network: the caller feeds in remote keys in frame
+ * order and sends the local keys, see NetplaySession.
+ *
+ * @param Q - Quirk profile of the core
+ */
+template <typename Q>
+class Rollback {
+    public:
+        static int const RING = 64; // Frames of snapshots and inputs kept
+        static int const MAX_PREDICTION = RING / 2 - 1;
+
+        Rollback(Chip8<Q> const& start, int localPlayer, RollbackConfig const& config);
+
+        /**
+         * True unless the next frame would run more than maxPrediction frames
+         * past the last confirmed remote keys
+         */
+        bool canAdvance() const { return frame < remoteConfirmed + config.maxPrediction; }
+
+        /**
+         * Run the next frame with the local keys (masked to this player's half)
+         */
+        void advance(uint16_t localKeys);
+
+        /**
+         * Confirm the remote player's keys for a frame. Only the next frame
+         * after those already confirmed is taken; others are ignored, as the
+         * sender repeats every unacknowledged frame.
+         */
+        void addRemoteInput(uint32_t remoteFrame, uint16_t keys);
+
+        /**
+         * Roll back and re-run if a confirmed input contradicted a prediction
+         */
+        void synchronize();
+
+        /**
+         * Hash of the state at the start of frame f, once every input before
+         * it is confirmed; false if f is not final yet or has left the ring
+         */
+        bool checksum(uint32_t f, uint64_t& hash) const;
+
+        /**
+         * Latest frame whose start state is final: every input before it is
+         * confirmed and no rollback is pending
+         */
+        uint32_t finalFrame() const;
+
+        uint32_t currentFrame() const { return frame; }
+        uint32_t confirmedFrames() const { return remoteConfirmed; } // Remote keys known for frames before this
+        uint16_t localInput(uint32_t f) const { return localInputs[f % RING]; }
+        uint16_t localMask() const { return PLAYER_KEYS[localPlayer]; }
+        Chip8<Q> const& core() const { return current; }
+        RollbackStats const& stats() const { return statistics; }
+
+    private:
+        void runFrame(uint32_t f);
+        void recordChecksums();
+
+        RollbackConfig config;
+        int localPlayer;
+        Chip8<Q> current;
+        Chip8<Q> snapshots[RING]; // State at the start of frame f, in f % RING
+        uint16_t localInputs[RING] = {};
+        uint16_t remoteInputs[RING] = {}; // Confirmed, or the prediction a frame ran with
+        uint64_t checksums[RING] = {};
+        uint32_t frame = 0; // Next frame to run
+        uint32_t remoteConfirmed = 0;
+        uint32_t rollbackFrom = UINT32_MAX; // Earliest mispredicted frame
+        uint32_t checksummed = 0; // Frames before this have a checksum
+        RollbackStats statistics;
+};
+
+#endif
@@ -0,0 +1,374 @@
+#include "RomGen.h"
+#include <cstdlib>
+#include <sstream>
+using namespace std;
+
+namespace {
+
+char const* const PROFILE_NAMES[ROM_PROFILES] = {"random", "draw", "recursion", "alu", "memory", "selfmod"};
+
+uint16_t const ALU_OPS[] = {0, 1, 2, 3, 4, 5, 6, 7, 0xE};
+
+/**
+ * Emits the instructions of one program, drawing every choice from a
+ * xorshift32 stream so a seed always gives the same bytes
+ */
+class Generator {
+    public:
+        explicit Generator(uint32_t seed) : state(seed ? seed : 0x2545F491) {}
+
+        std::vector<uint8_t> rom;
+
+        uint32_t r(uint32_t bound) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state % bound;
+        }
+
+        void emit(uint16_t opcode) {
+            rom.push_back(opcode >> 8);
+            rom.push_back(opcode & 0xFF);
+        }
+
+        /**
+         * Address of the next instruction emitted
+         */
+        uint16_t here() const { return 0x200 + rom.size(); }
+
+        /**
+         * An ALU instruction that leaves register keep alone
+         */
+        uint16_t alu(uint16_t keep) {
+            uint16_t x = r(15);
+            x += x >= keep;
+            uint16_t y = r(16);
+            return 0x8000 | x << 8 | y << 4 | ALU_OPS[r(9)];
+        }
+
+        void random();
+        void draw();
+        void recursion();
+        void aluLoop();
+        void memory();
+        void selfModifying();
+
+    private:
+        uint32_t state;
+};
+
+/**
+ * A bit of everything. Every instruction that uses I is preceded by an Annn,
+ * stores only go to the scratch area and skips only ever jump over a single
+ * ALU instruction.
+ */
+void Generator::random() {
+    auto address = [&]() { return 0x200 + r(0xC00); };
+    auto scratch = [&]() { return ROM_SCRATCH_ADDRESS + r(0x100); };
+
+    uint16_t x = r(16);
+    uint16_t y = r(16);
+    uint16_t kk = r(256);
+    switch (r(12)) {
+        case 0: emit(0x6000 | x << 8 | kk); break;
+        case 1: emit(0x7000 | x << 8 | kk); break;
+        case 2: emit(0x8000 | x << 8 | y << 4 | ALU_OPS[r(9)]); break;
+        case 3: {
+            // Skip over one harmless instruction
+            static uint16_t const skips[] = {0x3000, 0x4000, 0x5000, 0x9000};
+            uint16_t skip = skips[r(4)];
+            emit(skip | x << 8 | (skip == 0x3000 || skip == 0x4000 ? kk : y << 4));
+            uint16_t target = r(16);
+            emit(0x7000 | target << 8 | r(256));
+            break;
+        }
+        case 4: emit(0xC000 | x << 8 | kk); break;
+        case 5:
+            emit(0xA000 | address());
+            emit(0xD000 | x << 8 | y << 4 | r(16));
+            break;
+        case 6:
+            emit(0xA000 | scratch());
+            emit(0xF033 | x << 8);
+            break;
+        case 7:
+            emit(0xA000 | scratch());
+            emit((r(2) ? 0xF055 : 0xF065) | x << 8);
+            break;
+        case 8: {
+            static uint16_t const timers[] = {0xF007, 0xF015, 0xF018};
+            emit(timers[r(3)] | x << 8);
+            break;
+        }
+        case 9:
+            // Key check on a key index that is always in range
+            emit(0x6000 | x << 8 | r(16));
+            emit((r(2) ? 0xE09E : 0xE0A1) | x << 8);
+            emit(0x7000 | y << 8 | kk);
+            break;
+        case 10: {
+            // Jump with offset, forward over one instruction. V0 and the
+            // register SC_JUMP uses (nibble 2 of the address) are cleared
+            // first so both quirk modes land on a valid instruction.
+            uint16_t target = here() + 8;
+            emit(0x6000);
+            emit(0x6000 | (target & 0x0F00));
+            emit(0xB000 | target);
+            emit(0x0000);
+            emit(0xF029 | x << 8);
+            break;
+        }
+        default:
+            emit(0x00E0);
+            break;
+    }
+}
+
+/**
+ * Draw a sprite, then draw it again in the same or a nearby place so most
+ * draws collide. Positions run past the edges so clipping is covered too.
+ */
+void Generator::draw() {
+    // VE counts collisions and VF is the flag, so coordinates use V0-VD
+    uint16_t vx = r(14);
+    uint16_t vy = (vx + 1 + r(13)) % 14;
+    uint16_t n = 1 + r(15);
+
+    if (r(16) == 0) {
+        emit(0x00E0);
+    }
+    emit(0x6000 | vx << 8 | r(72));
+    emit(0x6000 | vy << 8 | r(36));
+    if (r(2)) {
+        uint16_t digit = vx;
+        while (digit == vx || digit == vy) {
+            digit = r(14);
+        }
+        emit(0x6000 | digit << 8 | r(16));
+        emit(0xF029 | digit << 8);
+        n = 5;
+    }
+    else {
+        emit(0xA000 | (0x200 + r(ROM_MAX_SIZE)));
+    }
+    uint16_t drawOp = 0xD000 | vx << 8 | vy << 4 | n;
+    emit(drawOp);
+    if (r(2)) {
+        emit(0x7000 | vx << 8 | r(8));
+    }
+    emit(drawOp);
+    emit(0x4F01);
+    emit(0x7E01);
+}
+
+/**
+ * A subroutine that calls itself until a counter runs out, up to 16 deep, so
+ * the whole stack is used. Its body is jumped over on the way in.
+ */
+void Generator::recursion() {
+    uint16_t counter = r(15);
+    uint16_t depth = r(4) ? 12 + r(5) : 1 + r(16);
+    int bodyOps = r(4);
+
+    emit(0x6000 | counter << 8 | depth);
+    uint16_t sub = here() + 4;
+    uint16_t after = sub + 8 + 2 * bodyOps;
+    emit(0x2000 | sub);
+    emit(0x1000 | after);
+
+    emit(0x7000 | counter << 8 | 0xFF);
+    for (int i = 0; i < bodyOps; i++) {
+        // VF takes the ALU flags, so the counter is never VF
+        emit(alu(counter));
+    }
+    emit(0x3000 | counter << 8);
+    emit(0x2000 | sub);
+    emit(0x00EE);
+}
+
+/**
+ * A counted loop of ALU instructions; the counter is never VF, which the
+ * ALU flags overwrite
+ */
+void Generator::aluLoop() {
+    uint16_t counter = r(15);
+    int ops = 2 + r(7);
+
+    emit(0x6000 | counter << 8 | (8 + r(57)));
+    uint16_t loop = here();
+    for (int i = 0; i < ops; i++) {
+        if (r(6) == 0) {
+            uint16_t x = r(15);
+            x += x >= counter;
+            emit(0x7000 | x << 8 | r(256));
+        }
+        else {
+            emit(alu(counter));
+        }
+    }
+    emit(0x7000 | counter << 8 | 0xFF);
+    emit(0x3000 | counter << 8);
+    emit(0x1000 | loop);
+}
+
+/**
+ * Store, load and BCD over the scratch area, stepping I by a stride
+ *
+ * VE counts the iterations and VD holds the stride, so loads stop at VC. One
+ * iteration moves I by at most 45 bytes with COSMAC_MEM (16 stored, 13
+ * loaded, a 16 byte stride), and 5 iterations plus the last store stay in
+ * the 256 byte scratch area.
+ */
+void Generator::memory() {
+    emit(0x6E00 | (1 + r(5)));
+    emit(0x6D00 | r(17));
+    emit(0xA000 | ROM_SCRATCH_ADDRESS);
+    uint16_t loop = here();
+    emit(0xF055 | r(16) << 8);
+    emit(0xF065 | r(13) << 8);
+    emit(0xF033 | r(16) << 8);
+    emit(0xFD1E);
+    emit(0x7EFF);
+    emit(0x3E00);
+    emit(0x1000 | loop);
+}
+
+/**
+ * Either write an instruction into the next slot and run it, or a loop that
+ * rewrites the immediate of one of its own instructions every iteration
+ */
+void Generator::selfModifying() {
+    if (r(2)) {
+        static uint16_t const templates[] = {0x6000, 0x7000, 0x8000, 0xC000};
+        uint16_t opcode = templates[r(4)];
+        opcode |= (2 + r(14)) << 8;
+        if (opcode >> 12 == 8) {
+            opcode |= r(16) << 4;
+            opcode |= ALU_OPS[r(9)];
+        }
+        else {
+            opcode |= r(256);
+        }
+        emit(0x6000 | opcode >> 8);
+        emit(0x6100 | (opcode & 0xFF));
+        uint16_t slot = here() + 4;
+        emit(0xA000 | slot);
+        emit(0xF155);
+        // Replaced before it runs
+        uint16_t placeholder = 2 + r(14);
+        emit(0x6000 | placeholder << 8 | r(256));
+        return;
+    }
+
+    // Annn again before the store, as COSMAC_MEM moved I on the load
+    uint16_t delta = 1 + r(255);
+    emit(0x6E00 | (2 + r(14)));
+    uint16_t loop = here();
+    uint16_t patched = loop + 1;
+    emit(0x7D00 | r(256));
+    emit(0xA000 | patched);
+    emit(0xF065);
+    emit(0x7000 | delta);
+    emit(0xA000 | patched);
+    emit(0xF055);
+    emit(0x7EFF);
+    emit(0x3E00);
+    emit(0x1000 | loop);
+}
+
+} // namespace
+
+
+vector<uint8_t> generateRom(RomGenConfig const& config) {
+    Generator generator(config.seed);
+    vector<uint8_t>& rom = generator.rom;
+
+    int totalWeight = 0;
+    int profiles = 0;
+    for (int weight : config.weights) {
+        totalWeight += max(weight, 0);
+        profiles += weight > 0;
+    }
+
+    // The largest block, an ALU loop, is 24 bytes, and the program ends with 4
+    int const LARGEST_BLOCK = 24;
+    for (int block = 0; block < config.blocks && rom.size() + LARGEST_BLOCK + 4 <= ROM_MAX_SIZE; block++) {
+        // A single profile draws nothing for the pick, so ROM_RANDOM alone
+        // gives the same programs difftest always generated
+        int profile = 0;
+        if (profiles == 1) {
+            while (config.weights[profile] <= 0) {
+                profile++;
+            }
+        }
+        else if (profiles > 1) {
+            int pick = generator.r(totalWeight);
+            while (pick >= config.weights[profile] || config.weights[profile] <= 0) {
+                pick -= max(config.weights[profile], 0);
+                profile++;
+            }
+        }
+
+        switch (RomProfile(profile)) {
+            case ROM_DRAW: generator.draw(); break;
+            case ROM_RECURSION: generator.recursion(); break;
+            case ROM_ALU: generator.aluLoop(); break;
+            case ROM_MEMORY: generator.memory(); break;
+            case ROM_SELF_MODIFYING: generator.selfModifying(); break;
+            default: generator.random(); break;
+        }
+    }
+    generator.emit(0x1200);
+    generator.emit(0x1200);
+    return rom;
+}
+
+bool parseRomProfiles(string const& list, RomGenConfig& config, string& error) {
+    for (int& weight : config.weights) {
+        weight = 0;
+    }
+
+    stringstream items(list);
+    string item;
+    while (getline(items, item, ',')) {
+        size_t equals = item.find('=');
+        string name = item.substr(0, equals);
+        int weight = 1;
+        if (equals != string::npos) {
+            char* end;
+            weight = strtol(item.c_str() + equals + 1, &end, 10);
+            if (*end || weight <= 0) {
+                error = "weight of " + name + " must be a positive integer";
+                return false;
+            }
+        }
+
+        if (name == "all") {
+            for (int& each : config.weights) {
+                each = weight;
+            }
+            continue;
+        }
+        int profile = 0;
+        while (profile < ROM_PROFILES && name != PROFILE_NAMES[profile]) {
+            profile++;
+        }
+        if (profile == ROM_PROFILES) {
+            error = "unknown profile " + name;
+            return false;
+        }
+        config.weights[profile] = weight;
+    }
+
+    for (int weight : config.weights) {
+        if (weight > 0) {
+            return true;
+        }
+    }
+    error = "no profile given";
+    return false;
+}
+
+char const* romProfileName(RomProfile profile) {
+    return profile < ROM_PROFILES ? PROFILE_NAMES[profile] : "?";
+}
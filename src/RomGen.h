@@ -0,0 +1,54 @@
+#ifndef ROM_GEN_H
+#define ROM_GEN_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Kinds of block a generated ROM is built from
+ */
+enum RomProfile {
+    ROM_RANDOM, // A bit of everything, one or two instructions at a time
+    ROM_DRAW, // Dxyn spam, often drawing a sprite twice so it collides
+    ROM_RECURSION, // 2nnn/00EE recursion up to the full 16-entry stack
+    ROM_ALU, // Counted loops of 8xy* instructions
+    ROM_MEMORY, // Fx55/Fx65/Fx33/Fx1E churn over a scratch area
+    ROM_SELF_MODIFYING, // Code that writes the instructions it is about to run
+    ROM_PROFILES,
+};
+
+/**
+ * What to generate: the relative weight of each kind of block, and how many
+ * blocks
+ */
+struct RomGenConfig {
+    int weights[ROM_PROFILES] = {1, 0, 0, 0, 0, 0};
+    uint32_t seed = 1;
+    int blocks = 256; // Capped so the program fits below the scratch area
+};
+
+/**
+ * Generate a valid, seeded CHIP-8 program
+ *
+ * The same config always gives the same bytes. Each block is picked by
+ * weight and is self-contained, and the program ends by jumping back to the
+ * start, so it runs forever. Under every quirk profile it stays inside memory,
+ * never over- or underflows the stack and only executes instructions it
+ * emitted. Stores only go to the scratch area from ROM_SCRATCH_ADDRESS to
+ * 0xF0F, except where self-modifying blocks patch their own code.
+ */
+std::vector<uint8_t> generateRom(RomGenConfig const& config);
+
+/**
+ * Parse a list of profiles with optional weights, e.g. "draw=3,alu" or "all"
+ * @return False with error set if a name or weight is invalid
+ */
+bool parseRomProfiles(std::string const& list, RomGenConfig& config, std::string& error);
+
+char const* romProfileName(RomProfile profile);
+
+static int const ROM_SCRATCH_ADDRESS = 0xE00; // Stores go here, above the program
+static int const ROM_MAX_SIZE = ROM_SCRATCH_ADDRESS - 0x200;
+
+#endif
@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <deque>
+#include <unordered_set>
+#include "Search.h"
+#include "WorkerPool.h"
+using namespace std;
+
+namespace {
+
+/**
+ * One step of an input sequence, linked back to the step before it
+ */
+struct Step {
+    uint32_t parent; // Index into the history, NO_PARENT for the first step
+    uint16_t action;
+};
+
+uint32_t const NO_PARENT = UINT32_MAX;
+
+/**
+ * A frontier state, stored in the buffer of the worker that produced it
+ */
+struct Entry {
+    uint32_t worker;
+    uint32_t slot;
+    uint32_t history; // Last step that led here, NO_PARENT for the start state
+};
+
+/**
+ * A new state found by a worker, ordered by the item that produced it
+ */
+struct Child {
+    size_t item;
+    uint32_t slot;
+    uint64_t hash; // stateHash() of the state
+};
+
+/**
+ * The hashes are already mixed, so the set uses them as they are
+ */
+struct Identity {
+    size_t operator()(uint64_t hash) const { return hash; }
+};
+
+/**
+ * Set of visited state hashes
+ *
+ * Only the calling thread inserts, between steps, in item order, so which of
+ * two identical children survives does not depend on the workers' timing.
+ * Workers only look up states seen in earlier steps while the set is still.
+ */
+typedef unordered_set<uint64_t, Identity> SeenSet;
+
+/**
+ * Per-worker counters, padded so workers do not share cache lines
+ */
+struct alignas(64) WorkerStats {
+    uint64_t states = 0;
+    uint64_t duplicates = 0;
+    size_t foundItem = SIZE_MAX;
+    int foundFrames = 0;
+};
+
+/**
+ * Hash size bytes in four independent multiply chains. Each step is a
+ * bijection, so a difference in the input is never cancelled within a chain.
+ */
+uint64_t hashWords(void const* data, size_t size, uint64_t seed) {
+    uint64_t const PRIME = 0x9E3779B97F4A7C15ull;
+    uint64_t lanes[4] = {seed, seed ^ 0x6A09E667F3BCC909ull, seed ^ 0xBB67AE8584CAA73Bull, seed ^ 0x3C6EF372FE94F82Bull};
+    uint8_t const* bytes = static_cast<uint8_t const*>(data);
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t word;
+            memcpy(&word, bytes + i + lane * 8, 8);
+            lanes[lane] = (lanes[lane] ^ word) * PRIME;
+        }
+    }
+    for (; i < size; i++) {
+        lanes[0] = (lanes[0] ^ bytes[i]) * PRIME;
+    }
+
+    uint64_t hash = lanes[0];
+    for (int lane = 1; lane < 4; lane++) {
+        hash = (hash ^ (lanes[lane] >> 29) ^ lanes[lane]) * PRIME;
+    }
+    // splitmix64 finalizer, so every bit of the result depends on every lane
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ull;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBull;
+    return hash ^ (hash >> 31);
+}
+
+template <typename Q>
+bool conditionHolds(Chip8<Q> const& chip8, SearchGoal const& goal) {
+    ExpressionContext context = {chip8.registers, chip8.memory, chip8.pc, chip8.I, chip8.sp, chip8.delayTimer, chip8.soundTimer};
+    return goal.condition.evaluate(context) != 0;
+}
+
+/**
+ * Check the goal at one point of execution
+ *
+ * Without a condition, the display hash is only recomputed after a draw.
+ */
+template <typename Q>
+bool goalMet(Chip8<Q>& chip8, SearchGoal const& goal) {
+    bool drew = chip8.drawFlag;
+    chip8.drawFlag = false;
+    if (goal.hasCondition) {
+        return conditionHolds(chip8, goal) && (!goal.hasFrameHash || chip8.frameHash() == goal.frameHash);
+    }
+    return drew && chip8.frameHash() == goal.frameHash;
+}
+
+} // namespace
+
+
+template <typename Q>
+InputSearch<Q>::InputSearch(SearchConfig const& config) : config(config) {
+}
+
+template <typename Q>
+uint64_t InputSearch<Q>::stateHash(Chip8<Q> const& chip8) {
+    struct {
+        uint16_t stack[16];
+        uint8_t registers[16];
+        uint16_t pc;
+        uint16_t I;
+        uint32_t rngState;
+        uint8_t sp;
+        uint8_t delayTimer;
+        uint8_t soundTimer;
+        uint8_t padding;
+    } small;
+    memset(&small, 0, sizeof(small));
+    memcpy(small.stack, chip8.stack, sizeof(small.stack));
+    memcpy(small.registers, chip8.registers, sizeof(small.registers));
+    small.pc = chip8.pc;
+    small.I = chip8.I;
+    small.rngState = chip8.rngState;
+    small.sp = chip8.sp;
+    small.delayTimer = chip8.delayTimer;
+    small.soundTimer = chip8.soundTimer;
+
+    uint64_t hash = hashWords(&small, sizeof(small), 0);
+    hash = hashWords(chip8.memory, sizeof(chip8.memory), hash);
+    return hashWords(chip8.display, sizeof(chip8.display), hash);
+}
+
+template <typename Q>
+SearchResult InputSearch<Q>::run(Chip8<Q> const& start, SearchGoal const& goal) {
+    auto begin = chrono::steady_clock::now();
+    SearchResult result;
+
+    WorkerPool pool(config.threads);
+    size_t workers = pool.size();
+    size_t actions = config.actions.size();
+
+    // Each worker appends the states it produces to its own buffer; the
+    // frontier refers to them in place, so a state is copied once, when it
+    // is forked. A deque never moves its elements as it grows.
+    vector<deque<Chip8<Q>>> buffers[2];
+    buffers[0].resize(workers);
+    buffers[1].resize(workers);
+    int current = 0;
+    buffers[current][0].push_back(start);
+
+    SeenSet seen;
+    seen.insert(stateHash(start));
+    vector<Step> history;
+    vector<Entry> frontier = {{0, 0, NO_PARENT}};
+    vector<vector<Child>> children(workers);
+    vector<WorkerStats> stats(workers);
+
+    // The start state is checked as a whole, as if it had just drawn
+    Chip8<Q> first = start;
+    first.drawFlag = true;
+    result.found = (goal.hasCondition || goal.hasFrameHash) && goalMet(first, goal);
+
+    while (!result.found && !frontier.empty() && result.depth < config.maxDepth && actions > 0) {
+        result.depth++;
+        int next = 1 - current;
+        for (size_t worker = 0; worker < workers; worker++) {
+            buffers[next][worker].clear();
+            children[worker].clear();
+            stats[worker].foundItem = SIZE_MAX;
+        }
+        atomic<size_t> foundItem{SIZE_MAX};
+
+        pool.parallelFor(frontier.size() * actions, [&](size_t item, size_t worker) {
+            // A match earlier in the order makes later items irrelevant
+            if (item > foundItem.load(memory_order_relaxed)) {
+                return;
+            }
+            Entry const& parent = frontier[item / actions];
+            uint16_t action = config.actions[item % actions];
+            deque<Chip8<Q>>& buffer = buffers[next][worker];
+            buffer.push_back(buffers[current][parent.worker][parent.slot]);
+            Chip8<Q>& chip8 = buffer.back();
+            chip8.keys = action;
+            stats[worker].states++;
+
+            for (int frame = 1; frame <= config.holdFrames; frame++) {
+                bool met = false;
+                if (config.perInstruction && goal.hasCondition) {
+                    for (int i = 0; i < config.instructionsPerFrame && !met; i++) {
+                        chip8.cycle();
+                        met = goalMet(chip8, goal);
+                    }
+                    chip8.updateTimers();
+                }
+                else {
+                    chip8.runFrame(config.instructionsPerFrame);
+                    met = goalMet(chip8, goal);
+                }
+
+                if (met) {
+                    size_t seenItem = foundItem.load(memory_order_relaxed);
+                    while (item < seenItem && !foundItem.compare_exchange_weak(seenItem, item, memory_order_relaxed)) {
+                    }
+                    if (item < stats[worker].foundItem) {
+                        stats[worker].foundItem = item;
+                        stats[worker].foundFrames = frame;
+                    }
+                    buffer.pop_back();
+                    return;
+                }
+            }
+
+            // Duplicates of earlier steps go at once; those within this step
+            // are left to the ordered pass below
+            uint64_t hash = stateHash(chip8);
+            if (seen.count(hash)) {
+                stats[worker].duplicates++;
+                buffer.pop_back();
+                return;
+            }
+            children[worker].push_back({item, uint32_t(buffer.size() - 1), hash});
+        });
+
+        // The match earliest in the order wins, so the result does not depend
+        // on which worker got there first
+        size_t matchItem = SIZE_MAX;
+        int matchFrames = 0;
+        for (WorkerStats const& worker : stats) {
+            if (worker.foundItem < matchItem) {
+                matchItem = worker.foundItem;
+                matchFrames = worker.foundFrames;
+            }
+        }
+
+        if (matchItem != SIZE_MAX) {
+            vector<uint16_t> steps;
+            for (uint32_t step = frontier[matchItem / actions].history; step != NO_PARENT; step = history[step].parent) {
+                steps.push_back(history[step].action);
+            }
+            reverse(steps.begin(), steps.end());
+            for (uint16_t action : steps) {
+                result.inputs.insert(result.inputs.end(), config.holdFrames, action);
+            }
+            result.inputs.insert(result.inputs.end(), matchFrames, config.actions[matchItem % actions]);
+            result.found = true;
+            break;
+        }
+
+        struct Ordered {
+            size_t item;
+            uint32_t worker;
+            uint32_t slot;
+            uint64_t hash;
+        };
+        vector<Ordered> ordered;
+        for (size_t worker = 0; worker < workers; worker++) {
+            for (Child const& child : children[worker]) {
+                ordered.push_back({child.item, uint32_t(worker), child.slot, child.hash});
+            }
+        }
+        sort(ordered.begin(), ordered.end(), [](Ordered const& a, Ordered const& b) { return a.item < b.item; });
+
+        // Of the children that reached the same state, the lowest item wins.
+        // The losers stay in their worker's buffer unused until it is cleared.
+        size_t kept = 0;
+        for (Ordered const& child : ordered) {
+            if (seen.insert(child.hash).second) {
+                ordered[kept++] = child;
+            }
+            else {
+                result.duplicates++;
+            }
+        }
+        ordered.resize(kept);
+
+        if (ordered.size() > config.maxFrontier) {
+            result.dropped += ordered.size() - config.maxFrontier;
+            ordered.resize(config.maxFrontier);
+        }
+
+        vector<Entry> nextFrontier;
+        nextFrontier.reserve(ordered.size());
+        for (Ordered const& child : ordered) {
+            history.push_back({frontier[child.item / actions].history, config.actions[child.item % actions]});
+            nextFrontier.push_back({child.worker, child.slot, uint32_t(history.size() - 1)});
+        }
+        frontier.swap(nextFrontier);
+        current = next;
+    }
+
+    for (WorkerStats const& worker : stats) {
+        result.states += worker.states;
+        result.duplicates += worker.duplicates;
+    }
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    return result;
+}
+
+
+/* Instantiations */
+
+template class InputSearch<Quirks<false, false, false>>;
+template class InputSearch<Quirks<false, false, true>>;
+template class InputSearch<Quirks<false, true, false>>;
+template class InputSearch<Quirks<false, true, true>>;
+template class InputSearch<Quirks<true, false, false>>;
+template class InputSearch<Quirks<true, false, true>>;
+template class InputSearch<Quirks<true, true, false>>;
+template class InputSearch<Quirks<true, true, true>>;
@@ -0,0 +1,76 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "chip8.h"
+#include "Debugger.h"
+
+/**
+ * Settings for an InputSearch
+ */
+struct SearchConfig {
+    std::vector<uint16_t> actions; // Key masks tried at every step, bit k for key k
+    int holdFrames = 6; // Frames each action is held for
+    int instructionsPerFrame = 11;
+    int maxDepth = 200; // Steps before giving up
+    size_t maxFrontier = 20000; // States kept per step, the rest are dropped
+    bool perInstruction = true; // Check the goal after every instruction instead of every frame
+    size_t threads = 0; // Worker threads, 0 for one per hardware thread
+};
+
+/**
+ * What an InputSearch looks for; the goal is met when every part that is set
+ * holds
+ */
+struct SearchGoal {
+    bool hasCondition = false;
+    Expression condition; // Over the machine state, as in the debugger
+    bool hasFrameHash = false;
+    uint64_t frameHash = 0; // Chip8::frameHash of the display to reach
+};
+
+struct SearchResult {
+    bool found = false;
+    std::vector<uint16_t> inputs; // Key mask for each frame from the start state to the goal
+    int depth = 0; // Steps searched
+    uint64_t states = 0; // States stepped from a parent
+    uint64_t duplicates = 0; // States pruned because an identical one was seen before
+    uint64_t dropped = 0; // States dropped because the frontier was full
+    double seconds = 0;
+};
+
+/**
+ * Breadth-first search over input sequences from a snapshot of the core
+ *
+ * Each step forks every frontier state once per action, holds the action for
+ * a few frames and checks the goal. Forks run in parallel on a WorkerPool.
+ * Every new state is hashed and dropped if an identical machine state was
+ * reached before, so input that the ROM ignores does not multiply the
+ * frontier. The result is deterministic for a given configuration, whatever
+ * the number of threads: children are ordered by parent and action, and the
+ * first match in that order wins.
+ *
+ * @param Q - Quirk profile of the searched core
+ */
+template <typename Q>
+class InputSearch {
+    public:
+        explicit InputSearch(SearchConfig const& config);
+
+        /**
+         * Search from start, which is copied and left untouched
+         */
+        SearchResult run(Chip8<Q> const& start, SearchGoal const& goal);
+
+        /**
+         * Hash of everything that decides the machine's future, except the keys
+         */
+        static uint64_t stateHash(Chip8<Q> const& chip8);
+
+    private:
+        SearchConfig config;
+};
+
+#endif
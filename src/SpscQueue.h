@@ -0,0 +1,64 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * Bounded lock-free queue for exactly one producer and one consumer thread
+ *
+ * Neither side ever blocks: tryPush() fails when the queue is full and
+ * tryPop() fails when it is empty.
+ *
+ * @param T - Element type, copied in and out
+ * @param N - Capacity, must be a power of two
+ */
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert((N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    /**
+     * Copy an element into the queue (producer only)
+     * @return False if the queue is full
+     */
+    bool tryPush(T const& value) {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail - headCache == N) {
+            headCache = headIndex.load(std::memory_order_acquire);
+            if (tail - headCache == N) {
+                return false;
+            }
+        }
+        slots[tail & (N - 1)] = value;
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Copy the oldest element out of the queue (consumer only)
+     * @return False if the queue is empty
+     */
+    bool tryPop(T& value) {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == tailCache) {
+            tailCache = tailIndex.load(std::memory_order_acquire);
+            if (head == tailCache) {
+                return false;
+            }
+        }
+        value = slots[head & (N - 1)];
+        headIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // Producer and consumer indices live on separate cache lines
+    alignas(64) std::atomic<size_t> tailIndex{0};
+    size_t headCache = 0; // Producer's last view of headIndex
+    alignas(64) std::atomic<size_t> headIndex{0};
+    size_t tailCache = 0; // Consumer's last view of tailIndex
+    alignas(64) T slots[N];
+};
+
+#endif
@@ -0,0 +1,307 @@
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include "Terminal.h"
+using namespace std;
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void onSignal(int) {
+    interrupted = 1;
+}
+
+/**
+ * Chip 8 key for a character of the keyboard, or -1
+ */
+static int keyFor(int c) {
+    // Only fold letters: | 0x20 would turn Ctrl-Q..Ctrl-T into 1, 2, 3 and 4
+    switch (isalpha(c) ? c | 0x20 : c) {
+        case 'x': return 0x0;
+        case '1': return 0x1;
+        case '2': return 0x2;
+        case '3': return 0x3;
+        case 'q': return 0x4;
+        case 'w': return 0x5;
+        case 'e': return 0x6;
+        case 'a': return 0x7;
+        case 's': return 0x8;
+        case 'd': return 0x9;
+        case 'z': return 0xA;
+        case 'c': return 0xB;
+        case '4': return 0xC;
+        case 'r': return 0xD;
+        case 'f': return 0xE;
+        case 'v': return 0xF;
+    }
+    return -1;
+}
+
+Terminal::Terminal(TerminalCells cells, int holdMs, bool bell)
+    : cells(cells), hold(holdMs), bell(bell) {
+    columns = cells == CELLS_BRAILLE ? WIDTH / 2 : WIDTH;
+    rowsOfCells = cells == CELLS_BRAILLE ? HEIGHT / 4 : HEIGHT / 2;
+
+    if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &saved) == 0) {
+        termios mode = saved;
+        mode.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+        mode.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+        mode.c_cc[VMIN] = 0;
+        mode.c_cc[VTIME] = 0;
+        raw = tcsetattr(STDIN_FILENO, TCSAFLUSH, &mode) == 0;
+    }
+
+    struct sigaction action{};
+    action.sa_handler = onSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    sigaction(SIGHUP, &action, nullptr);
+
+    // Alternate screen, hidden cursor, and the kitty keyboard protocol with
+    // release events, which other terminals ignore
+    out = "\x1b[?1049h\x1b[?25l";
+    if (raw) {
+        out += "\x1b[>11u";
+    }
+    redraw();
+    flush();
+}
+
+Terminal::~Terminal() {
+    out += raw ? "\x1b[<u" : "";
+    out += "\x1b[0m\x1b[?25h\x1b[?1049l";
+    flush();
+    if (raw) {
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved);
+    }
+}
+
+/**
+ * Clear the screen and draw everything again on the next update
+ */
+void Terminal::redraw() {
+    out += "\x1b[2J";
+    memset(shown, 0, sizeof(shown));
+    memset(screen, 0, sizeof(screen));
+    beepShown = false;
+    statusShown.clear();
+    cursorRow = -1;
+}
+
+void Terminal::moveTo(int row, int column) {
+    char sequence[16];
+    out.append(sequence, snprintf(sequence, sizeof(sequence), "\x1b[%d;%dH", row + 1, column + 1));
+    cursorRow = row;
+    cursorColumn = column;
+}
+
+/**
+ * Append the character of a cell code: 2 bits (top, bottom) for half blocks,
+ * 8 braille dots for braille
+ */
+void Terminal::glyph(uint8_t code) {
+    if (cells == CELLS_BRAILLE) {
+        // U+2800 + code in UTF-8
+        char bytes[3] = {char(0xE2), char(0xA0 | code >> 6), char(0x80 | (code & 0x3F))};
+        out.append(bytes, 3);
+    }
+    else {
+        static char const* const HALVES[4] = {" ", "▄", "▀", "█"};
+        out += HALVES[code];
+    }
+    cursorColumn++;
+}
+
+/**
+ * Set one cell. Short gaps on the same row are bridged by writing the cells
+ * in between again, when that is shorter than a cursor move.
+ */
+void Terminal::cell(int row, int column, uint8_t code) {
+    int gap = column - cursorColumn;
+    if (row != cursorRow || gap < 0 || gap > 2) {
+        moveTo(row, column);
+    }
+    else {
+        for (int c = cursorColumn; c < column; c++) {
+            glyph(screen[row * columns + c]);
+        }
+    }
+    glyph(code);
+    screen[row * columns + column] = code;
+}
+
+void Terminal::update(uint64_t const* rows) {
+    memcpy(target, rows, sizeof(target));
+    size_t before = out.size();
+
+    if (cells == CELLS_BRAILLE) {
+        for (int cy = 0; cy < rowsOfCells; cy++) {
+            uint64_t const* r = rows + cy * 4;
+            if (r[0] == shown[cy * 4] && r[1] == shown[cy * 4 + 1] && r[2] == shown[cy * 4 + 2] &&
+                r[3] == shown[cy * 4 + 3]) {
+                continue;
+            }
+            for (int cx = 0; cx < columns; cx++) {
+                int shift = WIDTH - 2 - cx * 2;
+                // Dots 1-3 and 7 are the left column top down, 4-6 and 8 the right
+                uint8_t code = (r[0] >> (shift + 1) & 1) | (r[1] >> (shift + 1) & 1) << 1 |
+                               (r[2] >> (shift + 1) & 1) << 2 | (r[3] >> (shift + 1) & 1) << 6 |
+                               (r[0] >> shift & 1) << 3 | (r[1] >> shift & 1) << 4 |
+                               (r[2] >> shift & 1) << 5 | (r[3] >> shift & 1) << 7;
+                if (code != screen[cy * columns + cx]) {
+                    cell(cy, cx, code);
+                }
+            }
+        }
+    }
+    else {
+        for (int cy = 0; cy < rowsOfCells; cy++) {
+            uint64_t top = rows[cy * 2];
+            uint64_t bottom = rows[cy * 2 + 1];
+            if (top == shown[cy * 2] && bottom == shown[cy * 2 + 1]) {
+                continue;
+            }
+            for (int x = 0; x < columns; x++) {
+                int shift = WIDTH - 1 - x;
+                uint8_t code = (top >> shift & 1) << 1 | (bottom >> shift & 1);
+                if (code != screen[cy * columns + x]) {
+                    cell(cy, x, code);
+                }
+            }
+        }
+    }
+
+    memcpy(shown, rows, sizeof(shown));
+    updates += out.size() != before;
+    flush();
+}
+
+void Terminal::startBeep() {
+    if (!beepShown) {
+        beepShown = true;
+        moveTo(rowsOfCells, 0);
+        out += bell ? "♪\a" : "♪";
+        cursorColumn = -1;
+        flush();
+    }
+}
+
+void Terminal::stopBeep() {
+    if (beepShown) {
+        beepShown = false;
+        moveTo(rowsOfCells, 0);
+        out += ' ';
+        cursorColumn = -1;
+        flush();
+    }
+}
+
+void Terminal::status(string const& text) {
+    if (text != statusShown) {
+        statusShown = text;
+        moveTo(rowsOfCells, 2);
+        out += text;
+        out += "\x1b[K";
+        cursorColumn = -1;
+        flush();
+    }
+}
+
+/**
+ * Press or release a key; exact presses stay down until their release
+ */
+void Terminal::press(int key, bool down, bool exact) {
+    auto now = chrono::steady_clock::now();
+    if (!down) {
+        released[key] = now;
+    }
+    else if (exact) {
+        released[key] = chrono::steady_clock::time_point::max();
+    }
+    else if (released[key] != chrono::steady_clock::time_point::max()) {
+        released[key] = now + hold;
+    }
+}
+
+bool Terminal::processInput(uint16_t& keys) {
+    bool quit = interrupted;
+    char buffer[256];
+    ssize_t n;
+    while (raw && (n = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            char c = buffer[i];
+            if (c == 0x03) {
+                quit = true;
+            }
+            else if (c == 0x0C) {
+                redraw();
+                update(target);
+            }
+            else if (c == 0x1B && i + 1 < n && buffer[i + 1] == '[') {
+                // CSI sequence; kitty keys are CSI code[:alternates];modifiers[:event] u
+                ssize_t end = i + 2;
+                while (end < n && (buffer[end] < 0x40 || buffer[end] > 0x7E)) {
+                    end++;
+                }
+                if (end < n && buffer[end] == 'u') {
+                    string parameters(buffer + i + 2, buffer + end);
+                    int code = atoi(parameters.c_str());
+                    int modifiers = 1;
+                    int event = 1;
+                    size_t semicolon = parameters.find(';');
+                    if (semicolon != string::npos) {
+                        modifiers = atoi(parameters.c_str() + semicolon + 1);
+                        size_t colon = parameters.find(':', semicolon);
+                        if (colon != string::npos) {
+                            event = atoi(parameters.c_str() + colon + 1);
+                        }
+                    }
+                    bool ctrl = (modifiers - 1) & 4;
+                    if (event != 3 && (code == 27 || (ctrl && code == 'c'))) {
+                        quit = true;
+                    }
+                    else if (event != 3 && ctrl && code == 'l') {
+                        redraw();
+                        update(target);
+                    }
+                    else if (code < 128 && keyFor(code) >= 0) {
+                        press(keyFor(code), event != 3, true);
+                    }
+                }
+                i = end;
+            }
+            else if (c == 0x1B) {
+                quit = true;
+            }
+            else if (keyFor(c) >= 0) {
+                press(keyFor(c), true, false);
+            }
+        }
+    }
+
+    auto now = chrono::steady_clock::now();
+    keys = 0;
+    for (int k = 0; k < 16; k++) {
+        keys |= uint16_t(released[k] > now) << k;
+    }
+    return quit;
+}
+
+void Terminal::flush() {
+    size_t offset = 0;
+    while (offset < out.size()) {
+        ssize_t n = write(STDOUT_FILENO, out.data() + offset, out.size() - offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        offset += n;
+    }
+    written += out.size();
+    out.clear();
+}
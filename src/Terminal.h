@@ -0,0 +1,122 @@
+#ifndef TERMINAL_H
+#define TERMINAL_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <termios.h>
+
+/**
+ * How display pixels map to terminal cells
+ */
+enum TerminalCells {
+    CELLS_HALF_BLOCK, // 1x2 pixels per cell with ▀ ▄ █, 64x16 cells
+    CELLS_BRAILLE,    // 2x4 pixels per cell with U+2800 - U+28FF, 32x8 cells
+};
+
+/**
+ * A class to handle I/O in a text terminal, for machines without a display
+ *
+ * The display is drawn on the alternate screen with Unicode cells. Each
+ * update only writes the cells that changed since the last one, with a
+ * cursor move only where the changed cells are not adjacent, and everything
+ * goes out in a single write. An unchanged frame writes nothing, so a session
+ * watched over SSH costs a few bytes per frame.
+ *
+ * Keys are read from stdin in raw mode with the same layout as Window
+ * (1234 / qwer / asdf / zxcv). Most terminals only send key presses, and
+ * repeat them while a key is held, so a key stays down for holdMs after its
+ * last press or repeat. Terminals with the kitty keyboard protocol (kitty,
+ * foot, WezTerm, Ghostty...) also report releases, which are then exact.
+ * Esc or Ctrl-C quits, Ctrl-L redraws the screen.
+ */
+class Terminal {
+public:
+    static int const WIDTH = 64;
+    static int const HEIGHT = 32;
+
+    /**
+     * Constructor for the Terminal class, switches to the alternate screen
+     * and, if stdin is a terminal, to raw mode
+     * @param cells Cell layout
+     * @param holdMs How long a key counts as down after its last press or repeat
+     * @param bell Ring the terminal bell when the beep starts
+     */
+    Terminal(TerminalCells cells, int holdMs = 150, bool bell = false);
+
+    /**
+     * Destructor for the Terminal class, restores the screen and stdin
+     */
+    ~Terminal();
+
+    Terminal(Terminal const&) = delete;
+    Terminal& operator=(Terminal const&) = delete;
+
+    /**
+     * Update the display from the core's display
+     * @param rows One row per word, leftmost pixel in the top bit
+     */
+    void update(uint64_t const* rows);
+
+    /**
+     * Show the beep indicator, and ring the bell if enabled
+     */
+    void startBeep();
+
+    /**
+     * Hide the beep indicator
+     */
+    void stopBeep();
+
+    /**
+     * Replace the line of text under the display; only written if it changed
+     */
+    void status(std::string const& text);
+
+    /**
+     * Process input from stdin
+     * @param keys Key mask, bit k set while key k is down
+     * @return True if a quit key or SIGINT/SIGTERM/SIGHUP arrived, false otherwise
+     */
+    bool processInput(uint16_t& keys);
+
+    /**
+     * True if stdin is a terminal, so keys can be read
+     */
+    bool interactive() const { return raw; }
+
+    uint64_t bytesWritten() const { return written; }
+    uint64_t updatesWritten() const { return updates; } // Frames that changed at least one cell
+
+private:
+    void redraw();
+    void moveTo(int row, int column);
+    void cell(int row, int column, uint8_t code);
+    void glyph(uint8_t code);
+    void press(int key, bool down, bool exact);
+    void flush();
+
+    TerminalCells cells;
+    int columns;
+    int rowsOfCells;
+    std::chrono::milliseconds hold;
+    bool bell;
+    bool raw = false;
+    termios saved{};
+
+    uint64_t target[HEIGHT]{}; // The display last passed to update()
+    uint64_t shown[HEIGHT]{}; // The display as it is on screen
+    uint8_t screen[HEIGHT * WIDTH]{}; // Code of every cell on screen, see cell()
+    bool beepShown = false;
+    std::string statusShown;
+    int cursorRow = -1; // Where the terminal's cursor is, or -1 if unknown
+    int cursorColumn = -1;
+    std::string out; // Pending output, written by flush()
+
+    std::chrono::steady_clock::time_point released[16]{}; // When each key goes up
+    uint64_t written = 0;
+    uint64_t updates = 0;
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include "Trace.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "SpscQueue.h"
+
+static size_t const RING_RECORDS = 8192; // Per thread, 320KB
+
+/**
+ * One thread's ring, shared with the drain thread
+ *
+ * The registry keeps it alive after the thread exits, so its last records
+ * are still drained.
+ */
+struct TraceRing {
+    SpscQueue<TraceRecord, RING_RECORDS> queue;
+    std::atomic<uint64_t> dropped{0};
+    uint64_t droppedReported = 0; // Drain thread only
+    uint16_t thread = 0;
+};
+
+static std::mutex registryMutex;
+static std::vector<std::shared_ptr<TraceRing>> rings;
+static thread_local std::shared_ptr<TraceRing> localRing;
+
+static FILE* file = nullptr;
+static std::thread drainer;
+static std::atomic<bool> stopping{false};
+static std::chrono::steady_clock::time_point startTime;
+static std::atomic<uint64_t> written{0};
+static std::atomic<uint64_t> droppedTotal{0};
+
+/**
+ * Pop every ring into the file and report drops
+ * @return True if any record was written
+ */
+static bool drainOnce(std::vector<TraceRecord>& buffer) {
+    std::vector<std::shared_ptr<TraceRing>> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        snapshot = rings;
+    }
+
+    bool any = false;
+    for (std::shared_ptr<TraceRing> const& ring : snapshot) {
+        buffer.clear();
+        TraceRecord record;
+        while (buffer.size() < RING_RECORDS && ring->queue.tryPop(record)) {
+            buffer.push_back(record);
+        }
+
+        uint64_t dropped = ring->dropped.load(std::memory_order_relaxed);
+        if (dropped != ring->droppedReported) {
+            TraceRecord lost{};
+            lost.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+            lost.thread = ring->thread;
+            lost.category = TRACE_LOST;
+            uint32_t count = uint32_t(dropped - ring->droppedReported);
+            memcpy(lost.data, &count, sizeof(count));
+            buffer.push_back(lost);
+            ring->droppedReported = dropped;
+        }
+
+        if (!buffer.empty()) {
+            fwrite(buffer.data(), sizeof(TraceRecord), buffer.size(), file);
+            written += buffer.size();
+            any = true;
+        }
+    }
+    return any;
+}
+
+static void drainLoop() {
+    std::vector<TraceRecord> buffer;
+    buffer.reserve(RING_RECORDS + 1);
+    while (!stopping.load(std::memory_order_acquire)) {
+        if (!drainOnce(buffer)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+    // Records written before stopping was set are still in the rings
+    while (drainOnce(buffer)) {
+    }
+}
+
+bool Trace::start(std::string const& path, uint8_t categoryMask) {
+    stop();
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Unable to open " << path << " for tracing" << std::endl;
+        return false;
+    }
+
+    uint8_t header[16] = {'C', '8', 'T', 'R', 'A', 'C', 'E', 0};
+    uint16_t fields[4] = {VERSION, sizeof(TraceRecord), ORDER_MARK, categoryMask};
+    memcpy(header + 8, fields, sizeof(fields));
+    fwrite(header, 1, sizeof(header), file);
+
+    startTime = std::chrono::steady_clock::now();
+    written = 0;
+    droppedTotal = 0;
+    stopping = false;
+    drainer = std::thread(drainLoop);
+    categories.store(categoryMask, std::memory_order_relaxed);
+    return true;
+}
+
+void Trace::stop() {
+    if (!file) {
+        return;
+    }
+    categories.store(0, std::memory_order_relaxed);
+    stopping.store(true, std::memory_order_release);
+    drainer.join();
+    fclose(file);
+    file = nullptr;
+
+    // Forget the rings of threads that have exited
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (size_t i = 0; i < rings.size();) {
+        if (rings[i].use_count() == 1) {
+            rings.erase(rings.begin() + i);
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+uint8_t Trace::parseCategories(std::string const& list) {
+    uint8_t mask = 0;
+    std::istringstream names(list);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        if (name == "instruction") mask |= TRACE_INSTRUCTION;
+        else if (name == "draw") mask |= TRACE_DRAW;
+        else if (name == "frame") mask |= TRACE_FRAME;
+        else if (name == "input") mask |= TRACE_INPUT;
+        else if (name == "all") mask |= TRACE_INSTRUCTION | TRACE_DRAW | TRACE_FRAME | TRACE_INPUT;
+        else return 0;
+    }
+    return mask;
+}
+
+uint64_t Trace::recordsWritten() {
+    return written.load(std::memory_order_relaxed);
+}
+
+uint64_t Trace::recordsDropped() {
+    return droppedTotal.load(std::memory_order_relaxed);
+}
+
+/**
+ * Stamp the record and push it onto this thread's ring
+ */
+void Trace::write(TraceRecord& record) {
+    if (!localRing) {
+        localRing = std::make_shared<TraceRing>();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        static uint16_t nextThread = 0;
+        localRing->thread = nextThread++;
+        rings.push_back(localRing);
+    }
+    record.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+    record.thread = localRing->thread;
+    if (!localRing->queue.tryPush(record)) {
+        localRing->dropped.fetch_add(1, std::memory_order_relaxed);
+        droppedTotal.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Trace::instruction(uint16_t pc, uint16_t opcode, uint8_t const* before, uint8_t const* after, uint16_t I) {
+    TraceRecord record{};
+    record.category = TRACE_INSTRUCTION;
+    record.pc = pc;
+    record.opcode = opcode;
+    record.I = I;
+    for (int r = 0; r < 16; r++) {
+        record.changed |= (before[r] != after[r]) << r;
+    }
+    memcpy(record.data, after, 16);
+    write(record);
+}
+
+void Trace::draw(uint16_t pc, uint16_t opcode, uint8_t x, uint8_t y, uint8_t height, bool collision) {
+    TraceRecord record{};
+    record.category = TRACE_DRAW;
+    record.pc = pc;
+    record.opcode = opcode;
+    record.data[0] = x;
+    record.data[1] = y;
+    record.data[2] = height;
+    record.data[3] = collision;
+    write(record);
+}
+
+void Trace::frame(uint16_t pc, uint8_t delayTimer, uint8_t soundTimer) {
+    TraceRecord record{};
+    record.category = TRACE_FRAME;
+    record.pc = pc;
+    record.data[0] = delayTimer;
+    record.data[1] = soundTimer;
+    write(record);
+}
+
+void Trace::input(uint8_t key, bool pressed) {
+    TraceRecord record{};
+    record.category = TRACE_INPUT;
+    record.data[0] = key;
+    record.data[1] = pressed;
+    write(record);
+}
@@ -0,0 +1,124 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Build with -DCHIP8_TRACE=0 to compile every trace point out of the core
+#ifndef CHIP8_TRACE
+#define CHIP8_TRACE 1
+#endif
+
+/**
+ * Trace categories, selected at runtime by the mask passed to Trace::start
+ */
+enum TraceCategory : uint8_t {
+    TRACE_INSTRUCTION = 1 << 0, // Every executed instruction and the registers it wrote
+    TRACE_DRAW = 1 << 1, // OP_Dxyn position, height and collision
+    TRACE_FRAME = 1 << 2, // Timer tick at the end of each 60Hz frame
+    TRACE_INPUT = 1 << 3, // Key presses and releases seen by the front end
+    TRACE_LOST = 1 << 7, // Written by the drain thread when a ring was full
+};
+
+/**
+ * One fixed-size trace record, stored as-is (host byte order) in the file
+ *
+ * Meaning of data per category:
+ *   INSTRUCTION: V0-VF after the instruction; changed has bit r set if Vr changed
+ *   DRAW: x, y, height, collision (VF)
+ *   FRAME: delay timer, sound timer
+ *   INPUT: key, 1 if pressed
+ *   LOST: uint32 number of records the thread dropped
+ */
+struct TraceRecord {
+    uint64_t time; // Nanoseconds since Trace::start
+    uint16_t thread; // Writing thread, numbered in the order they first traced
+    uint8_t category;
+    uint8_t reserved;
+    uint16_t pc; // Address of the instruction
+    uint16_t opcode;
+    uint16_t changed;
+    uint16_t I;
+    uint8_t data[20];
+};
+
+static_assert(sizeof(TraceRecord) == 40, "TraceRecord is written to disk as-is");
+
+/**
+ * Binary ring-buffer tracer
+ *
+ * Trace points copy a TraceRecord into a lock-free ring owned by the calling
+ * thread; they never lock, allocate after the first record or touch the disk.
+ * A background thread drains every ring to the file. When a ring is full the
+ * record is dropped and counted, and the drain thread writes a LOST record.
+ * Records of one thread stay in order; threads interleave in drain order.
+ *
+ * A trace point costs one relaxed load and a branch while its category is
+ * off, and nothing when built with CHIP8_TRACE=0. Decode files with tracedump.
+ *
+ * File format: "C8TRACE" 0x00, uint16 version, uint16 record size,
+ * uint16 ORDER_MARK, uint16 category mask, then TraceRecords, all in the
+ * byte order of the host that wrote it. tracedump rejects a file whose
+ * ORDER_MARK reads differently.
+ */
+class Trace {
+public:
+    static uint16_t const VERSION = 2;
+    static uint16_t const ORDER_MARK = 0x0102;
+
+    /**
+     * Open the trace file and start the drain thread
+     * @param path File to write
+     * @param categoryMask TraceCategory bits to record
+     */
+    static bool start(std::string const& path, uint8_t categoryMask);
+
+    /**
+     * Stop tracing, drain every ring and close the file
+     */
+    static void stop();
+
+    /**
+     * Parse a comma-separated list such as "draw,frame" ("all" for every category)
+     * @return The mask, or 0 if a name is unknown
+     */
+    static uint8_t parseCategories(std::string const& list);
+
+    static bool enabled(uint8_t category) {
+#if CHIP8_TRACE
+        return categories.load(std::memory_order_relaxed) & category;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * Stop every trace point until resume(), e.g. while running frames that
+     * will be thrown away
+     * @return The categories to pass to resume()
+     */
+    static uint8_t pause() {
+        return categories.exchange(0, std::memory_order_relaxed);
+    }
+
+    static void resume(uint8_t categoryMask) {
+        categories.store(categoryMask, std::memory_order_relaxed);
+    }
+
+    /* Trace points, only called when their category is enabled */
+    static void instruction(uint16_t pc, uint16_t opcode, uint8_t const* before, uint8_t const* after, uint16_t I);
+    static void draw(uint16_t pc, uint16_t opcode, uint8_t x, uint8_t y, uint8_t height, bool collision);
+    static void frame(uint16_t pc, uint8_t delayTimer, uint8_t soundTimer);
+    static void input(uint8_t key, bool pressed);
+
+    static uint64_t recordsWritten();
+    static uint64_t recordsDropped();
+
+private:
+    static void write(TraceRecord& record);
+
+    static inline std::atomic<uint8_t> categories{0};
+};
+
+#endif
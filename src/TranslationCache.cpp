@@ -0,0 +1,254 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "TranslationCache.h"
+#include "chip8.h"
+using namespace std;
+
+static char const MAGIC[8] = {'C', '8', 'X', 'L', 'A', 'T', 'E', '\0'};
+static uint32_t const ORDER_MARK = 0x01020304;
+static size_t const FILE_SIZE = sizeof(TranslationFileHeader) + Translation::ENTRIES * sizeof(DecodedOp);
+
+/**
+ * Decode one instruction the way Chip8::cycle() does
+ */
+DecodedOp decodeOp(uint8_t high, uint8_t low) {
+    uint8_t handler = DECODED_INVALID;
+    switch (high >> 4) {
+        case 0x0:
+            handler = low == 0xE0 ? DECODED_00E0 : low == 0xEE ? DECODED_00EE : DECODED_INVALID;
+            break;
+        case 0x1: handler = DECODED_1nnn; break;
+        case 0x2: handler = DECODED_2nnn; break;
+        case 0x3: handler = DECODED_3xkk; break;
+        case 0x4: handler = DECODED_4xkk; break;
+        case 0x5: handler = DECODED_5xy0; break;
+        case 0x6: handler = DECODED_6xkk; break;
+        case 0x7: handler = DECODED_7xkk; break;
+        case 0x8:
+            switch (low & 0xF) {
+                case 0x0: handler = DECODED_8xy0; break;
+                case 0x1: handler = DECODED_8xy1; break;
+                case 0x2: handler = DECODED_8xy2; break;
+                case 0x3: handler = DECODED_8xy3; break;
+                case 0x4: handler = DECODED_8xy4; break;
+                case 0x5: handler = DECODED_8xy5; break;
+                case 0x6: handler = DECODED_8xy6; break;
+                case 0x7: handler = DECODED_8xy7; break;
+                case 0xE: handler = DECODED_8xyE; break;
+            }
+            break;
+        case 0x9: handler = DECODED_9xy0; break;
+        case 0xA: handler = DECODED_Annn; break;
+        case 0xB: handler = DECODED_Bnnn; break;
+        case 0xC: handler = DECODED_Cxkk; break;
+        case 0xD: handler = DECODED_Dxyn; break;
+        case 0xE:
+            handler = low == 0x9E ? DECODED_Ex9E : low == 0xA1 ? DECODED_ExA1 : DECODED_INVALID;
+            break;
+        case 0xF:
+            switch (low) {
+                case 0x07: handler = DECODED_Fx07; break;
+                case 0x0A: handler = DECODED_Fx0A; break;
+                case 0x15: handler = DECODED_Fx15; break;
+                case 0x18: handler = DECODED_Fx18; break;
+                case 0x1E: handler = DECODED_Fx1E; break;
+                case 0x29: handler = DECODED_Fx29; break;
+                case 0x33: handler = DECODED_Fx33; break;
+                case 0x55: handler = DECODED_Fx55; break;
+                case 0x65: handler = DECODED_Fx65; break;
+            }
+            break;
+    }
+    return {handler, uint8_t(high & 0xF), low, uint8_t(vipCost(high << 8 | low))};
+}
+
+/**
+ * FNV-1a over the table, a word at a time
+ */
+static uint64_t checksum(DecodedOp const* ops) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (int i = 0; i < Translation::ENTRIES; i += 2) {
+        uint64_t word;
+        memcpy(&word, ops + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+
+/* Translation */
+
+Translation::Translation(uint8_t const* memory) : owned(ENTRIES) {
+    for (int address = 0; address < ENTRIES; address++) {
+        owned[address] = decodeOp(memory[address], memory[(address + 1) % ENTRIES]);
+    }
+    table = owned.data();
+}
+
+Translation::Translation(void* mapping, size_t mappingSize, DecodedOp const* ops)
+    : mapping(mapping), mappingSize(mappingSize), table(ops) {
+    source = TRANSLATION_MAPPED;
+}
+
+Translation::~Translation() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+    }
+}
+
+
+/* TranslationCache */
+
+TranslationCache::TranslationCache(string directory)
+    : directory(directory.empty() ? defaultDirectory() : directory) {
+}
+
+string TranslationCache::defaultDirectory() {
+    char const* cache = getenv("XDG_CACHE_HOME");
+    char const* home = getenv("HOME");
+    if (cache && *cache) {
+        return (filesystem::path(cache) / "chip8" / "translations").string();
+    }
+    return home ? (filesystem::path(home) / ".cache" / "chip8" / "translations").string() : string();
+}
+
+string TranslationCache::path(TranslationKey const& key) const {
+    char name[64];
+    snprintf(name, sizeof(name), "%016llx-%u-%u.c8t", (unsigned long long)key.romHash, key.romSize, key.profile);
+    return (filesystem::path(directory) / name).string();
+}
+
+shared_ptr<Translation const> TranslationCache::get(TranslationKey const& key, uint8_t const* memory) {
+    lock_guard<std::mutex> lock(mutex);
+    auto found = live.find(key);
+    if (found != live.end()) {
+        if (shared_ptr<Translation const> translation = found->second.lock()) {
+            return translation;
+        }
+    }
+
+    string rejected;
+    shared_ptr<Translation const> translation = load(key, rejected);
+    if (!translation) {
+        auto decoded = make_shared<Translation>(memory);
+        decoded->rejected = rejected;
+        decoded->source = store(key, *decoded) ? TRANSLATION_STORED : TRANSLATION_DECODED;
+        translation = decoded;
+    }
+
+    // Drop the keys no core uses any more
+    for (auto i = live.begin(); i != live.end();) {
+        i = i->second.expired() ? live.erase(i) : next(i);
+    }
+    live[key] = translation;
+    return translation;
+}
+
+/**
+ * Map the file for a key and validate it
+ *
+ * @param rejected - Set to the reason if a file exists but is not usable
+ * @return The mapped translation, or null
+ */
+shared_ptr<Translation const> TranslationCache::load(TranslationKey const& key, string& rejected) {
+    if (directory.empty()) {
+        return nullptr;
+    }
+    int fd = open(path(key).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) < 0) {
+        rejected = string("fstat failed: ") + strerror(errno);
+        close(fd);
+        return nullptr;
+    }
+    if (size_t(status.st_size) != FILE_SIZE) {
+        rejected = "size " + to_string(status.st_size) + ", expected " + to_string(FILE_SIZE);
+        close(fd);
+        return nullptr;
+    }
+    void* mapping = mmap(nullptr, FILE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        rejected = string("mmap failed: ") + strerror(errno);
+        return nullptr;
+    }
+
+    TranslationFileHeader const* header = static_cast<TranslationFileHeader const*>(mapping);
+    DecodedOp const* ops = reinterpret_cast<DecodedOp const*>(header + 1);
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0) {
+        rejected = "not a translation file";
+    }
+    else if (header->byteOrder != ORDER_MARK) {
+        rejected = "written with another byte order";
+    }
+    else if (header->version != FORMAT_VERSION) {
+        rejected = "format version " + to_string(header->version) + ", expected " + to_string(FORMAT_VERSION);
+    }
+    else if (header->romHash != key.romHash || header->romSize != key.romSize || header->profile != key.profile) {
+        rejected = "made for another ROM or quirk profile";
+    }
+    else if (header->entries != uint32_t(Translation::ENTRIES) || header->opSize != sizeof(DecodedOp)) {
+        rejected = "table of another shape";
+    }
+    else if (header->checksum != checksum(ops)) {
+        rejected = "checksum mismatch";
+    }
+    if (!rejected.empty()) {
+        munmap(mapping, FILE_SIZE);
+        return nullptr;
+    }
+    return make_shared<Translation>(mapping, FILE_SIZE, ops);
+}
+
+/**
+ * Write a translation to a temporary file and rename it into place
+ *
+ * @return False if the directory or the file could not be written
+ */
+bool TranslationCache::store(TranslationKey const& key, Translation const& translation) {
+    if (directory.empty()) {
+        return false;
+    }
+    error_code error;
+    filesystem::create_directories(directory, error);
+
+    TranslationFileHeader header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FORMAT_VERSION;
+    header.byteOrder = ORDER_MARK;
+    header.romHash = key.romHash;
+    header.romSize = key.romSize;
+    header.profile = key.profile;
+    header.entries = Translation::ENTRIES;
+    header.opSize = sizeof(DecodedOp);
+    header.checksum = checksum(translation.ops());
+
+    string file = path(key);
+    string temporary = file + ".XXXXXX";
+    int fd = mkstemp(&temporary[0]);
+    if (fd < 0) {
+        return false;
+    }
+    fchmod(fd, 0644);
+
+    // A file cut short by a crash fails the size check, so there is no fsync
+    bool written = write(fd, &header, sizeof(header)) == ssize_t(sizeof(header)) &&
+                   write(fd, translation.ops(), FILE_SIZE - sizeof(header)) == ssize_t(FILE_SIZE - sizeof(header));
+    close(fd);
+    if (!written || rename(temporary.c_str(), file.c_str()) != 0) {
+        unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,180 @@
+#ifndef TRANSLATION_CACHE_H
+#define TRANSLATION_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/**
+ * Which OP_* handler a decoded instruction runs
+ */
+enum DecodedHandler : uint8_t {
+    DECODED_INVALID,
+    DECODED_00E0, DECODED_00EE,
+    DECODED_1nnn, DECODED_2nnn, DECODED_3xkk, DECODED_4xkk, DECODED_5xy0, DECODED_6xkk, DECODED_7xkk,
+    DECODED_8xy0, DECODED_8xy1, DECODED_8xy2, DECODED_8xy3, DECODED_8xy4, DECODED_8xy5, DECODED_8xy6,
+    DECODED_8xy7, DECODED_8xyE, DECODED_9xy0, DECODED_Annn, DECODED_Bnnn, DECODED_Cxkk, DECODED_Dxyn,
+    DECODED_Ex9E, DECODED_ExA1,
+    DECODED_Fx07, DECODED_Fx0A, DECODED_Fx15, DECODED_Fx18, DECODED_Fx1E, DECODED_Fx29, DECODED_Fx33,
+    DECODED_Fx55, DECODED_Fx65,
+    DECODED_STALE, // Stored over since it was decoded; never in a Translation
+    DECODED_HANDLERS
+};
+
+/**
+ * One instruction, decoded
+ *
+ * The operands are the instruction's low 12 bits: x is the second nibble and
+ * kk the low byte, so y = kk >> 4, n = kk & 0xF and nnn = x << 8 | kk.
+ */
+struct DecodedOp {
+    uint8_t handler; // DecodedHandler
+    uint8_t x;
+    uint8_t kk;
+    uint8_t vipCost; // vipCost() of the instruction; at most 251
+};
+
+/**
+ * Decode the instruction made of two memory bytes
+ */
+DecodedOp decodeOp(uint8_t high, uint8_t low);
+
+/**
+ * Identifies a translation: the ROM it was decoded from and the quirk profile
+ */
+struct TranslationKey {
+    uint64_t romHash; // romHash() of the ROM image
+    uint32_t romSize;
+    uint32_t profile; // cpShift << 2 | scJump << 1 | cosmacMem, as withQuirks()
+
+    bool operator<(TranslationKey const& other) const {
+        return std::tie(romHash, romSize, profile) < std::tie(other.romHash, other.romSize, other.profile);
+    }
+};
+
+/**
+ * Header of a cache file, followed by Translation::ENTRIES DecodedOps
+ */
+struct TranslationFileHeader {
+    char magic[8]; // "C8XLATE\0"
+    uint32_t version; // TranslationCache::FORMAT_VERSION
+    uint32_t byteOrder; // 0x01020304 as written by the host
+    uint64_t romHash;
+    uint32_t romSize;
+    uint32_t profile;
+    uint32_t entries;
+    uint32_t opSize; // sizeof(DecodedOp)
+    uint64_t checksum; // Of the table
+    uint8_t reserved[16];
+};
+
+static_assert(sizeof(TranslationFileHeader) == 64, "The table starts 64 bytes into a cache file");
+
+enum TranslationSource {
+    TRANSLATION_DECODED, // Decoded in memory; there is no cache or it could not be written
+    TRANSLATION_STORED, // Decoded and written to the cache: a cold start
+    TRANSLATION_MAPPED, // Mapped from the cache: a warm start
+};
+
+/**
+ * The decoded instruction at every address of a freshly loaded machine
+ *
+ * Read-only once made, so any number of cores may share one. A mapped table
+ * stays valid as long as the object lives, even if the file is replaced.
+ */
+class Translation {
+public:
+    static int const ENTRIES = 4096; // One per address; pc may be odd
+
+    /**
+     * Decode memory into a table owned by the object
+     */
+    explicit Translation(uint8_t const* memory);
+
+    /**
+     * Take over a mapping of a cache file whose table starts at ops
+     */
+    Translation(void* mapping, size_t mappingSize, DecodedOp const* ops);
+
+    ~Translation();
+    Translation(Translation const&) = delete;
+    Translation& operator=(Translation const&) = delete;
+
+    DecodedOp const* ops() const { return table; }
+
+    TranslationSource source = TRANSLATION_DECODED;
+    std::string rejected; // Why a cache file found for the key was not used, empty if none was
+
+private:
+    std::vector<DecodedOp> owned;
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    DecodedOp const* table;
+};
+
+/**
+ * Persistent cache of translations, one file per ROM and quirk profile
+ *
+ * A file is a TranslationFileHeader followed by the table, in host byte
+ * order, and is mapped read-only and shared, so every process that runs the
+ * ROM uses the same page-cache pages and a warm start does no decoding. The
+ * header is validated before the table is used: magic, format version, byte
+ * order, key, entry count, file size and a checksum of the table. A file that
+ * fails any check is decoded afresh and replaced, so a stale or damaged file
+ * only costs a cold start.
+ *
+ * Files are written to a temporary name and renamed into place, never
+ * rewritten, so processes that have the old file mapped keep a consistent
+ * table. Failing to read or write the cache directory only costs the decoding.
+ *
+ * Within a process, cores of the same key share one Translation as long as
+ * any of them holds it. The cache may be used from several threads.
+ */
+class TranslationCache {
+public:
+    /**
+     * Bumped when the file layout, DecodedOp, or the decoding changes. Fonts
+     * are part of the decoded image, so changing them bumps it too.
+     */
+    static uint32_t const FORMAT_VERSION = 1;
+
+    /**
+     * @param directory - Where the files live, created on the first store;
+     * defaultDirectory() if empty
+     */
+    explicit TranslationCache(std::string directory = "");
+
+    /**
+     * The translation of a freshly loaded memory image, mapped from the cache
+     * if a valid file exists, otherwise decoded and stored
+     *
+     * @param memory - The whole 4KB image: fonts and ROM, as loadRom() left it
+     */
+    std::shared_ptr<Translation const> get(TranslationKey const& key, uint8_t const* memory);
+
+    /**
+     * File for a key: <romHash>-<romSize>-<profile>.c8t in the directory
+     */
+    std::string path(TranslationKey const& key) const;
+
+    /**
+     * $XDG_CACHE_HOME/chip8/translations, or ~/.cache/chip8/translations;
+     * empty if neither is set
+     */
+    static std::string defaultDirectory();
+
+private:
+    std::shared_ptr<Translation const> load(TranslationKey const& key, std::string& rejected);
+    bool store(TranslationKey const& key, Translation const& translation);
+
+    std::string directory;
+    std::mutex mutex;
+    std::map<TranslationKey, std::weak_ptr<Translation const>> live;
+};
+
+#endif
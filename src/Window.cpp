@@ -1,34 +1,12 @@
 #include <SDL2/SDL.h>
 #include <iostream>
-
-/**
- * A class to handle I/O using the SDL library
- */
-class Window {
-public:
-	SDL_Window* window;
-	SDL_Renderer* renderer;
-	SDL_Texture* texture;
-	SDL_AudioDeviceID audioDevice;
-	int WIDTH;
-	int HEIGHT;
-	int SCALE;
-
-   	Window(int width, int height, int scale);
-    ~Window();  // Destructor declaration
-    
-    void update(void const* buffer);
-    void startBeep();
-    void stopBeep();
-    bool processInput(size_t* keys);
-    //static void audioCallback(void* userdata, Uint8* stream, int len);
-};
+#include "Window.h"
 
 /**
  * Sound functionality - generate square wave
  */
-static void audioCallback (void* userdata, Uint8* stream, int len) {
-	const int SAMPLE_RATE = 44100;
+void Window::audioCallback (void* userdata, Uint8* stream, int len) {
+	const int SAMPLE_RATE = AUDIO_RATE;
 	const int AMPLITUDE = 28000;
 	const int FREQUENCY = 440;
 	
@@ -42,10 +20,14 @@ static void audioCallback (void* userdata, Uint8* stream, int len) {
 	}
 }
 
-Window::Window (const int width, const int height, const int scale) {
+Window::Window (const int width, const int height, const int scale, const bool queuedAudio) {
 	WIDTH = width;
 	HEIGHT = height;
 	SCALE = scale;
+	pixels.assign(WIDTH * HEIGHT, 0);
+	this->queuedAudio = queuedAudio;
+	beeping = false;
+	phase = 0;
 
 	SDL_Init(SDL_INIT_VIDEO);
 	window = SDL_CreateWindow("Chip 8", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WIDTH*SCALE, HEIGHT*SCALE, 0);
@@ -54,12 +36,21 @@ Window::Window (const int width, const int height, const int scale) {
 
 	SDL_Init(SDL_INIT_AUDIO);
 	SDL_AudioSpec desiredSpec{};
-	desiredSpec.freq = 44100;
+	desiredSpec.freq = AUDIO_RATE;
 	desiredSpec.format = AUDIO_S16SYS;
 	desiredSpec.channels = 1;
 	desiredSpec.samples = 2048;
 	desiredSpec.callback = audioCallback; 
+	if (queuedAudio) {
+		// Smaller blocks, so the queue's fill level is measured more finely;
+		// the device plays silence while the queue is empty
+		desiredSpec.samples = 512;
+		desiredSpec.callback = NULL;
+	}
 	audioDevice = SDL_OpenAudioDevice(NULL, 0, &desiredSpec, NULL, 0);
+	if (queuedAudio) {
+		SDL_PauseAudioDevice(audioDevice, 0);
+	}
 }
 
 Window::~Window () {
@@ -71,10 +62,15 @@ Window::~Window () {
 }
 
 /**
- * Used to update the display with pixel data from buffer
+ * Used to update the display with the packed rows of the core's display
  */
-void Window::update (void const* buffer) {
-	SDL_UpdateTexture(texture, NULL, buffer, WIDTH*sizeof(uint32_t)); 
+void Window::update (uint64_t const* rows) {
+	for (int y = 0; y < HEIGHT; y++) {
+		for (int x = 0; x < WIDTH; x++) {
+			pixels[y * WIDTH + x] = (rows[y] >> (WIDTH - 1 - x)) & 1 ? 0xFFFFFFFF : 0x00000000;
+		}
+	}
+	SDL_UpdateTexture(texture, NULL, pixels.data(), WIDTH*sizeof(uint32_t)); 
 
 	SDL_Rect destRect = {0, 0, WIDTH*SCALE, HEIGHT*SCALE}; // Scaling
 
@@ -87,6 +83,10 @@ void Window::update (void const* buffer) {
  * Start playing beep
  */
 void Window::startBeep () {
+	if (queuedAudio) {
+		beeping = true;
+		return;
+	}
 	SDL_PauseAudioDevice (audioDevice, 0);
 }
 
@@ -94,13 +94,38 @@ void Window::startBeep () {
  * Stop playing beep
  */
 void Window::stopBeep () {
+	if (queuedAudio) {
+		beeping = false;
+		return;
+	}
 	SDL_PauseAudioDevice (audioDevice, 1);
 }
 
+/**
+ * Queue audio - the same square wave as audioCallback, or silence
+ */
+void Window::queueAudio (int count) {
+	const int AMPLITUDE = 28000;
+	const int PERIOD = AUDIO_RATE / 440;
+
+	samples.assign(count, 0);
+	if (beeping) {
+		for (int i = 0; i < count; ++i) {
+			samples[i] = (phase < PERIOD / 2) ? AMPLITUDE : -AMPLITUDE;
+			phase = (phase + 1) % PERIOD;
+		}
+	}
+	SDL_QueueAudio(audioDevice, samples.data(), count * sizeof(int16_t));
+}
+
+int Window::queuedSamples () {
+	return SDL_GetQueuedAudioSize(audioDevice) / sizeof(int16_t);
+}
+
 /**
  * Keypad functionality
  */
-bool Window::processInput (size_t* keys) {
+bool Window::processInput (uint16_t& keys) {
 	SDL_Event event;
 	bool quit = false;
 
@@ -113,104 +138,104 @@ bool Window::processInput (size_t* keys) {
 		if (event.type == SDL_KEYDOWN) {
 			switch (event.key.keysym.sym) {
 				case SDLK_x:
-					keys[0] = 1;
+					keys |= 1 << 0;
 					break;
 				case SDLK_1:
-					keys[1] = 1;
+					keys |= 1 << 1;
 					break;
 				case SDLK_2:
-					keys[2] = 1;
+					keys |= 1 << 2;
 					break;
 				case SDLK_3:
-					keys[3] = 1;
+					keys |= 1 << 3;
 					break;
 				case SDLK_q:
-					keys[4] = 1;
+					keys |= 1 << 4;
 					break;
 				case SDLK_w:
-					keys[5] = 1;
+					keys |= 1 << 5;
 					break;
 				case SDLK_e:
-					keys[6] = 1;
+					keys |= 1 << 6;
 					break;
 				case SDLK_a:
-					keys[7] = 1;
+					keys |= 1 << 7;
 					break;
 				case SDLK_s:
-					keys[8] = 1;
+					keys |= 1 << 8;
 					break;
 				case SDLK_d:
-					keys[9] = 1;
+					keys |= 1 << 9;
 					break;
 				case SDLK_z:
-					keys[0xA] = 1;
+					keys |= 1 << 0xA;
 					break;
 				case SDLK_c:
-					keys[0xB] = 1;
+					keys |= 1 << 0xB;
 					break;
 				case SDLK_4:
-					keys[0xC] = 1;
+					keys |= 1 << 0xC;
 					break;
 				case SDLK_r:
-					keys[0xD] = 1;
+					keys |= 1 << 0xD;
 					break;
 				case SDLK_f:
-					keys[0xE] = 1;
+					keys |= 1 << 0xE;
 					break;
 				case SDLK_v:
-					keys[0xF] = 1;
+					keys |= 1 << 0xF;
 					break;
 			}
 		}
 		if (event.type == SDL_KEYUP) {
 			switch (event.key.keysym.sym) {
 				case SDLK_x:
-					keys[0] = 0;
+					keys &= ~(1 << 0);
 					break;
 				case SDLK_1:
-					keys[1] = 0;
+					keys &= ~(1 << 1);
 					break;
 				case SDLK_2:
-					keys[2] = 0;
+					keys &= ~(1 << 2);
 					break;
 				case SDLK_3:
-					keys[3] = 0;
+					keys &= ~(1 << 3);
 					break;
 				case SDLK_q:
-					keys[4] = 0;
+					keys &= ~(1 << 4);
 					break;
 				case SDLK_w:
-					keys[5] = 0;
+					keys &= ~(1 << 5);
 					break;
 				case SDLK_e:
-					keys[6] = 0;
+					keys &= ~(1 << 6);
 					break;
 				case SDLK_a:
-					keys[7] = 0;
+					keys &= ~(1 << 7);
 					break;
 				case SDLK_s:
-					keys[8] = 0;
+					keys &= ~(1 << 8);
 					break;
 				case SDLK_d:
-					keys[9] = 0;
+					keys &= ~(1 << 9);
 					break;
 				case SDLK_z:
-					keys[0xA] = 0;
+					keys &= ~(1 << 0xA);
 					break;
 				case SDLK_c:
-					keys[0xB] = 0;
+					keys &= ~(1 << 0xB);
 					break;
 				case SDLK_4:
-					keys[0xC] = 0;
+					keys &= ~(1 << 0xC);
 					break;
 				case SDLK_r:
-					keys[0xD] = 0;
+					keys &= ~(1 << 0xD);
 					break;
 				case SDLK_f:
-					keys[0xE] = 0;
+					keys &= ~(1 << 0xE);
 					break;
 				case SDLK_v:
-					keys[0xF] = 0;
+					keys &= ~(1 << 0xF);
 					break;
 			}
 		}
@@ -4,6 +4,7 @@
 #include <SDL2/SDL.h>
 #include <cstddef>
 #include <cstdint>
+#include <vector>
 
 /**
  * A class to handle I/O using the SDL library
@@ -17,14 +18,22 @@ public:
     int WIDTH;
     int HEIGHT;
     int SCALE;
+    std::vector<uint32_t> pixels; // The display expanded to one RGBA value per pixel
+    bool queuedAudio; // Samples come from queueAudio() instead of audioCallback
+    bool beeping;
+    int phase; // Sample within the square wave's period, for queueAudio()
+    std::vector<int16_t> samples; // Scratch buffer for queueAudio()
+
+    static int const AUDIO_RATE = 44100;
 
     /**
      * Constructor for the Window class
      * @param width The width of the window in pixels
      * @param height The height of the window in pixels
      * @param scale The scale factor for the window
+     * @param queuedAudio Play samples passed to queueAudio() instead of a beep started and stopped
      */
-    Window(const int width, const int height, const int scale);
+    Window(const int width, const int height, const int scale, const bool queuedAudio = false);
 
     /**
      * Destructor for the Window class
@@ -32,10 +41,10 @@ public:
     ~Window();
 
     /**
-     * Update the display with pixel data from a buffer
-     * @param buffer Pointer to the pixel data buffer
+     * Update the display from the core's display
+     * @param rows One row per word, leftmost pixel in the top bit
      */
-    void update(void const* buffer);
+    void update(uint64_t const* rows);
 
     /**
      * Start playing a beep sound
@@ -47,12 +56,24 @@ public:
      */
     void stopBeep();
 
+    /**
+     * Queue the next samples of the beep, or silence while it is stopped.
+     * Only with queuedAudio.
+     * @param count Number of samples
+     */
+    void queueAudio(int count);
+
+    /**
+     * Samples queued and not played yet. Only with queuedAudio.
+     */
+    int queuedSamples();
+
     /**
      * Process input from the keypad
-     * @param keys Pointer to an array representing key states
+     * @param keys Key mask, bit k set while key k is down
      * @return True if a quit event occurred, false otherwise
      */
-    bool processInput(size_t* keys);
+    bool processInput(uint16_t& keys);
 
     /**
      * Audio callback function for generating square waves
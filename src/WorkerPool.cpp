@@ -0,0 +1,72 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(size_t threads) {
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    for (size_t i = 0; i < threads; i++) {
+        workers.emplace_back(&WorkerPool::workerLoop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+/**
+ * Publish a job, let every worker pull items from the shared counter and
+ * wait until the last one has finished
+ */
+void WorkerPool::parallelFor(size_t items, std::function<void(size_t, size_t)> const& work) {
+    if (items == 0) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    job = &work;
+    count = items;
+    next.store(0, std::memory_order_relaxed);
+    running = workers.size();
+    generation++;
+    start.notify_all();
+    done.wait(lock, [this] { return running == 0; });
+    job = nullptr;
+}
+
+void WorkerPool::workerLoop(size_t worker) {
+    unsigned long seen = 0;
+    while (true) {
+        std::function<void(size_t, size_t)> const* work;
+        size_t items;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            work = job;
+            items = count;
+        }
+
+        for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < items; i = next.fetch_add(1, std::memory_order_relaxed)) {
+            (*work)(i, worker);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--running == 0) {
+            done.notify_one();
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed pool of worker threads running parallel-for jobs
+ */
+class WorkerPool {
+public:
+    /**
+     * Constructor for the WorkerPool class
+     * @param threads Number of worker threads, 0 for one per hardware thread
+     */
+    explicit WorkerPool(size_t threads = 0);
+
+    /**
+     * Destructor for the WorkerPool class, joins the workers
+     */
+    ~WorkerPool();
+
+    WorkerPool(WorkerPool const&) = delete;
+    WorkerPool& operator=(WorkerPool const&) = delete;
+
+    /**
+     * Call job(i) for every i in [0, count) across the workers and wait for
+     * all of them to finish
+     * @param count Number of work items
+     * @param job Function called with the index of each work item and the
+     * index of the worker running it
+     */
+    void parallelFor(size_t count, std::function<void(size_t item, size_t worker)> const& job);
+
+    /**
+     * Number of worker threads
+     */
+    size_t size() const { return workers.size(); }
+
+private:
+    void workerLoop(size_t worker);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable start;
+    std::condition_variable done;
+    std::function<void(size_t, size_t)> const* job = nullptr;
+    std::atomic<size_t> next{0};
+    size_t count = 0;
+    size_t running = 0;
+    unsigned long generation = 0;
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,717 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include "Chip8Batch.h"
+#include "PerfCounters.h"
+#include "Predecoded.h"
+#include "QuirkDetect.h"
+#include "Recorder.h"
+#include "RomGen.h"
+#include "Trace.h"
+#include "chip8.h"
+#include "chip8_c.h"
+using namespace std;
+
+/**
+ * Headless benchmark for the CHIP-8 core
+ *
+ * Sections (all run by default, or pick one with --section <name>):
+ *  quirks - A loop over every quirk-dependent OP code (8xy6, 8xyE, Bnnn,
+ *           Fx55, Fx65) on the runtime-flag core and each Quirks instantiation
+ *  timing - Flat-rate frames against COSMAC VIP timed frames
+ *  record - Cost of Recorder::push() on the emulation thread
+ *  batch  - Chip8Batch against N independent Chip8 objects, as N grows
+ *  trace  - Frame rate of a drawing ROM with each trace category enabled
+ *  roms   - Every ROM in --roms with scripted input; also the PGO training run.
+ *           With --perf-counters, also the host's hardware counters over the
+ *           corpus (the sampled frames slow the MIPS figures down)
+ *  workloads - Generated ROMs of each RomGen profile (draw, recursion, alu,
+ *           memory, selfmod), for hot paths the corpus barely touches
+ *  instances - Frame rate and snapshot bandwidth of 1k to 64k Chip8 objects
+ *  translate - Starting a ROM on the Predecoded core cold, warm from the
+ *           on-disk translation cache and shared in process, and its frame
+ *           rate against Chip8 on danm8ku.ch8 and the generated workloads
+ *
+ * Throughput is reported in millions of instructions per second.
+ */
+
+// Tight loop over the quirk OP codes. V0 and V2 are zeroed before Bnnn so the
+// jump lands on the same address whether or not SC_JUMP is set.
+static uint8_t const QUIRK_LOOP[] = {
+    0xA3, 0x00, // 200: LD I, 0x300
+    0x61, 0x05, // 202: LD V1, 0x05
+    0x80, 0x16, // 204: SHR V0 {, V1}
+    0x81, 0x3E, // 206: SHL V1 {, V3}
+    0x73, 0x01, // 208: ADD V3, 0x01
+    0x84, 0x14, // 20A: ADD V4, V1
+    0xF3, 0x55, // 20C: LD [I], V3
+    0xF3, 0x65, // 20E: LD V3, [I]
+    0xA3, 0x00, // 210: LD I, 0x300
+    0x60, 0x00, // 212: LD V0, 0x00
+    0x62, 0x00, // 214: LD V2, 0x00
+    0xB2, 0x1A, // 216: JP V0, 0x21A
+    0x00, 0x00, // 218: (skipped)
+    0x12, 0x04, // 21A: JP 0x204
+};
+
+static volatile uint8_t sink;
+
+/**
+ * Run the quirk loop for a number of instructions and return the best time
+ * of several repetitions in seconds
+ */
+template <typename Q>
+double measure(long instructions, int repetitions) {
+    double best = 0;
+    for (int r = 0; r < repetitions; r++) {
+        Chip8<Q> chip8;
+        chip8.loadRom(QUIRK_LOOP, sizeof(QUIRK_LOOP));
+        chip8.loadFonts();
+
+        auto start = chrono::steady_clock::now();
+        for (long i = 0; i < instructions; i++) {
+            chip8.cycle();
+        }
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+        // Keep the result observable so the loop is not optimised away
+        sink = chip8.registers[4];
+        if (r == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+    return best;
+}
+
+/**
+ * Quirk dispatch: runtime flags against each specialized core
+ */
+void benchQuirks(long instructions, int repetitions) {
+    cout << "Quirk dispatch: " << instructions << " instructions, best of " << repetitions << endl;
+    cout << "profile   runtime MIPS  specialized MIPS  speedup" << endl;
+
+    for (int profile = 0; profile < 8; profile++) {
+        bool cp_shift = profile & 4;
+        bool sc_jump = profile & 2;
+        bool cosmac_mem = profile & 1;
+
+        RuntimeQuirks::CP_SHIFT = cp_shift;
+        RuntimeQuirks::SC_JUMP = sc_jump;
+        RuntimeQuirks::COSMAC_MEM = cosmac_mem;
+        double runtime = measure<RuntimeQuirks>(instructions, repetitions);
+
+        double specialized = withQuirks(cp_shift, sc_jump, cosmac_mem, [&](auto quirks) {
+            return measure<decltype(quirks)>(instructions, repetitions);
+        });
+
+        cout << (cp_shift ? 'S' : '-') << (sc_jump ? 'J' : '-') << (cosmac_mem ? 'M' : '-')
+             << fixed << setprecision(1)
+             << setw(18) << instructions / runtime / 1e6
+             << setw(18) << instructions / specialized / 1e6
+             << setw(8) << setprecision(2) << runtime / specialized << "x" << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * Timing models: the cost of charging VIP cycles per instruction
+ */
+void benchTiming(long instructions, int repetitions) {
+    typedef Chip8<Quirks<false, false, false>> Core;
+    double flat = 0;
+    double vip = 0;
+
+    for (int r = 0; r < repetitions; r++) {
+        Core chip8;
+        chip8.loadRom(QUIRK_LOOP, sizeof(QUIRK_LOOP));
+        chip8.loadFonts();
+        long executed = 0;
+        auto start = chrono::steady_clock::now();
+        while (executed < instructions) {
+            chip8.runFrame(11);
+            executed += 11;
+        }
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        flat = max(flat, executed / elapsed.count() / 1e6);
+        sink = chip8.registers[4];
+
+        Core timed;
+        timed.loadRom(QUIRK_LOOP, sizeof(QUIRK_LOOP));
+        timed.loadFonts();
+        executed = 0;
+        start = chrono::steady_clock::now();
+        while (executed < instructions) {
+            executed += timed.runFrameVip();
+        }
+        elapsed = chrono::steady_clock::now() - start;
+        vip = max(vip, executed / elapsed.count() / 1e6);
+        sink = timed.registers[4];
+    }
+
+    cout << "Timing model: " << instructions << " instructions, best of " << repetitions << endl;
+    cout << fixed << setprecision(1)
+         << "flat rate (11/frame)  " << setw(8) << flat << " MIPS" << endl
+         << "COSMAC VIP cycles     " << setw(8) << vip << " MIPS ("
+         << setprecision(0) << 100 * vip / flat << "% of flat rate)" << endl << endl;
+}
+
+/**
+ * Recording: frames of a drawing ROM with and without a Recorder attached
+ */
+void benchRecord(string const& romDir, int repetitions) {
+    typedef Chip8<Quirks<false, false, false>> Core;
+    int const frames = 36000; // 10 minutes of gameplay
+
+    ifstream file{romDir + "/danm8ku.ch8", ios::binary};
+    vector<uint8_t> rom{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+    if (rom.empty()) {
+        cout << "Recording: " << romDir << "/danm8ku.ch8 not found" << endl << endl;
+        return;
+    }
+
+    double plain = 0;
+    double recorded = 0;
+    uint64_t dropped = 0;
+    uint64_t bytes = 0;
+    for (int r = 0; r < repetitions; r++) {
+        Core chip8;
+        chip8.loadRom(rom.data(), rom.size());
+        chip8.loadFonts();
+        auto start = chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++) {
+            chip8.runFrame(11);
+        }
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        plain = r == 0 ? elapsed.count() : min(plain, elapsed.count());
+
+        Core timed;
+        timed.loadRom(rom.data(), rom.size());
+        timed.loadFonts();
+        {
+            Recorder recorder("/tmp/chip8-bench.c8r", false);
+            chrono::duration<double> busy{0};
+            for (int frame = 0; frame < frames; frame++) {
+                start = chrono::steady_clock::now();
+                timed.runFrame(11);
+                recorder.push(timed.display, timed.soundTimer > 0);
+                busy += chrono::steady_clock::now() - start;
+
+                // Emulation outruns real time by orders of magnitude here; give
+                // the writer the idle time it would have between 60Hz frames
+                if ((frame & 127) == 127) {
+                    this_thread::sleep_for(chrono::milliseconds(8));
+                }
+            }
+            recorded = r == 0 ? busy.count() : min(recorded, busy.count());
+            dropped = recorder.framesDropped();
+        }
+        bytes = filesystem::file_size("/tmp/chip8-bench.c8r");
+    }
+    remove("/tmp/chip8-bench.c8r");
+
+    double perFrame = (recorded - plain) / frames;
+    cout << "Recording: " << frames << " frames of danm8ku.ch8, best of " << repetitions << endl
+         << fixed << setprecision(2)
+         << "emulation only          " << setw(8) << plain / frames * 1e6 << " us/frame" << endl
+         << "emulation + recording   " << setw(8) << recorded / frames * 1e6 << " us/frame" << endl
+         << "recording cost          " << setw(8) << perFrame * 1e6 << " us/frame ("
+         << setprecision(3) << 100 * perFrame / (1.0 / 60) << "% of a 60Hz frame)" << endl
+         << "file size               " << setw(8) << setprecision(1) << double(bytes) / frames << " bytes/frame, "
+         << dropped << " frames dropped" << endl << endl;
+}
+
+/**
+ * ROM corpus: every ROM in romDir, run in frames with a key toggled every
+ * few frames so input-driven paths execute too
+ */
+void benchRoms(string const& romDir, long instructions, int repetitions, bool perfCounters) {
+    typedef Chip8<Quirks<false, false, false>> Core;
+
+    vector<string> paths;
+    if (filesystem::is_directory(romDir)) {
+        for (auto const& entry : filesystem::directory_iterator(romDir)) {
+            if (entry.path().extension() == ".ch8") {
+                paths.push_back(entry.path().string());
+            }
+        }
+    }
+    sort(paths.begin(), paths.end());
+    if (paths.empty()) {
+        cout << "ROM corpus: no .ch8 files in " << romDir << endl << endl;
+        return;
+    }
+
+    cout << "ROM corpus: " << instructions << " instructions per ROM, best of " << repetitions << endl;
+    if (perfCounters) {
+        PerfCounters::start();
+    }
+    double totalSeconds = 0;
+    for (string const& path : paths) {
+        ifstream file{path, ios::binary};
+        vector<uint8_t> rom{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+
+        double best = 0;
+        for (int r = 0; r < repetitions; r++) {
+            Core chip8;
+            chip8.loadRom(rom.data(), rom.size());
+            chip8.loadFonts();
+            uint32_t rng = 0x2545F491;
+            auto start = chrono::steady_clock::now();
+            for (long frame = 0; frame * 11 < instructions; frame++) {
+                if ((frame & 7) == 0) {
+                    rng ^= rng << 13;
+                    rng ^= rng >> 17;
+                    rng ^= rng << 5;
+                    chip8.keys ^= 1 << (rng & 0xF);
+                }
+                if (perfCounters) {
+                    PerfCounters::beginFrame();
+                    chip8.runFrame(11);
+                    PerfCounters::endFrame(11);
+                }
+                else {
+                    chip8.runFrame(11);
+                }
+            }
+            chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+            best = r == 0 ? elapsed.count() : min(best, elapsed.count());
+            sink = chip8.registers[0];
+        }
+        totalSeconds += best;
+        cout << left << setw(24) << filesystem::path(path).filename().string() << right
+             << fixed << setprecision(1) << setw(8) << instructions / best / 1e6 << " MIPS" << endl;
+    }
+    cout << left << setw(24) << "total" << right << setw(8) << paths.size() * instructions / totalSeconds / 1e6
+         << " MIPS" << endl << endl;
+    if (perfCounters) {
+        PerfCounters::stop();
+        PerfCounters::report(cout);
+        cout << endl;
+    }
+}
+
+/**
+ * Generated workloads: one ROM per RomGen profile, so each hot path is
+ * measured on its own
+ */
+void benchWorkloads(long instructions, int repetitions) {
+    typedef Chip8<Quirks<false, false, false>> Core;
+
+    cout << "Generated workloads: " << instructions << " instructions per ROM, best of " << repetitions << endl;
+    for (int profile = 0; profile < ROM_PROFILES; profile++) {
+        RomGenConfig config;
+        config.weights[ROM_RANDOM] = 0;
+        config.weights[profile] = 1;
+        vector<uint8_t> rom = generateRom(config);
+
+        double best = 0;
+        for (int r = 0; r < repetitions; r++) {
+            Core chip8;
+            chip8.loadRom(rom.data(), rom.size());
+            chip8.loadFonts();
+            auto start = chrono::steady_clock::now();
+            for (long frame = 0; frame * 11 < instructions; frame++) {
+                chip8.runFrame(11);
+            }
+            chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+            best = r == 0 ? elapsed.count() : min(best, elapsed.count());
+            sink = chip8.registers[0];
+        }
+        cout << left << setw(24) << romProfileName(RomProfile(profile)) << right
+             << fixed << setprecision(1) << setw(8) << instructions / best / 1e6 << " MIPS" << endl;
+    }
+    cout << endl;
+}
+
+/**
+ * Tracing: frames of a drawing ROM with tracing off and per category
+ */
+void benchTrace(string const& romDir, int repetitions) {
+    typedef Chip8<Quirks<false, false, false>> Core;
+    int const frames = 200000;
+
+    ifstream file{romDir + "/danm8ku.ch8", ios::binary};
+    vector<uint8_t> rom{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+    if (rom.empty()) {
+        cout << "Tracing: " << romDir << "/danm8ku.ch8 not found" << endl << endl;
+        return;
+    }
+
+    cout << "Tracing: " << frames << " frames of danm8ku.ch8, best of " << repetitions
+         << (CHIP8_TRACE ? "" : " (built with CHIP8_TRACE=0)") << endl;
+    cout << "categories            frames/s   records  dropped" << endl;
+    for (string categories : {"off", "frame", "draw,frame", "all"}) {
+        double best = 0;
+        uint64_t records = 0;
+        uint64_t dropped = 0;
+        for (int r = 0; r < repetitions; r++) {
+            Core chip8;
+            chip8.loadRom(rom.data(), rom.size());
+            chip8.loadFonts();
+            if (categories != "off") {
+                Trace::start("/tmp/chip8-bench.trace", Trace::parseCategories(categories));
+            }
+            auto start = chrono::steady_clock::now();
+            for (int frame = 0; frame < frames; frame++) {
+                chip8.runFrame(11);
+            }
+            chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+            Trace::stop();
+            best = r == 0 ? elapsed.count() : min(best, elapsed.count());
+            records = Trace::recordsWritten();
+            dropped = Trace::recordsDropped();
+            sink = chip8.registers[0];
+        }
+        cout << left << setw(18) << categories << right << fixed << setprecision(0) << setw(12) << frames / best
+             << setw(10) << (categories == "off" ? 0 : records) << setw(9) << (categories == "off" ? 0 : dropped) << endl;
+    }
+    remove("/tmp/chip8-bench.trace");
+    cout << endl;
+}
+
+/**
+ * Aggregate frames per second of N lanes, batched and as separate objects
+ *
+ * @param randomActions - Give every lane its own random keys each frame, so
+ * lanes of an input-driven ROM diverge; otherwise every lane gets no input
+ */
+void benchBatchRom(string const& name, vector<uint8_t> const& rom, bool randomActions) {
+    typedef Quirks<false, false, false> Q;
+    long const laneFrames = 400000;
+
+    cout << name << (randomActions ? ", random keys per lane" : ", no input") << endl;
+    cout << "     N   objects fps     batch fps  speedup" << endl;
+    for (size_t lanes : {1, 16, 256, 1024, 4096}) {
+        long frames = max(1L, long(laneFrames / lanes));
+        vector<uint16_t> actions(lanes * frames);
+        uint32_t rng = 0x12345678;
+        for (uint16_t& action : actions) {
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            action = randomActions ? rng & 0xFFFF : 0;
+        }
+
+        vector<Chip8<Q>> objects(lanes);
+        for (Chip8<Q>& chip8 : objects) {
+            chip8.loadRom(rom.data(), rom.size());
+            chip8.loadFonts();
+        }
+        auto start = chrono::steady_clock::now();
+        for (long frame = 0; frame < frames; frame++) {
+            for (size_t lane = 0; lane < lanes; lane++) {
+                objects[lane].keys = actions[frame * lanes + lane];
+                objects[lane].runFrame(11);
+            }
+        }
+        chrono::duration<double> separate = chrono::steady_clock::now() - start;
+        sink = objects[0].registers[0];
+
+        Chip8Batch<Q> batch(lanes, 11);
+        batch.loadRom(rom.data(), rom.size());
+        start = chrono::steady_clock::now();
+        for (long frame = 0; frame < frames; frame++) {
+            sink = batch.step(&actions[frame * lanes])[0];
+        }
+        chrono::duration<double> batched = chrono::steady_clock::now() - start;
+
+        double total = double(frames) * lanes;
+        cout << setw(6) << lanes << fixed << setprecision(0)
+             << setw(14) << total / separate.count()
+             << setw(14) << total / batched.count()
+             << setw(8) << setprecision(2) << separate.count() / batched.count() << "x" << endl;
+    }
+    cout << endl;
+}
+
+void benchBatch(string const& romDir) {
+    cout << "Batched environment: aggregate frames/s at 11 instructions per frame" << endl;
+    benchBatchRom("quirk loop", vector<uint8_t>(begin(QUIRK_LOOP), end(QUIRK_LOOP)), false);
+
+    ifstream file{romDir + "/danm8ku.ch8", ios::binary};
+    vector<uint8_t> rom{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+    if (!rom.empty()) {
+        benchBatchRom("danm8ku.ch8", rom, false);
+        benchBatchRom("danm8ku.ch8", rom, true);
+    }
+}
+
+/**
+ * Many instances: one frame on each of N separate Chip8 objects in turn, and
+ * snapshotting all of them by copy, as N outgrows the caches
+ */
+void benchInstances(string const& romDir, int repetitions) {
+    typedef Chip8<Quirks<false, false, false>> Core;
+
+    ifstream file{romDir + "/danm8ku.ch8", ios::binary};
+    vector<uint8_t> rom{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+    if (rom.empty()) {
+        cout << "Instances: " << romDir << "/danm8ku.ch8 not found" << endl << endl;
+        return;
+    }
+
+    cout << "Instances: danm8ku.ch8, " << sizeof(Core) << " bytes per Chip8, best of " << repetitions << endl;
+    cout << "     N      frames/s  instances/core  snapshots/s  snapshot GB/s" << endl;
+    for (size_t count : {1024, 16384, 65536}) {
+        vector<Core> instances(count);
+        for (Core& chip8 : instances) {
+            chip8.loadRom(rom.data(), rom.size());
+            chip8.loadFonts();
+        }
+        // Allocated and touched up front, so the copies do not count page faults
+        vector<Core> snapshots(count);
+        long passes = max(1L, long(2000000 / count));
+
+        double run = 0;
+        double snapshot = 0;
+        for (int r = 0; r < repetitions; r++) {
+            auto start = chrono::steady_clock::now();
+            for (long pass = 0; pass < passes; pass++) {
+                for (Core& chip8 : instances) {
+                    chip8.runFrame(11);
+                }
+            }
+            chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+            run = r == 0 ? elapsed.count() : min(run, elapsed.count());
+
+            start = chrono::steady_clock::now();
+            for (size_t i = 0; i < count; i++) {
+                new (&snapshots[i]) Core(instances[i]);
+            }
+            elapsed = chrono::steady_clock::now() - start;
+            snapshot = r == 0 ? elapsed.count() : min(snapshot, elapsed.count());
+            sink = snapshots[count - 1].registers[0];
+        }
+
+        double framesPerSecond = count * passes / run;
+        cout << setw(6) << count << fixed << setprecision(0) << setw(14) << framesPerSecond
+             << setw(16) << framesPerSecond / 60 << setw(13) << count / snapshot
+             << setw(15) << setprecision(1) << count * sizeof(Core) / snapshot / 1e9 << endl;
+    }
+
+    // The same frames through the C interface, one handle per instance
+    size_t const count = 16384;
+    chip8_config config{0, 660, 0, 0}; // 11 instructions per frame, as above
+    vector<chip8_core*> handles(count);
+    for (chip8_core*& handle : handles) {
+        handle = chip8_create(&config, nullptr);
+        chip8_load_rom(handle, rom.data(), rom.size());
+    }
+    long passes = max(1L, long(2000000 / count));
+    double run = 0;
+    for (int r = 0; r < repetitions; r++) {
+        auto start = chrono::steady_clock::now();
+        for (long pass = 0; pass < passes; pass++) {
+            for (chip8_core* handle : handles) {
+                chip8_run_frame(handle);
+            }
+        }
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        run = r == 0 ? elapsed.count() : min(run, elapsed.count());
+    }
+    sink = chip8_get_framebuffer(handles[0], nullptr)[0];
+    for (chip8_core* handle : handles) {
+        chip8_destroy(handle);
+    }
+    cout << setw(6) << count << fixed << setprecision(0) << setw(14) << count * passes / run
+         << setw(16) << count * passes / run / 60 << "  through chip8_c.h" << endl;
+    cout << endl;
+}
+
+/**
+ * Best time of several repetitions of count calls of f, in microseconds per call
+ */
+template <typename F>
+double microsecondsPer(int count, int repetitions, F&& f) {
+    double best = 0;
+    for (int r = 0; r < repetitions; r++) {
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            f();
+        }
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        best = r == 0 ? elapsed.count() : min(best, elapsed.count());
+    }
+    return best / count * 1e6;
+}
+
+/**
+ * Frames of a ROM on Chip8 and on Predecoded, in MIPS
+ */
+template <typename Core>
+double translatedMips(Core& chip8, long instructions, bool vipTiming) {
+    long executed = 0;
+    auto start = chrono::steady_clock::now();
+    while (executed < instructions) {
+        if (vipTiming) {
+            executed += chip8.runFrameVip();
+        }
+        else {
+            chip8.runFrame(11);
+            executed += 11;
+        }
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return executed / elapsed.count() / 1e6;
+}
+
+void benchTranslateRom(string const& name, vector<uint8_t> const& rom, long instructions, int repetitions, bool vipTiming) {
+    typedef Quirks<false, false, false> Q;
+    double interpreted = 0;
+    double predecoded = 0;
+    bool shared = true;
+    for (int r = 0; r < repetitions; r++) {
+        Chip8<Q> chip8;
+        chip8.loadRom(rom.data(), rom.size());
+        chip8.loadFonts();
+        interpreted = max(interpreted, translatedMips(chip8, instructions, vipTiming));
+        sink = chip8.registers[0];
+
+        Predecoded<Q> core;
+        core.loadRom(rom.data(), rom.size());
+        predecoded = max(predecoded, translatedMips(core, instructions, vipTiming));
+        shared = core.shared();
+        sink = core.chip8.registers[0];
+    }
+    cout << left << setw(24) << name << right << fixed << setprecision(1)
+         << setw(10) << interpreted << setw(12) << predecoded
+         << setw(8) << setprecision(2) << predecoded / interpreted << "x"
+         << (shared ? "" : "  (private table)") << endl;
+}
+
+/**
+ * Translation cache: what a start costs and what the predecoded core gains
+ */
+void benchTranslate(string const& romDir, long instructions, int repetitions) {
+    typedef Quirks<false, false, false> Q;
+    int const loads = 2000;
+
+    ifstream file{romDir + "/danm8ku.ch8", ios::binary};
+    vector<uint8_t> rom{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+    if (rom.empty()) {
+        cout << "Translation cache: " << romDir << "/danm8ku.ch8 not found" << endl << endl;
+        return;
+    }
+
+    string directory = (filesystem::temp_directory_path() / "chip8-bench-translations").string();
+    filesystem::remove_all(directory);
+    TranslationCache cache(directory);
+    TranslationKey key{romHash(rom.data(), rom.size()), uint32_t(rom.size()), 0};
+    string path = cache.path(key);
+
+    double decoded = microsecondsPer(loads, repetitions, [&] {
+        Predecoded<Q> core;
+        core.loadRom(rom.data(), rom.size());
+        sink = core.chip8.memory[0x200];
+    });
+    double cold = microsecondsPer(loads, repetitions, [&] {
+        remove(path.c_str());
+        Predecoded<Q> core(&cache);
+        core.loadRom(rom.data(), rom.size());
+        sink = core.source();
+    });
+    double warm = microsecondsPer(loads, repetitions, [&] {
+        Predecoded<Q> core(&cache);
+        core.loadRom(rom.data(), rom.size());
+        sink = core.source();
+    });
+    Predecoded<Q> holder(&cache);
+    holder.loadRom(rom.data(), rom.size());
+    double shared = microsecondsPer(loads, repetitions, [&] {
+        Predecoded<Q> core(&cache);
+        core.loadRom(rom.data(), rom.size());
+        sink = core.source();
+    });
+    filesystem::remove_all(directory);
+
+    cout << "Translation cache: starting danm8ku.ch8, " << Translation::ENTRIES * sizeof(DecodedOp)
+         << "-byte table, best of " << repetitions << endl
+         << fixed << setprecision(1)
+         << "decoded, no cache            " << setw(8) << decoded << " us" << endl
+         << "cold: decoded and stored     " << setw(8) << cold << " us" << endl
+         << "warm: mapped and validated   " << setw(8) << warm << " us" << endl
+         << "shared with a running core   " << setw(8) << shared << " us" << endl << endl;
+
+    cout << "Predecoded core: " << instructions << " instructions per ROM, best of " << repetitions << endl;
+    cout << "ROM                     Chip8 MIPS  table MIPS  speedup" << endl;
+    benchTranslateRom("danm8ku.ch8", rom, instructions, repetitions, false);
+    benchTranslateRom("danm8ku.ch8, VIP timing", rom, instructions, repetitions, true);
+    for (int profile = 0; profile < ROM_PROFILES; profile++) {
+        RomGenConfig config;
+        config.weights[ROM_RANDOM] = 0;
+        config.weights[profile] = 1;
+        benchTranslateRom(romProfileName(RomProfile(profile)), generateRom(config), instructions, repetitions, false);
+    }
+    cout << endl;
+}
+
+int main(int argc, char* argv[]) {
+    long instructions = 20000000;
+    int repetitions = 3;
+    string section;
+    string romDir = "../roms";
+    bool perfCounters = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "--instructions" && i + 1 < argc) {
+            instructions = atol(argv[++i]);
+        }
+
+        if (arg == "--repetitions" && i + 1 < argc) {
+            repetitions = atoi(argv[++i]);
+        }
+
+        if (arg == "--section" && i + 1 < argc) {
+            section = argv[++i];
+        }
+
+        if (arg == "--roms" && i + 1 < argc) {
+            romDir = argv[++i];
+        }
+
+        if (arg == "--perf-counters") {
+            perfCounters = true;
+        }
+    }
+
+    if (section.empty() || section == "quirks") {
+        benchQuirks(instructions, repetitions);
+    }
+    if (section.empty() || section == "timing") {
+        benchTiming(instructions, repetitions);
+    }
+    if (section.empty() || section == "record") {
+        benchRecord(romDir, repetitions);
+    }
+    if (section.empty() || section == "batch") {
+        benchBatch(romDir);
+    }
+    if (section.empty() || section == "trace") {
+        benchTrace(romDir, repetitions);
+    }
+    if (section.empty() || section == "roms") {
+        benchRoms(romDir, instructions, repetitions, perfCounters);
+    }
+    if (section.empty() || section == "workloads") {
+        benchWorkloads(instructions, repetitions);
+    }
+    if (section.empty() || section == "instances") {
+        benchInstances(romDir, repetitions);
+    }
+    if (section.empty() || section == "translate") {
+        benchTranslate(romDir, instructions, repetitions);
+    }
+
+    return 0;
+}
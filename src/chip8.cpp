@@ -3,89 +3,17 @@
 #include <fstream>
 #include <cstring>
 #include <cstdlib>
-#include <unistd.h>
-#include "Window.h"
+#include "chip8.h"
+#include "PerfCounters.h"
+#include "Trace.h"
 using namespace std;
 
-class Chip8 {
-    public:
-        /* Constants */
-        static int const WIDTH = 64; // Display's x dimension 
-        static int const HEIGHT = 32; // Display's y dimension
-        int const START_ADDRESS = 0x200; // Load ROM from this address onwards (512 in base 10)
-        int const FONT_ADDRESS = 0x50; // Load Fonts at this address
-
-        /* Instance variables */
-        uint8_t memory[4096]{};
-        uint32_t display[WIDTH * HEIGHT]{}; // Monochrome display
-        uint16_t pc{};
-        uint16_t I{};
-        uint16_t stack[16]{};
-        uint8_t sp{}; // Stack pointer
-        uint8_t delayTimer{}; // Decrements at 60Hz
-        uint8_t soundTimer{}; // Decrements at 60Hz, buzzes when non-zero
-        uint8_t registers[16]{}; // v0-vF
-        size_t keys[16]{}; // Chip 8's input keys: 1 - 0xF 
-        Window window;
-        int SCALE;
-        bool CP_SHIFT;
-        bool SC_JUMP;
-        bool COSMAC_MEM;
-
-        /* Initializations and utility functions */
-        Chip8(int scale, bool cp_shift, bool sc_jump, bool cosmac_mem);
-        void loadRom(string ROM);
-        void loadFonts();
-        void updateTimers();
-        void cycle();
-
-        /* OP Codes */
-        void OP_00E0(); // CLS
-        void OP_00EE(); // RET
-        void OP_0nnn(uint16_t nnn); // SYS addr
-        void OP_1nnn(uint16_t nnn); // JP addr
-        void OP_2nnn(uint16_t nnn); // CALL addr
-        void OP_3xkk(uint8_t x, uint8_t kk); // SE Vx, byte
-        void OP_4xkk(uint8_t x, uint8_t kk); // SNE Vx, byte
-        void OP_5xy0(uint8_t x, uint8_t y); // SE Vx, Vy
-        void OP_6xkk(uint8_t x, uint8_t kk); // LD Vx, byte
-        void OP_7xkk(uint8_t x, uint8_t kk); // ADD Vx, byte
-        void OP_8xy0(uint8_t x, uint8_t y); // LD Vx, Vy
-        void OP_8xy1(uint8_t x, uint8_t y); // OR Vx, Vy
-        void OP_8xy2(uint8_t x, uint8_t y); // AND Vx, Vy
-        void OP_8xy3(uint8_t x, uint8_t y); // xOR Vx, Vy
-        void OP_8xy4(uint8_t x, uint8_t y); // ADD Vx, Vy
-        void OP_8xy5(uint8_t x, uint8_t y); // SUB Vx, Vy
-        void OP_8xy6(uint8_t x, uint8_t y); // SHR Vx {, Vy}
-        void OP_8xy7(uint8_t x, uint8_t y); // SUBN Vx, Vy
-        void OP_8xyE(uint8_t x, uint8_t y); // SHL Vx {, Vy}
-        void OP_9xy0(uint8_t x, uint8_t y); // SNE Vx, Vy
-        void OP_Annn(uint16_t nnn); // LD I, addr
-        void OP_Bnnn(uint16_t nnn); // JP V0, addr
-        void OP_Cxkk(uint8_t x, uint8_t kk); // RND Vx, byte
-        void OP_Dxyn(uint8_t x, uint8_t y, uint8_t n); // DRW Vx, Vy, nibble
-        void OP_Ex9E(uint8_t x); // SKP Vx
-        void OP_ExA1(uint8_t x); // SKNP Vx
-        void OP_Fx07(uint8_t x); // LD Vx, DT
-        void OP_Fx0A(uint8_t x); // LD Vx, K
-        void OP_Fx15(uint8_t x); // LD DT, Vx
-        void OP_Fx18(uint8_t x); // LD ST, Vx
-        void OP_Fx1E(uint8_t x); // ADD I, Vx
-        void OP_Fx29(uint8_t x); // LD F, Vx
-        void OP_Fx33(uint8_t x); // LD B, Vx
-        void OP_Fx55(uint8_t x); // LD [I], Vx
-        void OP_Fx65(uint8_t x); // LD Vx, [I]
-};
-
 /**
  * Constructor
  */
-Chip8::Chip8(int scale, bool cp_shift, bool sc_jump, bool cosmac_mem) : window(WIDTH, HEIGHT, 20) {
+template <typename Q>
+Chip8<Q>::Chip8() {
     pc = START_ADDRESS;
-    SCALE = scale;
-    CP_SHIFT = cp_shift;
-    SC_JUMP = sc_jump;
-    COSMAC_MEM = cosmac_mem;
 }
 
 
@@ -94,11 +22,13 @@ Chip8::Chip8(int scale, bool cp_shift, bool sc_jump, bool cosmac_mem) : window(W
 /**
  * Load the ROM into memory starting from address 0x200
  */
-void Chip8::loadRom(string ROM) {
+template <typename Q>
+bool Chip8<Q>::loadRom(string ROM) {
     ifstream buffer{ROM, ios::binary | ios::in};
 
     if (!buffer.is_open()) {
         cerr << "Unable to read file" << endl;
+        return false;
     }
 
     buffer.seekg(0, ios::end);
@@ -109,20 +39,39 @@ void Chip8::loadRom(string ROM) {
     char* romData = new char[size];
     buffer.read(romData, size);
 
-    for (size_t i = 0; i < size; i++) {
-        memory[i + START_ADDRESS] = static_cast<uint8_t>(romData[i]);
-    }
+    bool loaded = loadRom(reinterpret_cast<uint8_t const*>(romData), size);
 
     delete[] romData;
 
     buffer.close();
+    return loaded;
+}
+
+/**
+ * Load a ROM image that is already in memory starting from address 0x200
+ * 
+ * @param data - ROM bytes
+ * @param size - Number of bytes in data
+ */
+template <typename Q>
+bool Chip8<Q>::loadRom(uint8_t const* data, size_t size) {
+    if (size > sizeof(memory) - START_ADDRESS) {
+        cerr << "ROM is too large: " << size << " bytes" << endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        memory[i + START_ADDRESS] = data[i];
+    }
+    return true;
 }
 
 
 /**
  * Load the fonts into memory in address 0x50 - 0x9F
  */
-void Chip8::loadFonts() {
+template <typename Q>
+void Chip8<Q>::loadFonts() {
     uint8_t fonts[] = {
             0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
             0x20, 0x60, 0x20, 0x20, 0x70, // 1
@@ -148,20 +97,158 @@ void Chip8::loadFonts() {
 }
 
 /**
- * Decrement sound and delay timer by 1 if they are greater than 0    
+ * Decrement sound and delay timer by 1 if they are greater than 0
+ * 
+ * The front end plays the beep while soundTimer is non-zero
  */
-void Chip8::updateTimers() {
+template <typename Q>
+void Chip8<Q>::updateTimers() {
     if (soundTimer > 0) {
         soundTimer--;
-        window.startBeep();
-    }
-    else {
-        window.stopBeep();
     }
 
     if (delayTimer > 0) {
         delayTimer--;
     }
+
+    if (Trace::enabled(TRACE_FRAME)) {
+        Trace::frame(pc, delayTimer, soundTimer);
+    }
+}
+
+/**
+ * Run one 60Hz frame: execute a batch of instructions, then tick the timers
+ * 
+ * @param instructions - Number of instructions to execute this frame
+ */
+template <typename Q>
+void Chip8<Q>::runFrame(int instructions) {
+    if (Trace::enabled(TRACE_INSTRUCTION)) {
+        for (int i = 0; i < instructions; i++) {
+            tracedCycle();
+        }
+    }
+    else if (PerfCounters::sampling()) {
+        for (int i = 0; i < instructions; i++) {
+            profiledCycle();
+        }
+    }
+    else {
+        for (int i = 0; i < instructions; i++) {
+            cycle();
+        }
+    }
+    updateTimers();
+}
+
+/* COSMAC VIP timing */
+
+// Approximate cost of each OP code in VIP machine cycles (8 clocks of the
+// 1.76 MHz CDP1802), indexed by the first nibble. Groups whose cost depends
+// on the rest of the instruction are resolved in vipCost().
+static uint16_t const VIP_BASE_CYCLES[16] = {
+    24,  // 0: 00E0 / 00EE
+    23,  // 1nnn
+    23,  // 2nnn
+    12,  // 3xkk
+    12,  // 4xkk
+    16,  // 5xy0
+    6,   // 6xkk
+    10,  // 7xkk
+    44,  // 8xy*
+    16,  // 9xy0
+    12,  // Annn
+    23,  // Bnnn
+    36,  // Cxkk
+    26,  // Dxyn, plus VIP_DRAW_ROW_CYCLES per row
+    16,  // Ex9E / ExA1
+    10,  // Fx07 / Fx0A / Fx15 / Fx18
+};
+
+static uint16_t const VIP_DRAW_ROW_CYCLES = 15;
+static uint16_t const VIP_REGISTER_CYCLES = 14; // Per register moved by Fx55 / Fx65
+
+/**
+ * Cost of an instruction in VIP machine cycles
+ */
+uint16_t vipCost(uint16_t instruction) {
+    uint8_t n1 = instruction >> 12;
+    if (n1 == 0xD) {
+        return VIP_BASE_CYCLES[0xD] + VIP_DRAW_ROW_CYCLES * (instruction & 0xF);
+    }
+    if (n1 == 0xF) {
+        switch (instruction & 0xFF) {
+            case 0x1E: return 19;
+            case 0x29: return 20;
+            case 0x33: return 204;
+            case 0x55:
+            case 0x65: return 14 + VIP_REGISTER_CYCLES * (((instruction >> 8) & 0xF) + 1);
+        }
+    }
+    return VIP_BASE_CYCLES[n1];
+}
+
+/**
+ * Run one 60Hz frame on the COSMAC VIP clock
+ * 
+ * Each instruction is charged its VIP machine-cycle cost against the cycles
+ * left between display interrupts; overshoot is carried into the next frame.
+ * OP_Dxyn waits for the next vertical blank, so it ends the frame and its own
+ * cost is charged to the frame after. The timers tick at the interrupt, on the
+ * same clock. Everything below Dxyn costs a single table lookup.
+ * 
+ * @return Number of instructions executed this frame
+ */
+template <typename Q>
+int Chip8<Q>::runFrameVip() {
+    if (Trace::enabled(TRACE_INSTRUCTION)) {
+        return runFrameVip<&Chip8::tracedCycle>();
+    }
+    if (PerfCounters::sampling()) {
+        return runFrameVip<&Chip8::profiledCycle>();
+    }
+    return runFrameVip<&Chip8::cycle>();
+}
+
+/**
+ * runFrameVip() with the instruction step chosen at compile time, so the
+ * plain loop has no per-instruction check
+ */
+template <typename Q>
+template <uint16_t (Chip8<Q>::*Step)()>
+int Chip8<Q>::runFrameVip() {
+    int executed = 0;
+    vipCycles += VIP_CYCLES_PER_FRAME - VIP_INTERRUPT_CYCLES;
+    while (vipCycles > 0) {
+        uint16_t instruction = (this->*Step)();
+        executed++;
+        uint8_t n1 = instruction >> 12;
+        if (n1 < 0xD) {
+            vipCycles -= VIP_BASE_CYCLES[n1];
+            continue;
+        }
+        if (n1 == 0xD) {
+            vipCycles = -int32_t(vipCost(instruction));
+            break;
+        }
+        vipCycles -= vipCost(instruction);
+    }
+    updateTimers();
+    return executed;
+}
+
+/**
+ * FNV-1a hash of the display, used to compare frames between cores
+ */
+template <typename Q>
+uint64_t Chip8<Q>::frameHash() const {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (uint64_t row : display) {
+        for (int x = WIDTH - 1; x >= 0; x--) {
+            hash = (hash ^ ((row >> x) & 0x1)) * 0x100000001B3ull;
+        }
+    }
+    return hash;
 }
 
 
@@ -170,18 +257,20 @@ void Chip8::updateTimers() {
 /**
  * Clear Screen
  */
-void Chip8::OP_00E0() {
-    memset(display, 0, WIDTH * HEIGHT * sizeof(uint32_t));
-    window.update(display);
+template <typename Q>
+void Chip8<Q>::OP_00E0() {
+    memset(display, 0, sizeof(display));
+    drawFlag = true;
 }
 
 /**
  * Return - Return from a subroutine
  */
-void Chip8::OP_00EE() {
+template <typename Q>
+void Chip8<Q>::OP_00EE() {
     sp--;
-    pc = stack[sp];
-    stack[sp] = 0;
+    pc = stack[sp & 0xF]; // The stack wraps instead of running off the array
+    stack[sp & 0xF] = 0;
 }
 
 /**
@@ -189,7 +278,8 @@ void Chip8::OP_00EE() {
  * 
  * NOTE: THIS FUNCTION IS NOT IMPLEMENTED IN MODERN INTERPRETERS
  */
-void Chip8::OP_0nnn(uint16_t nnn) {
+template <typename Q>
+void Chip8<Q>::OP_0nnn(uint16_t nnn) {
     // Do nothing
 }
 
@@ -198,7 +288,8 @@ void Chip8::OP_0nnn(uint16_t nnn) {
  * 
  * @param nnn - Set PC to nnn
  */
-void Chip8::OP_1nnn(uint16_t nnn) {
+template <typename Q>
+void Chip8<Q>::OP_1nnn(uint16_t nnn) {
     pc = nnn;
 }
 
@@ -207,8 +298,9 @@ void Chip8::OP_1nnn(uint16_t nnn) {
  * 
  * @param nnn - Address to jump to
  */
-void Chip8::OP_2nnn(uint16_t nnn) {
-    stack[sp] = pc;
+template <typename Q>
+void Chip8<Q>::OP_2nnn(uint16_t nnn) {
+    stack[sp & 0xF] = pc; // The stack wraps instead of running off the array
     sp++;
     pc = nnn;
 }
@@ -219,7 +311,8 @@ void Chip8::OP_2nnn(uint16_t nnn) {
  * @param x - Register Vx
  * @param kk - Value to compare Vx to
  */
-void Chip8::OP_3xkk(uint8_t x, uint8_t kk) {
+template <typename Q>
+void Chip8<Q>::OP_3xkk(uint8_t x, uint8_t kk) {
     if (registers[x] == kk) {
         pc += 2;
     }
@@ -231,7 +324,8 @@ void Chip8::OP_3xkk(uint8_t x, uint8_t kk) {
  * @param x - Register Vx
  * @param kk - Value to compare Vx to
  */
-void Chip8::OP_4xkk(uint8_t x, uint8_t kk) {
+template <typename Q>
+void Chip8<Q>::OP_4xkk(uint8_t x, uint8_t kk) {
     if (registers[x] != kk) {
         pc += 2;
     }
@@ -243,7 +337,8 @@ void Chip8::OP_4xkk(uint8_t x, uint8_t kk) {
  * @param x - Register Vx
  * @param y - Register Vy
  */
-void Chip8::OP_5xy0(uint8_t x, uint8_t y) {
+template <typename Q>
+void Chip8<Q>::OP_5xy0(uint8_t x, uint8_t y) {
     if (registers[x] == registers[y]) {
         pc += 2;
     }
@@ -255,7 +350,8 @@ void Chip8::OP_5xy0(uint8_t x, uint8_t y) {
  * @param x - Vx register to be set
  * @param kk - value to put in Vx
  */
-void Chip8::OP_6xkk(uint8_t x, uint8_t kk) {
+template <typename Q>
+void Chip8<Q>::OP_6xkk(uint8_t x, uint8_t kk) {
     registers[x] = kk;
 }
 
@@ -265,7 +361,8 @@ void Chip8::OP_6xkk(uint8_t x, uint8_t kk) {
  * @param x - Register Vx
  * @param kk - Value to be added to Vx
  */
-void Chip8::OP_7xkk(uint8_t x, uint8_t kk) {
+template <typename Q>
+void Chip8<Q>::OP_7xkk(uint8_t x, uint8_t kk) {
     registers[x] += kk;
 }
 
@@ -275,7 +372,8 @@ void Chip8::OP_7xkk(uint8_t x, uint8_t kk) {
  * @param x - Register Vx
  * @param y - Register Vy
  */
-void Chip8::OP_8xy0(uint8_t x, uint8_t y) {
+template <typename Q>
+void Chip8<Q>::OP_8xy0(uint8_t x, uint8_t y) {
     registers[x] = registers[y];
 }
 
@@ -285,7 +383,8 @@ void Chip8::OP_8xy0(uint8_t x, uint8_t y) {
  * @param x - Register Vx
  * @param y - Register Vy
  */
-void Chip8::OP_8xy1(uint8_t x, uint8_t y) {
+template <typename Q>
+void Chip8<Q>::OP_8xy1(uint8_t x, uint8_t y) {
     registers[x] |= registers[y];
 }
 
@@ -295,7 +394,8 @@ void Chip8::OP_8xy1(uint8_t x, uint8_t y) {
  * @param x - Register Vx
  * @param y - Register Vy
  */
-void Chip8::OP_8xy2(uint8_t x, uint8_t y) {
+template <typename Q>
+void Chip8<Q>::OP_8xy2(uint8_t x, uint8_t y) {
     registers[x] &= registers[y];
 }
 
@@ -305,7 +405,8 @@ void Chip8::OP_8xy2(uint8_t x, uint8_t y) {
  * @param x - Register Vx
  * @param y - Register Vy
  */
-void Chip8::OP_8xy3(uint8_t x, uint8_t y) {
+template <typename Q>
+void Chip8<Q>::OP_8xy3(uint8_t x, uint8_t y) {
     registers[x] ^= registers[y];
 }
 
@@ -315,7 +416,8 @@ void Chip8::OP_8xy3(uint8_t x, uint8_t y) {
  * @param x - Register Vx
  * @param y - Register Vy
  */
-void Chip8::OP_8xy4(uint8_t x, uint8_t y) {
+template <typename Q>
+void Chip8<Q>::OP_8xy4(uint8_t x, uint8_t y) {
     registers[x] += registers[y];
     if (registers[x] < registers[y]) {
         registers[0xF] = 1;
@@ -331,7 +433,8 @@ void Chip8::OP_8xy4(uint8_t x, uint8_t y) {
  * @param x - Register Vx
  * @param y - Register Vy
  */
-void Chip8::OP_8xy5(uint8_t x, uint8_t y) {
+template <typename Q>
+void Chip8<Q>::OP_8xy5(uint8_t x, uint8_t y) {
     if (registers[x] > registers[y]) {
         registers[0xF] = 1;
     }
@@ -346,10 +449,11 @@ void Chip8::OP_8xy5(uint8_t x, uint8_t y) {
  * 
  * @param x - Register Vx
  * @param y - Register Vy
- * @property CP_SHIFT - If true, set Vx to Vy
+ * @property Q::CP_SHIFT - If true, set Vx to Vy
  */
-void Chip8::OP_8xy6(uint8_t x, uint8_t y) {
-    if (CP_SHIFT) {
+template <typename Q>
+void Chip8<Q>::OP_8xy6(uint8_t x, uint8_t y) {
+    if (Q::CP_SHIFT) {
         registers[x] = registers[y];
     }
     registers[0xF] = registers[x] & 0x1;
@@ -362,7 +466,8 @@ void Chip8::OP_8xy6(uint8_t x, uint8_t y) {
  * @param x - Register Vx
  * @param y - Register Vy
  */
-void Chip8::OP_8xy7(uint8_t x, uint8_t y) {
+template <typename Q>
+void Chip8<Q>::OP_8xy7(uint8_t x, uint8_t y) {
     if (registers[y] > registers[x]) {
         registers[0xF] = 1;
     }
@@ -377,10 +482,11 @@ void Chip8::OP_8xy7(uint8_t x, uint8_t y) {
  * 
  * @param x - Register Vx
  * @param y - Register Vy
- * @property CP_SHIFT - If true, set Vx to Vy
+ * @property Q::CP_SHIFT - If true, set Vx to Vy
  */
-void Chip8::OP_8xyE(uint8_t x, uint8_t y) {
-    if (CP_SHIFT) {
+template <typename Q>
+void Chip8<Q>::OP_8xyE(uint8_t x, uint8_t y) {
+    if (Q::CP_SHIFT) {
         registers[x] = registers[y];
     }
     registers[x] & 0x80 ? registers[0xF] = 1 : registers[0xF] = 0;
@@ -393,7 +499,8 @@ void Chip8::OP_8xyE(uint8_t x, uint8_t y) {
  * @param x - Register Vx
  * @param y - Register Vy
  */
-void Chip8::OP_9xy0(uint8_t x, uint8_t y) {
+template <typename Q>
+void Chip8<Q>::OP_9xy0(uint8_t x, uint8_t y) {
     if (registers[x] != registers[y]) {
         pc += 2;
     }
@@ -404,7 +511,8 @@ void Chip8::OP_9xy0(uint8_t x, uint8_t y) {
  * 
  * @param nnn - sets the index register I to the value nnn
  */
-void Chip8::OP_Annn(uint16_t nnn) {
+template <typename Q>
+void Chip8<Q>::OP_Annn(uint16_t nnn) {
     I = nnn;
 }
 
@@ -412,10 +520,11 @@ void Chip8::OP_Annn(uint16_t nnn) {
  * Jump With Offset - Jump to location nnn + V0
  * 
  * @param nnn or xnn - Jump to location nnn + V0 or nnn + Vx
- * @property SC_JUMP - If true, jump to nnn + Vx, otherwise jump to nnn + V0
+ * @property Q::SC_JUMP - If true, jump to nnn + Vx, otherwise jump to nnn + V0
  */
-void Chip8::OP_Bnnn(uint16_t nnn) {
-    if (SC_JUMP) {
+template <typename Q>
+void Chip8<Q>::OP_Bnnn(uint16_t nnn) {
+    if (Q::SC_JUMP) {
         uint8_t x = (nnn & 0x0F00) >> 8;
         pc = nnn + registers[x];
     }
@@ -425,13 +534,18 @@ void Chip8::OP_Bnnn(uint16_t nnn) {
 }
 
 /**
- * RSet Vx to a random number AND kk
+ * Set Vx to a random number AND kk
  * 
  * @param x - Register Vx
  * @param kk - Value to AND with
  */
-void Chip8::OP_Cxkk(uint8_t x, uint8_t kk) {
-    uint8_t random = rand() % 256;
+template <typename Q>
+void Chip8<Q>::OP_Cxkk(uint8_t x, uint8_t kk) {
+    // xorshift32: each core owns its generator so runs are reproducible
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    uint8_t random = rngState & 0xFF;
     registers[x] = random & kk;
 }
 
@@ -446,38 +560,32 @@ void Chip8::OP_Cxkk(uint8_t x, uint8_t kk) {
  * @param y - Value of Vy is the y coordinate to start drawing from
  * @param n - Height of sprite in pixels
  */
-void Chip8::OP_Dxyn(uint8_t x, uint8_t y, uint8_t n) {  
+template <typename Q>
+void Chip8<Q>::OP_Dxyn(uint8_t x, uint8_t y, uint8_t n) {  
     uint8_t x_coord = registers[x] % WIDTH;
     uint8_t y_coord = registers[y] % HEIGHT;
+    uint8_t top = y_coord;
     registers[0xF] = 0;
 
-    cout << "Start of Dxyn - Drawing  n: " << int(n) << endl;  
     for (size_t i = 0; i < n; i++) {
-        uint8_t spriteData = memory[I+i];
-        for (size_t j = 0; j < 8; j++) {
-            uint8_t pixel = (spriteData >> (8 - j - 1)) & 0x1 ;
-            if (pixel) {
-                if (display[y_coord*WIDTH + x_coord + j]) {
-                    registers[0xF] = 1;
-                }
-                display[y_coord*WIDTH + x_coord + j] ^= 0xFFFFFFFF;
-                cout << "Just drew a pixel at (" << int(x_coord + j)<<", " << int(y_coord) << ")" << endl;
-            }
-            if (x_coord + j + 1 >= WIDTH) break;
-
-            //x++;
-            //cout << "X: " << int(x) << " Y: " << int(y) << " I: " << I << " N: " << int(n) << " Sprite: " << int(spriteData) << " Pixel: " << int(pixel) << " Display: " << display[y_coord*WIDTH + x_coord] << endl;
+        // Bits past the right edge shift out of the row
+        uint64_t sprite = uint64_t(memory[(I + i) & 0xFFF]) << 56 >> x_coord;
+        if (display[y_coord] & sprite) {
+            registers[0xF] = 1;
         }
-        cout << "Moving on to the next row: " << int(y_coord) << endl;
+        display[y_coord] ^= sprite;
         y_coord++;
 
         if (y_coord + 1 >= HEIGHT) {
-            cout << "EDGE OF (y) SCREEN - BREAKING \n\n\n" << endl;
             break;
         }
     }
-    cout << "End of Dxyn - Drawing " << display << endl;
-    window.update(display);
+
+    if (Trace::enabled(TRACE_DRAW)) {
+        uint16_t opcode = 0xD000 | (x << 8) | (y << 4) | n;
+        Trace::draw(pc - 2, opcode, x_coord, top, n, registers[0xF]);
+    }
+    drawFlag = true;
 }
 
 /**
@@ -485,8 +593,9 @@ void Chip8::OP_Dxyn(uint8_t x, uint8_t y, uint8_t n) {
  * 
  * @param x - Register Vx
  */
-void Chip8::OP_Ex9E(uint8_t x) {
-    if (keys[registers[x]]) {
+template <typename Q>
+void Chip8<Q>::OP_Ex9E(uint8_t x) {
+    if (registers[x] < 16 && key(registers[x])) {
         pc += 2;
     }
 }
@@ -496,8 +605,9 @@ void Chip8::OP_Ex9E(uint8_t x) {
  * 
  * @param x - Register Vx
  */
-void Chip8::OP_ExA1(uint8_t x) {
-    if (!keys[registers[x]]) {
+template <typename Q>
+void Chip8<Q>::OP_ExA1(uint8_t x) {
+    if (registers[x] >= 16 || !key(registers[x])) {
         pc += 2;
     }
 }
@@ -507,7 +617,8 @@ void Chip8::OP_ExA1(uint8_t x) {
  * 
  * @param x - Register Vx
  */
-void Chip8::OP_Fx07(uint8_t x) {
+template <typename Q>
+void Chip8<Q>::OP_Fx07(uint8_t x) {
     registers[x] = delayTimer;
 }
 
@@ -516,17 +627,15 @@ void Chip8::OP_Fx07(uint8_t x) {
  * 
  * @param x - Register Vx
  */
-void Chip8::OP_Fx0A(uint8_t x) {
-    bool pressed = false;
-    for (size_t i : keys) {
-        if (keys[i]) {
-            pressed = true;
-            registers[x] = i;
+template <typename Q>
+void Chip8<Q>::OP_Fx0A(uint8_t x) {
+    for (int k = 0; k < 16; k++) {
+        if (key(k)) {
+            registers[x] = k;
+            return;
         }
     }
-    if (!pressed) {
-        pc--;
-    }
+    pc -= 2; // Execute Fx0A again until a key is down
 }
 
 /**
@@ -534,7 +643,8 @@ void Chip8::OP_Fx0A(uint8_t x) {
  * 
  * @param x - Register Vx
  */
-void Chip8::OP_Fx15(uint8_t x) {
+template <typename Q>
+void Chip8<Q>::OP_Fx15(uint8_t x) {
     delayTimer = registers[x];
 }
 
@@ -543,7 +653,8 @@ void Chip8::OP_Fx15(uint8_t x) {
  * 
  * @param x - Register Vx
  */
-void Chip8::OP_Fx18(uint8_t x) {
+template <typename Q>
+void Chip8<Q>::OP_Fx18(uint8_t x) {
     soundTimer = registers[x];
 }
 
@@ -552,7 +663,8 @@ void Chip8::OP_Fx18(uint8_t x) {
  * 
  * @param x - Register Vx
  */
-void Chip8::OP_Fx1E(uint8_t x) {
+template <typename Q>
+void Chip8<Q>::OP_Fx1E(uint8_t x) {
     I += registers[x];
 }
 
@@ -561,7 +673,8 @@ void Chip8::OP_Fx1E(uint8_t x) {
  * 
  * @param x - Register Vx
  */
-void Chip8::OP_Fx29(uint8_t x) {
+template <typename Q>
+void Chip8<Q>::OP_Fx29(uint8_t x) {
     int character = registers[x];
     I = FONT_ADDRESS + (character * 5);
 }
@@ -571,28 +684,30 @@ void Chip8::OP_Fx29(uint8_t x) {
  * 
  * @param x - Register Vx
  */
-void Chip8::OP_Fx33(uint8_t x) {
-    memory[I] = registers[x] / 100;
-    memory[I+1] = (registers[x] / 10) % 10;
-    memory[I+2] = registers[x] % 10;
+template <typename Q>
+void Chip8<Q>::OP_Fx33(uint8_t x) {
+    memory[I & 0xFFF] = registers[x] / 100;
+    memory[(I + 1) & 0xFFF] = (registers[x] / 10) % 10;
+    memory[(I + 2) & 0xFFF] = registers[x] % 10;
 }
 
 /**
  * Store registers V0 through Vx in memory starting at I
  * 
  * @param x - Register Vx
- * @property COSMAC_MEM - If true, increment I for each register stored
+ * @property Q::COSMAC_MEM - If true, increment I for each register stored
  */
-void Chip8::OP_Fx55(uint8_t x) {
-    if (COSMAC_MEM){
+template <typename Q>
+void Chip8<Q>::OP_Fx55(uint8_t x) {
+    if (Q::COSMAC_MEM){
         for (int i = 0; i <= x; i++) {
-            memory[I] = registers[i];
+            memory[I & 0xFFF] = registers[i];
             I++;
         }
     }
     else{
         for (int i = 0; i <= x; i++) {
-            memory[I+i] = registers[i];
+            memory[(I + i) & 0xFFF] = registers[i];
         }
     }
     
@@ -602,18 +717,19 @@ void Chip8::OP_Fx55(uint8_t x) {
  * Load registers V0 through Vx from memory starting at I
  * 
  * @param x - Register Vx
- * @property COSMAC_MEM - If true, increment I for each register loaded
+ * @property Q::COSMAC_MEM - If true, increment I for each register loaded
  */
-void Chip8::OP_Fx65(uint8_t x) {
-    if (COSMAC_MEM){
+template <typename Q>
+void Chip8<Q>::OP_Fx65(uint8_t x) {
+    if (Q::COSMAC_MEM){
         for (int i = 0; i <= x; i++) {
-            registers[i] = memory[I];
+            registers[i] = memory[I & 0xFFF];
             I++;
         }
     }
     else{
         for (int i = 0; i <= x; i++) {
-            registers[i] = memory[I+i];
+            registers[i] = memory[(I + i) & 0xFFF];
         }
     }
 }
@@ -621,10 +737,14 @@ void Chip8::OP_Fx65(uint8_t x) {
 
 /**
  * Main fetch-decode-execute cycle
+ * 
+ * @return The instruction that was executed
  */
-void Chip8::cycle() {
+template <typename Q>
+uint16_t Chip8<Q>::cycle() {
     // Fetch
-    uint16_t instruction = (memory[pc] << 8) |  memory[pc+1];
+    // Addresses wrap at the end of memory, as on the VIP's 4KB address space
+    uint16_t instruction = (memory[pc & 0xFFF] << 8) | memory[(pc + 1) & 0xFFF];
 
     pc += 2;
 
@@ -652,6 +772,10 @@ void Chip8::cycle() {
                 case 0xEE:
                     OP_00EE();
                     break;
+
+                default:
+                    invalidOpcodes++;
+                    break;
             }
             break;
 
@@ -719,7 +843,11 @@ void Chip8::cycle() {
                 
                 case 0xE:
                     OP_8xyE(x, y);
-                    break;    
+                    break;
+
+                default:
+                    invalidOpcodes++;
+                    break;
             }
             break;
 
@@ -752,6 +880,10 @@ void Chip8::cycle() {
                 case 0xA1:
                     OP_ExA1(x);
                     break;
+
+                default:
+                    invalidOpcodes++;
+                    break;
             }
             break;
 
@@ -792,56 +924,59 @@ void Chip8::cycle() {
                 case 0x65:
                     OP_Fx65(x);
                     break;
+
+                default:
+                    invalidOpcodes++;
+                    break;
             }
             break;
     }
+    return instruction;
 }
 
-int main(int argc, char* argv[]) {
-    cout << "Starting..." << endl;
-
-    bool cp_shift = false;   // Set true for alternate implementation of OP_8xy6 and OP_8xyE
-    bool sc_jump = false;    // Set true for alternate implementation of OP_Bnnn
-    bool cosmac_mem = false; // Set true for alternate implementation of OP_Fx55 and OP_Fx65
-    int scale = 20;          // Scaling for window size
-    int speed = 700;         // Speed of the emulator
-    string rom = argv[1];
-    
-    for (int i = 0; i < argc; i++) {
-        string arg = argv[i];
-
-        if (arg == "--cp_shift") {
-            cp_shift = true;
-        }
-
-        if (arg == "--sc_jump") {
-            sc_jump = true;
-        }
-
-        if (arg == "cosmac_mem") {
-            cosmac_mem = true;
-        }
-
-        if (arg == "--scale" && i + 1 < argc) {
-            scale = int(atoi(argv[++i]) - '0');
-        }
+/**
+ * Execute one instruction and trace the registers it changed
+ *
+ * The frame loops pick this or cycle() once per frame, so cycle() itself
+ * carries no trace check.
+ *
+ * @return The instruction that was executed
+ */
+template <typename Q>
+uint16_t Chip8<Q>::tracedCycle() {
+    uint16_t address = pc;
+    uint8_t before[16];
+    memcpy(before, registers, sizeof(registers));
+    uint16_t instruction = cycle();
+    Trace::instruction(address, instruction, before, registers, I);
+    return instruction;
+}
 
-        if (arg == "--speed" && i + 1 < argc) {
-            speed = int(atoi(argv[++i]) - '0');
-        }
-    }
+/**
+ * Execute one instruction and charge the host events it took to its class
+ *
+ * Only run in the frames PerfCounters samples, like tracedCycle().
+ *
+ * @return The instruction that was executed
+ */
+template <typename Q>
+uint16_t Chip8<Q>::profiledCycle() {
+    uint64_t before[PERF_EVENTS];
+    PerfCounters::read(before);
+    uint16_t instruction = cycle();
+    PerfCounters::instruction(instruction, before);
+    return instruction;
+}
 
-    Chip8 chip8 = Chip8(scale, cp_shift, sc_jump, cosmac_mem);
-    chip8.loadRom(rom);
-    chip8.loadFonts();
 
-    bool quit = false;
-    while (!quit) {
-        quit = chip8.window.processInput(chip8.keys);
-        chip8.cycle();
-        chip8.updateTimers();
-        sleep(1/speed);
-    }
+/* Instantiations */
 
-    return 0;
-}
\ No newline at end of file
+template class Chip8<Quirks<false, false, false>>;
+template class Chip8<Quirks<false, false, true>>;
+template class Chip8<Quirks<false, true, false>>;
+template class Chip8<Quirks<false, true, true>>;
+template class Chip8<Quirks<true, false, false>>;
+template class Chip8<Quirks<true, false, true>>;
+template class Chip8<Quirks<true, true, false>>;
+template class Chip8<Quirks<true, true, true>>;
+template class Chip8<RuntimeQuirks>;
@@ -0,0 +1,160 @@
+#ifndef CHIP8_H
+#define CHIP8_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Compile-time quirk profile
+ *
+ * Each flag is a constant, so the quirk branches in the OP codes are folded
+ * away when the core is instantiated with a Quirks profile.
+ *
+ * @param CpShift - Alternate OP_8xy6 and OP_8xyE (Vx is set to Vy before shifting)
+ * @param ScJump - Alternate OP_Bnnn (jump to xnn + Vx instead of nnn + V0)
+ * @param CosmacMem - Alternate OP_Fx55 and OP_Fx65 (I is incremented per register)
+ */
+template <bool CpShift, bool ScJump, bool CosmacMem>
+struct Quirks {
+    static constexpr bool CP_SHIFT = CpShift;
+    static constexpr bool SC_JUMP = ScJump;
+    static constexpr bool COSMAC_MEM = CosmacMem;
+};
+
+/**
+ * Quirk profile read at runtime
+ *
+ * Keeps the original branch-per-execution behaviour. Only used as the
+ * baseline the benchmark compares the Quirks instantiations against.
+ */
+struct RuntimeQuirks {
+    static inline bool CP_SHIFT = false;
+    static inline bool SC_JUMP = false;
+    static inline bool COSMAC_MEM = false;
+};
+
+/**
+ * The CHIP-8 core
+ *
+ * The core is headless: it only marks drawFlag when the display changes and
+ * leaves presenting the display, playing the beep and reading the keypad to
+ * the front end.
+ *
+ * The object is only the machine state, about 4.4KB with the display packed
+ * one bit per pixel and the keypad as a bit mask, so tens of thousands of
+ * instances stay cheap to step and to snapshot by copy. The registers come
+ * first so a frame that does not touch memory stays within a few cache lines.
+ *
+ * @param Q - Quirk profile, either Quirks<...> or RuntimeQuirks
+ */
+template <typename Q>
+class alignas(64) Chip8 {
+    public:
+        /* Constants */
+        static int const WIDTH = 64; // Display's x dimension
+        static int const HEIGHT = 32; // Display's y dimension
+        static constexpr int START_ADDRESS = 0x200; // Load ROM from this address onwards (512 in base 10)
+        static constexpr int FONT_ADDRESS = 0x50; // Load Fonts at this address
+        static int const VIP_CYCLES_PER_FRAME = 3668; // COSMAC VIP machine cycles per 60Hz frame
+        static int const VIP_INTERRUPT_CYCLES = 1230; // Spent per frame in the display interrupt and DMA
+
+        /* Instance variables */
+        uint8_t registers[16]{}; // v0-vF
+        uint16_t stack[16]{};
+        uint16_t pc{};
+        uint16_t I{};
+        uint8_t sp{}; // Stack pointer
+        uint8_t delayTimer{}; // Decrements at 60Hz
+        uint8_t soundTimer{}; // Decrements at 60Hz, buzzes when non-zero
+        bool drawFlag{}; // Set when the display changed, cleared by the front end
+        uint16_t keys{}; // Chip 8's input keys 0 - 0xF, bit k set while key k is down
+        uint32_t rngState = 0x2545F491; // OP_Cxkk's random number generator state
+        int32_t vipCycles{}; // Machine cycles left in the current frame in VIP timing mode
+        uint32_t invalidOpcodes{}; // OP codes the core does not implement, executed as no-ops
+        uint64_t display[HEIGHT]{}; // Monochrome display, one row per word, leftmost pixel in the top bit
+        uint8_t memory[4096]{};
+
+        /* Initializations and utility functions */
+        Chip8();
+        bool loadRom(std::string ROM);
+        bool loadRom(uint8_t const* data, size_t size);
+        void loadFonts();
+        void updateTimers();
+        void runFrame(int instructions);
+        int runFrameVip();
+        template <uint16_t (Chip8::*Step)()> int runFrameVip();
+        uint16_t cycle();
+        uint16_t tracedCycle();
+        uint16_t profiledCycle();
+        uint64_t frameHash() const;
+
+        bool pixel(int x, int y) const { return (display[y] >> (WIDTH - 1 - x)) & 1; }
+        bool key(int k) const { return (keys >> k) & 1; }
+        void setKey(int k, bool pressed) { keys = pressed ? keys | (1 << k) : keys & ~(1 << k); }
+
+        /* OP Codes */
+        void OP_00E0(); // CLS
+        void OP_00EE(); // RET
+        void OP_0nnn(uint16_t nnn); // SYS addr
+        void OP_1nnn(uint16_t nnn); // JP addr
+        void OP_2nnn(uint16_t nnn); // CALL addr
+        void OP_3xkk(uint8_t x, uint8_t kk); // SE Vx, byte
+        void OP_4xkk(uint8_t x, uint8_t kk); // SNE Vx, byte
+        void OP_5xy0(uint8_t x, uint8_t y); // SE Vx, Vy
+        void OP_6xkk(uint8_t x, uint8_t kk); // LD Vx, byte
+        void OP_7xkk(uint8_t x, uint8_t kk); // ADD Vx, byte
+        void OP_8xy0(uint8_t x, uint8_t y); // LD Vx, Vy
+        void OP_8xy1(uint8_t x, uint8_t y); // OR Vx, Vy
+        void OP_8xy2(uint8_t x, uint8_t y); // AND Vx, Vy
+        void OP_8xy3(uint8_t x, uint8_t y); // xOR Vx, Vy
+        void OP_8xy4(uint8_t x, uint8_t y); // ADD Vx, Vy
+        void OP_8xy5(uint8_t x, uint8_t y); // SUB Vx, Vy
+        void OP_8xy6(uint8_t x, uint8_t y); // SHR Vx {, Vy}
+        void OP_8xy7(uint8_t x, uint8_t y); // SUBN Vx, Vy
+        void OP_8xyE(uint8_t x, uint8_t y); // SHL Vx {, Vy}
+        void OP_9xy0(uint8_t x, uint8_t y); // SNE Vx, Vy
+        void OP_Annn(uint16_t nnn); // LD I, addr
+        void OP_Bnnn(uint16_t nnn); // JP V0, addr
+        void OP_Cxkk(uint8_t x, uint8_t kk); // RND Vx, byte
+        void OP_Dxyn(uint8_t x, uint8_t y, uint8_t n); // DRW Vx, Vy, nibble
+        void OP_Ex9E(uint8_t x); // SKP Vx
+        void OP_ExA1(uint8_t x); // SKNP Vx
+        void OP_Fx07(uint8_t x); // LD Vx, DT
+        void OP_Fx0A(uint8_t x); // LD Vx, K
+        void OP_Fx15(uint8_t x); // LD DT, Vx
+        void OP_Fx18(uint8_t x); // LD ST, Vx
+        void OP_Fx1E(uint8_t x); // ADD I, Vx
+        void OP_Fx29(uint8_t x); // LD F, Vx
+        void OP_Fx33(uint8_t x); // LD B, Vx
+        void OP_Fx55(uint8_t x); // LD [I], Vx
+        void OP_Fx65(uint8_t x); // LD Vx, [I]
+};
+
+/**
+ * Cost of an instruction in COSMAC VIP machine cycles, as runFrameVip() charges it
+ */
+uint16_t vipCost(uint16_t instruction);
+
+/**
+ * Call f with the Quirks instantiation matching the runtime flags
+ *
+ * Used once at startup so the execution loop runs on a fully specialized
+ * core. f is called with a default-constructed Quirks<...> tag, e.g.
+ * [&](auto quirks) { Chip8<decltype(quirks)> chip8; ... }
+ */
+template <typename F>
+decltype(auto) withQuirks(bool cpShift, bool scJump, bool cosmacMem, F&& f) {
+    switch ((cpShift << 2) | (scJump << 1) | int(cosmacMem)) {
+        case 0: return f(Quirks<false, false, false>{});
+        case 1: return f(Quirks<false, false, true>{});
+        case 2: return f(Quirks<false, true, false>{});
+        case 3: return f(Quirks<false, true, true>{});
+        case 4: return f(Quirks<true, false, false>{});
+        case 5: return f(Quirks<true, false, true>{});
+        case 6: return f(Quirks<true, true, false>{});
+        default: return f(Quirks<true, true, true>{});
+    }
+}
+
+#endif
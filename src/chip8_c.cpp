@@ -0,0 +1,336 @@
+#define CHIP8_BUILDING
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "chip8.h"
+#include "chip8_c.h"
+using namespace std;
+
+/**
+ * The instance behind a chip8_core handle
+ *
+ * The quirk profile is a template parameter of the core, so each profile has
+ * its own Instance<Q>; the handle reaches it through the few virtual calls
+ * below. The display, keys and draw flag are reached through pointers set at
+ * creation, so reading the framebuffer and setting keys need no dispatch.
+ * The audio buffer follows the instance in the same allocation.
+ */
+struct chip8_core {
+    chip8_config config;
+    chip8_allocator allocator;
+    size_t allocationSize;
+    uint64_t frame = 0; // Frames run since the ROM was loaded, to spread the speed over frames
+    uint32_t audioPhase = 0; // Sample within the square wave's period
+    bool audioSilent = true; // The audio buffer holds silence
+    int16_t* audio = nullptr;
+    size_t audioSamples = 0; // In the last frame
+    uint64_t* display;
+    uint16_t* keys;
+    bool* drawFlag;
+
+    virtual ~chip8_core() = default;
+    virtual void reset() = 0;
+    virtual bool load(uint8_t const* rom, size_t size) = 0;
+    virtual int run(int instructions) = 0;
+    virtual uint8_t soundTimer() const = 0;
+    virtual void save(uint8_t* state) const = 0;
+    virtual void restore(uint8_t const* state) = 0;
+};
+
+/* Serialized state: the header, then the fields at these offsets, little-endian */
+static uint32_t const STATE_MAGIC = 0x54533843; // "C8ST"
+enum StateOffset {
+    STATE_VERSION = 4, // uint16
+    STATE_QUIRKS = 6, // uint16, the quirk bits of chip8_flags
+    STATE_REGISTERS = 8, // 16 bytes
+    STATE_STACK = 24, // 16 uint16
+    STATE_PC = 56, // uint16
+    STATE_I = 58, // uint16
+    STATE_SP = 60,
+    STATE_DELAY_TIMER = 61,
+    STATE_SOUND_TIMER = 62,
+    STATE_DRAW_FLAG = 63,
+    STATE_KEYS = 64, // uint16, then 2 reserved bytes
+    STATE_RNG = 68, // uint32
+    STATE_VIP_CYCLES = 72, // int32
+    STATE_INVALID_OPCODES = 76, // uint32
+    STATE_FRAME = 80, // uint64
+    STATE_AUDIO_PHASE = 88, // uint32, then 4 reserved bytes
+    STATE_DISPLAY = 96, // 32 uint64
+    STATE_MEMORY = 352, // 4096 bytes
+};
+static_assert(STATE_MEMORY + 4096 == CHIP8_STATE_SIZE, "CHIP8_STATE_SIZE does not match the layout");
+
+static void put(uint8_t* state, size_t offset, uint64_t value, int bytes) {
+    for (int b = 0; b < bytes; b++) {
+        state[offset + b] = uint8_t(value >> (8 * b));
+    }
+}
+
+static uint64_t get(uint8_t const* state, size_t offset, int bytes) {
+    uint64_t value = 0;
+    for (int b = 0; b < bytes; b++) {
+        value |= uint64_t(state[offset + b]) << (8 * b);
+    }
+    return value;
+}
+
+template <typename Q>
+struct Instance : chip8_core {
+    Chip8<Q> chip8;
+
+    Instance() {
+        display = chip8.display;
+        keys = &chip8.keys;
+        drawFlag = &chip8.drawFlag;
+        chip8.loadFonts();
+    }
+
+    void reset() override {
+        chip8 = Chip8<Q>();
+        chip8.loadFonts();
+    }
+
+    bool load(uint8_t const* rom, size_t size) override {
+        return chip8.loadRom(rom, size);
+    }
+
+    int run(int instructions) override {
+        if (instructions < 0) {
+            return chip8.runFrameVip();
+        }
+        chip8.runFrame(instructions);
+        return instructions;
+    }
+
+    uint8_t soundTimer() const override {
+        return chip8.soundTimer;
+    }
+
+    void save(uint8_t* state) const override {
+        memcpy(state + STATE_REGISTERS, chip8.registers, 16);
+        for (int i = 0; i < 16; i++) {
+            put(state, STATE_STACK + 2 * i, chip8.stack[i], 2);
+        }
+        put(state, STATE_PC, chip8.pc, 2);
+        put(state, STATE_I, chip8.I, 2);
+        state[STATE_SP] = chip8.sp;
+        state[STATE_DELAY_TIMER] = chip8.delayTimer;
+        state[STATE_SOUND_TIMER] = chip8.soundTimer;
+        state[STATE_DRAW_FLAG] = chip8.drawFlag;
+        put(state, STATE_KEYS, chip8.keys, 4);
+        put(state, STATE_RNG, chip8.rngState, 4);
+        put(state, STATE_VIP_CYCLES, uint32_t(chip8.vipCycles), 4);
+        put(state, STATE_INVALID_OPCODES, chip8.invalidOpcodes, 4);
+        for (int y = 0; y < Chip8<Q>::HEIGHT; y++) {
+            put(state, STATE_DISPLAY + 8 * y, chip8.display[y], 8);
+        }
+        memcpy(state + STATE_MEMORY, chip8.memory, sizeof(chip8.memory));
+    }
+
+    void restore(uint8_t const* state) override {
+        memcpy(chip8.registers, state + STATE_REGISTERS, 16);
+        for (int i = 0; i < 16; i++) {
+            chip8.stack[i] = uint16_t(get(state, STATE_STACK + 2 * i, 2));
+        }
+        chip8.pc = uint16_t(get(state, STATE_PC, 2));
+        chip8.I = uint16_t(get(state, STATE_I, 2));
+        chip8.sp = state[STATE_SP];
+        chip8.delayTimer = state[STATE_DELAY_TIMER];
+        chip8.soundTimer = state[STATE_SOUND_TIMER];
+        chip8.drawFlag = state[STATE_DRAW_FLAG] != 0;
+        chip8.keys = uint16_t(get(state, STATE_KEYS, 2));
+        chip8.rngState = uint32_t(get(state, STATE_RNG, 4));
+        chip8.vipCycles = int32_t(uint32_t(get(state, STATE_VIP_CYCLES, 4)));
+        chip8.invalidOpcodes = uint32_t(get(state, STATE_INVALID_OPCODES, 4));
+        for (int y = 0; y < Chip8<Q>::HEIGHT; y++) {
+            chip8.display[y] = get(state, STATE_DISPLAY + 8 * y, 8);
+        }
+        memcpy(chip8.memory, state + STATE_MEMORY, sizeof(chip8.memory));
+    }
+};
+
+static size_t const ALIGNMENT = 64;
+static uint32_t const QUIRK_FLAGS = CHIP8_CP_SHIFT | CHIP8_SC_JUMP | CHIP8_COSMAC_MEM;
+
+static void* defaultAllocate(void*, size_t size, size_t alignment) {
+    return aligned_alloc(alignment, size);
+}
+
+static void defaultRelease(void*, void* pointer, size_t) {
+    free(pointer);
+}
+
+/**
+ * Most samples in one frame at the configured rate
+ */
+static size_t maxAudioSamples(chip8_config const& config) {
+    return (config.audio_rate + 59) / 60;
+}
+
+/**
+ * Fill the audio buffer for the frame just run
+ */
+static void renderAudio(chip8_core* core) {
+    uint64_t rate = core->config.audio_rate;
+    core->audioSamples = size_t((core->frame * rate) / 60 - ((core->frame - 1) * rate) / 60);
+    if (core->soundTimer() == 0) {
+        if (!core->audioSilent) {
+            memset(core->audio, 0, maxAudioSamples(core->config) * sizeof(int16_t));
+            core->audioSilent = true;
+        }
+        return;
+    }
+
+    // The same square wave as Window's
+    uint32_t period = max<uint32_t>(2, core->config.audio_rate / core->config.audio_frequency);
+    for (size_t i = 0; i < core->audioSamples; i++) {
+        core->audio[i] = core->audioPhase < period / 2 ? 28000 : -28000;
+        core->audioPhase = (core->audioPhase + 1) % period;
+    }
+    core->audioSilent = false;
+}
+
+extern "C" {
+
+uint32_t chip8_abi_version(void) {
+    return CHIP8_ABI_VERSION;
+}
+
+chip8_core* chip8_create(chip8_config const* config, chip8_allocator const* allocator) {
+    chip8_config settings = config ? *config : chip8_config{};
+    settings.speed = settings.speed ? settings.speed : 700;
+    settings.audio_frequency = settings.audio_frequency ? settings.audio_frequency : 440;
+    chip8_allocator memory = allocator ? *allocator : chip8_allocator{defaultAllocate, defaultRelease, nullptr};
+    if (!memory.allocate || !memory.release) {
+        return nullptr;
+    }
+
+    uint32_t flags = settings.flags;
+    return withQuirks(flags & CHIP8_CP_SHIFT, flags & CHIP8_SC_JUMP, flags & CHIP8_COSMAC_MEM,
+                      [&](auto quirks) -> chip8_core* {
+        typedef Instance<decltype(quirks)> Type;
+        size_t instanceSize = (sizeof(Type) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        size_t audioSize = maxAudioSamples(settings) * sizeof(int16_t);
+        size_t size = (instanceSize + audioSize + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        void* block = memory.allocate(memory.user, size, ALIGNMENT);
+        if (!block) {
+            return nullptr;
+        }
+
+        Type* core = new (block) Type();
+        core->config = settings;
+        core->allocator = memory;
+        core->allocationSize = size;
+        if (audioSize) {
+            core->audio = reinterpret_cast<int16_t*>(static_cast<uint8_t*>(block) + instanceSize);
+            memset(core->audio, 0, audioSize);
+        }
+        return core;
+    });
+}
+
+void chip8_destroy(chip8_core* core) {
+    if (core) {
+        chip8_allocator memory = core->allocator;
+        size_t size = core->allocationSize;
+        core->~chip8_core();
+        memory.release(memory.user, core, size);
+    }
+}
+
+int chip8_load_rom(chip8_core* core, uint8_t const* rom, size_t size) {
+    if (!core || (!rom && size)) {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    if (size == 0 || size > 4096 - 0x200) {
+        return CHIP8_ERROR_ROM_SIZE;
+    }
+    core->reset();
+    core->load(rom, size);
+    core->frame = 0;
+    core->audioPhase = 0;
+    core->audioSamples = 0;
+    return CHIP8_OK;
+}
+
+int chip8_run_frame(chip8_core* core) {
+    if (!core) {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    int executed;
+    if (core->config.flags & CHIP8_VIP_TIMING) {
+        executed = core->run(-1);
+    }
+    else {
+        uint64_t speed = core->config.speed;
+        executed = core->run(int((core->frame + 1) * speed / 60 - core->frame * speed / 60));
+    }
+    core->frame++;
+    if (core->audio) {
+        renderAudio(core);
+    }
+    return executed;
+}
+
+void chip8_set_keys(chip8_core* core, uint16_t keys) {
+    if (core) {
+        *core->keys = keys;
+    }
+}
+
+uint64_t const* chip8_get_framebuffer(chip8_core* core, int* changed) {
+    if (!core) {
+        return nullptr;
+    }
+    if (changed) {
+        *changed = *core->drawFlag;
+        *core->drawFlag = false;
+    }
+    return core->display;
+}
+
+int16_t const* chip8_get_audio(chip8_core const* core, size_t* count) {
+    if (count) {
+        *count = core && core->audio ? core->audioSamples : 0;
+    }
+    return core ? core->audio : nullptr;
+}
+
+int chip8_serialize(chip8_core const* core, void* buffer, size_t capacity) {
+    if (!core || !buffer) {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    if (capacity < CHIP8_STATE_SIZE) {
+        return CHIP8_ERROR_BUFFER;
+    }
+    uint8_t* state = static_cast<uint8_t*>(buffer);
+    memset(state, 0, CHIP8_STATE_SIZE);
+    put(state, 0, STATE_MAGIC, 4);
+    put(state, STATE_VERSION, CHIP8_ABI_VERSION, 2);
+    put(state, STATE_QUIRKS, core->config.flags & QUIRK_FLAGS, 2);
+    put(state, STATE_FRAME, core->frame, 8);
+    put(state, STATE_AUDIO_PHASE, core->audioPhase, 4);
+    core->save(state);
+    return CHIP8_STATE_SIZE;
+}
+
+int chip8_deserialize(chip8_core* core, void const* buffer, size_t size) {
+    if (!core || !buffer) {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    uint8_t const* state = static_cast<uint8_t const*>(buffer);
+    if (size < CHIP8_STATE_SIZE || get(state, 0, 4) != STATE_MAGIC || get(state, STATE_VERSION, 2) != CHIP8_ABI_VERSION) {
+        return CHIP8_ERROR_STATE;
+    }
+    if (get(state, STATE_QUIRKS, 2) != (core->config.flags & QUIRK_FLAGS)) {
+        return CHIP8_ERROR_QUIRKS;
+    }
+    core->frame = get(state, STATE_FRAME, 8);
+    core->audioPhase = uint32_t(get(state, STATE_AUDIO_PHASE, 4));
+    core->restore(state);
+    return CHIP8_OK;
+}
+
+}
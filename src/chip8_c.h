@@ -0,0 +1,163 @@
+#ifndef CHIP8_C_H
+#define CHIP8_C_H
+
+/**
+ * C interface to the CHIP-8 core, for embedding in other applications
+ *
+ * Only plain C types cross this interface, and libchip8.so exports only
+ * these functions, so hosts written in C or any language with a C FFI can
+ * link it without depending on the C++ ABI. The core is headless: the host
+ * runs frames, reads the display and audio, and sets the keys.
+ *
+ * The display and audio are read in place: chip8_get_framebuffer() and
+ * chip8_get_audio() return pointers into the instance, valid until it is
+ * destroyed, so there is no copy per frame. An instance is one allocation of
+ * about 4.5KB plus its audio buffer, made through the host's allocator if it
+ * supplies one. Instances are independent, so different threads may drive
+ * different instances; one instance must not be used by two threads at once.
+ *
+ * Functions returning int return CHIP8_OK or a negative chip8_error.
+ *
+ *   chip8_core* core = chip8_create(NULL, NULL);
+ *   chip8_load_rom(core, rom, size);
+ *   for (;;) {
+ *       chip8_set_keys(core, keys);
+ *       chip8_run_frame(core);
+ *       uint64_t const* rows = chip8_get_framebuffer(core, NULL); // 32 rows, leftmost pixel in bit 63
+ *   }
+ *   chip8_destroy(core);
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * chip8_c.cpp defines CHIP8_BUILDING, so the DLL exports the functions and
+ * its users import them. Define CHIP8_STATIC to link the objects directly.
+ */
+#if defined(_WIN32) && defined(CHIP8_STATIC)
+#define CHIP8_API
+#elif defined(_WIN32) && defined(CHIP8_BUILDING)
+#define CHIP8_API __declspec(dllexport)
+#elif defined(_WIN32)
+#define CHIP8_API __declspec(dllimport)
+#else
+#define CHIP8_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped when a function, structure or the serialized state changes incompatibly */
+#define CHIP8_ABI_VERSION 1
+
+#define CHIP8_WIDTH 64
+#define CHIP8_HEIGHT 32
+
+/* Size of a serialized state, see chip8_serialize() */
+#define CHIP8_STATE_SIZE 4448
+
+typedef struct chip8_core chip8_core;
+
+enum chip8_error {
+    CHIP8_OK = 0,
+    CHIP8_ERROR_ARGUMENT = -1,   /* A null pointer or out-of-range value */
+    CHIP8_ERROR_ROM_SIZE = -2,   /* Empty, or larger than the 3584 bytes from 0x200 */
+    CHIP8_ERROR_BUFFER = -3,     /* The buffer is smaller than CHIP8_STATE_SIZE */
+    CHIP8_ERROR_STATE = -4,      /* Not a serialized state, or from another ABI version */
+    CHIP8_ERROR_QUIRKS = -5,     /* Serialized with other quirk flags than the instance's */
+};
+
+/* chip8_config.flags */
+enum chip8_flags {
+    CHIP8_CP_SHIFT = 1 << 0,   /* 8xy6/8xyE set Vx to Vy before shifting */
+    CHIP8_SC_JUMP = 1 << 1,    /* Bnnn jumps to xnn + Vx */
+    CHIP8_COSMAC_MEM = 1 << 2, /* Fx55/Fx65 increment I */
+    CHIP8_VIP_TIMING = 1 << 3, /* Frames charge COSMAC VIP cycle costs instead of a flat speed */
+};
+
+/**
+ * Memory for instances; both functions receive user as given
+ *
+ * allocate must return memory aligned to at least alignment (64), or NULL.
+ */
+typedef struct chip8_allocator {
+    void* (*allocate)(void* user, size_t size, size_t alignment);
+    void (*release)(void* user, void* pointer, size_t size);
+    void* user;
+} chip8_allocator;
+
+typedef struct chip8_config {
+    uint32_t flags;          /* chip8_flags */
+    uint32_t speed;          /* Instructions per second without CHIP8_VIP_TIMING, 700 if 0 */
+    uint32_t audio_rate;     /* Samples per second of chip8_get_audio(), 0 for no audio */
+    uint32_t audio_frequency; /* Of the beep's square wave, 440 if 0 */
+} chip8_config;
+
+/**
+ * CHIP8_ABI_VERSION of the library actually loaded
+ */
+CHIP8_API uint32_t chip8_abi_version(void);
+
+/**
+ * Create an instance with fonts loaded and no ROM
+ * @param config Quirks, speed and audio, or NULL for the defaults
+ * @param allocator Allocator for the instance, kept until chip8_destroy(), or NULL for the C library's
+ * @return The instance, or NULL if allocation failed
+ */
+CHIP8_API chip8_core* chip8_create(chip8_config const* config, chip8_allocator const* allocator);
+
+CHIP8_API void chip8_destroy(chip8_core* core);
+
+/**
+ * Reset the machine and load a ROM at 0x200
+ */
+CHIP8_API int chip8_load_rom(chip8_core* core, uint8_t const* rom, size_t size);
+
+/**
+ * Run one 60Hz frame: the instructions due at the configured speed, or a
+ * frame of VIP time, then the timers and the frame's audio
+ * @return Instructions executed, or a negative chip8_error
+ */
+CHIP8_API int chip8_run_frame(chip8_core* core);
+
+/**
+ * Set the keypad for the next frames
+ * @param keys Bit k set while key k is down
+ */
+CHIP8_API void chip8_set_keys(chip8_core* core, uint16_t keys);
+
+/**
+ * The display, read in place: CHIP8_HEIGHT rows of one word each, the
+ * leftmost pixel in the top bit. The pointer stays valid and is updated by
+ * every frame.
+ * @param changed If not NULL, set to 1 if the display changed since the last call, else 0
+ */
+CHIP8_API uint64_t const* chip8_get_framebuffer(chip8_core* core, int* changed);
+
+/**
+ * The last frame's audio, read in place: a mono 16-bit square wave while the
+ * sound timer runs, silence otherwise, and NULL without audio_rate. The
+ * buffer is overwritten by the next frame.
+ * @param count Set to the number of samples
+ */
+CHIP8_API int16_t const* chip8_get_audio(chip8_core const* core, size_t* count);
+
+/**
+ * Write the machine state to buffer in a fixed little-endian layout of
+ * CHIP8_STATE_SIZE bytes, independent of the host and compiler
+ * @return CHIP8_STATE_SIZE, or a negative chip8_error
+ */
+CHIP8_API int chip8_serialize(chip8_core const* core, void* buffer, size_t capacity);
+
+/**
+ * Restore a state from chip8_serialize() of an instance with the same quirk flags
+ */
+CHIP8_API int chip8_deserialize(chip8_core* core, void const* buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,295 @@
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "protocol.h"
+#include "Terminal.h"
+using namespace std;
+
+/**
+ * Load-test client for chip8-server
+ *
+ * Opens many viewer connections, starts a session on each with the same ROM,
+ * presses random keys and applies the FRAME deltas it receives to a local copy
+ * of every display. Reports received frame rate and bandwidth per session.
+ *
+ * With --watch the first session is drawn live in the terminal and played
+ * with the local keyboard instead of random keys.
+ */
+
+/**
+ * One viewer connection
+ */
+struct Viewer {
+    int fd;
+    vector<uint8_t> input;
+    uint64_t rows[32]{}; // The display rebuilt from FRAME deltas
+    uint32_t nextFrame = 0;
+    uint64_t frames = 0;
+    uint64_t rowsReceived = 0;
+    uint64_t gaps = 0; // FRAMEs skipped by the server because this viewer lagged
+    uint8_t soundTimer = 0;
+    bool failed = false;
+};
+
+static bool sendAll(int fd, void const* data, size_t length) {
+    uint8_t const* bytes = reinterpret_cast<uint8_t const*>(data);
+    while (length > 0) {
+        ssize_t n = send(fd, bytes, length, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                usleep(100);
+                continue;
+            }
+            return false;
+        }
+        bytes += n;
+        length -= n;
+    }
+    return true;
+}
+
+static bool sendMessage(int fd, uint8_t type, void const* payload, size_t length) {
+    MessageHeader header{type, 0, uint16_t(length)};
+    return sendAll(fd, &header, sizeof(header)) && sendAll(fd, payload, length);
+}
+
+/**
+ * Apply every complete message in the viewer's input buffer
+ */
+static void handleInput(Viewer& viewer) {
+    size_t offset = 0;
+    while (viewer.input.size() - offset >= sizeof(MessageHeader)) {
+        MessageHeader header;
+        memcpy(&header, viewer.input.data() + offset, sizeof(header));
+        if (viewer.input.size() - offset < sizeof(header) + header.length) {
+            break;
+        }
+        uint8_t const* payload = viewer.input.data() + offset + sizeof(header);
+        offset += sizeof(header) + header.length;
+
+        if (header.type == MSG_FRAME && header.length >= sizeof(FrameMessage)) {
+            FrameMessage frame;
+            memcpy(&frame, payload, sizeof(frame));
+            payload += sizeof(frame);
+            for (int y = 0; y < 32; y++) {
+                if (frame.rowMask & (1u << y)) {
+                    memcpy(&viewer.rows[y], payload, 8);
+                    payload += 8;
+                    viewer.rowsReceived++;
+                }
+            }
+            viewer.gaps += frame.frame - viewer.nextFrame;
+            viewer.nextFrame = frame.frame + 1;
+            viewer.soundTimer = frame.soundTimer;
+            viewer.frames++;
+        }
+        else if (header.type == MSG_ERROR) {
+            cerr << "Server error: " << string(reinterpret_cast<char const*>(payload), header.length) << endl;
+            viewer.failed = true;
+        }
+    }
+    viewer.input.erase(viewer.input.begin(), viewer.input.begin() + offset);
+}
+
+int main(int argc, char* argv[]) {
+    string socketPath = CHIP8_SOCKET_PATH;
+    string romPath;
+    int sessions = 100;
+    double seconds = 10;
+    double keysPerSecond = 2;
+    uint8_t flags = 0;
+    bool show = false;
+    bool watch = false;
+    TerminalCells cells = CELLS_HALF_BLOCK;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "--socket" && i + 1 < argc) socketPath = argv[++i];
+        else if (arg == "--sessions" && i + 1 < argc) sessions = atoi(argv[++i]);
+        else if (arg == "--seconds" && i + 1 < argc) seconds = atof(argv[++i]);
+        else if (arg == "--keys" && i + 1 < argc) keysPerSecond = atof(argv[++i]);
+        else if (arg == "--cp_shift") flags |= START_CP_SHIFT;
+        else if (arg == "--sc_jump") flags |= START_SC_JUMP;
+        else if (arg == "--cosmac_mem") flags |= START_COSMAC_MEM;
+        else if (arg == "--vip_timing") flags |= START_VIP_TIMING;
+        else if (arg == "--show") show = true;
+        else if (arg == "--watch") watch = true;
+        else if (arg == "--braille") cells = CELLS_BRAILLE;
+        else romPath = arg;
+    }
+
+    if (romPath.empty()) {
+        cerr << "Usage: " << argv[0] << " <rom> [--sessions N] [--seconds S] [--keys per-second] [--socket path] [--show] [--watch [--braille]] [quirk flags]" << endl;
+        return 1;
+    }
+
+    ifstream file{romPath, ios::binary};
+    vector<uint8_t> start(sizeof(StartMessage));
+    start.insert(start.end(), istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    if (!file.good() && !file.eof()) {
+        cerr << "Unable to read file" << endl;
+        return 1;
+    }
+    StartMessage startMessage{flags, 0, 0};
+    memcpy(start.data(), &startMessage, sizeof(startMessage));
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    int epoll = epoll_create1(EPOLL_CLOEXEC);
+    vector<Viewer> viewers(sessions);
+    for (int i = 0; i < sessions; i++) {
+        Viewer& viewer = viewers[i];
+        viewer.fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (connect(viewer.fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+            !sendMessage(viewer.fd, MSG_START, start.data(), start.size())) {
+            cerr << "Unable to start session " << i << " on " << socketPath << ": " << strerror(errno) << endl;
+            return 1;
+        }
+        fcntl(viewer.fd, F_SETFL, fcntl(viewer.fd, F_GETFL) | O_NONBLOCK);
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, viewer.fd, &event);
+    }
+
+    uint32_t rng = 0x9E3779B9;
+    auto random = [&]() {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng;
+    };
+
+    auto begin = chrono::steady_clock::now();
+    auto end = begin + chrono::duration_cast<chrono::nanoseconds>(chrono::duration<double>(seconds));
+    auto nextKeys = begin;
+    uint64_t bytes = 0;
+    uint64_t keyEvents = 0;
+    epoll_event events[256];
+
+    unique_ptr<Terminal> terminal;
+    uint16_t watchedKeys = 0;
+    uint64_t watchedFrames = 0;
+    if (watch) {
+        terminal = make_unique<Terminal>(cells);
+        keysPerSecond = sessions > 1 ? keysPerSecond : 0;
+    }
+
+    while (chrono::steady_clock::now() < end) {
+        int ready = epoll_wait(epoll, events, 256, 5);
+        for (int e = 0; e < ready; e++) {
+            Viewer& viewer = viewers[events[e].data.u32];
+            uint8_t buffer[16384];
+            ssize_t n;
+            while ((n = recv(viewer.fd, buffer, sizeof(buffer), 0)) > 0) {
+                viewer.input.insert(viewer.input.end(), buffer, buffer + n);
+                bytes += n;
+            }
+            if (n == 0) {
+                viewer.failed = true;
+                epoll_ctl(epoll, EPOLL_CTL_DEL, viewer.fd, nullptr);
+            }
+            handleInput(viewer);
+        }
+
+        if (terminal) {
+            Viewer& watched = viewers[0];
+            uint16_t keys = watchedKeys;
+            if (terminal->processInput(keys)) {
+                break;
+            }
+            for (int k = 0; k < 16; k++) {
+                if (((keys ^ watchedKeys) >> k) & 1) {
+                    KeyMessage key{uint8_t(k), uint8_t((keys >> k) & 1)};
+                    sendMessage(watched.fd, MSG_KEY, &key, sizeof(key));
+                }
+            }
+            watchedKeys = keys;
+            if (watched.frames != watchedFrames) {
+                watchedFrames = watched.frames;
+                terminal->update(watched.rows);
+                if (watched.soundTimer > 0) {
+                    terminal->startBeep();
+                }
+                else {
+                    terminal->stopBeep();
+                }
+                if (watchedFrames % 60 == 1) {
+                    terminal->status("session 1 of " + to_string(sessions) + ", frame " + to_string(watched.nextFrame) +
+                                     (watched.failed ? ", closed" : ""));
+                }
+            }
+        }
+
+        // Key events are spread over the viewers at the requested rate
+        auto now = chrono::steady_clock::now();
+        while (keysPerSecond > 0 && nextKeys < now) {
+            // The watched session only gets the local keys
+            Viewer& viewer = viewers[watch ? 1 + random() % (sessions - 1) : random() % sessions];
+            KeyMessage key{uint8_t(random() & 0xF), uint8_t(random() & 1)};
+            sendMessage(viewer.fd, MSG_KEY, &key, sizeof(key));
+            keyEvents++;
+            nextKeys += chrono::duration_cast<chrono::nanoseconds>(chrono::duration<double>(1.0 / (keysPerSecond * sessions)));
+        }
+    }
+
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    uint64_t terminalBytes = terminal ? terminal->bytesWritten() : 0;
+    terminal.reset();
+    uint64_t frames = 0;
+    uint64_t rows = 0;
+    uint64_t gaps = 0;
+    int failed = 0;
+    int realtime = 0;
+    for (Viewer& viewer : viewers) {
+        frames += viewer.frames;
+        rows += viewer.rowsReceived;
+        gaps += viewer.gaps;
+        failed += viewer.failed;
+        realtime += viewer.frames / elapsed >= 55;
+        close(viewer.fd);
+    }
+
+    cout << fixed << setprecision(1)
+         << sessions << " sessions for " << elapsed << " s, " << keyEvents << " key events" << endl
+         << "frames/s per session   " << frames / elapsed / sessions << endl
+         << "sessions at >= 55 fps  " << realtime << endl
+         << "bytes per frame        " << (frames ? double(bytes) / frames : 0) << endl
+         << "rows per frame         " << setprecision(2) << (frames ? double(rows) / frames : 0) << endl
+         << "frames skipped (lag)   " << gaps << endl
+         << "failed sessions        " << failed << endl;
+    if (watch) {
+        cout << "terminal bytes/frame   " << setprecision(1) << (watchedFrames ? double(terminalBytes) / watchedFrames : 0) << endl;
+    }
+
+    if (show) {
+        for (int y = 0; y < 32; y++) {
+            for (int x = 0; x < 64; x++) {
+                cout << ((viewers[0].rows[y] >> (63 - x)) & 1 ? '#' : '.');
+            }
+            cout << endl;
+        }
+    }
+
+    close(epoll);
+    return failed ? 1 : 0;
+}
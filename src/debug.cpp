@@ -0,0 +1,72 @@
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "Debugger.h"
+using namespace std;
+
+/**
+ * Terminal debugger for the headless core
+ *
+ * Loads a ROM into a core specialized on the given quirk profile and reads
+ * debugger commands from stdin; type help for the list. Ctrl-C interrupts a
+ * running continue, next or finish and returns to the prompt.
+ */
+
+template <typename Q>
+static void onInterrupt(int) {
+    Debugger<Q>::interrupt();
+}
+
+template <typename Q>
+int debug(string const& rom, int instructionsPerFrame) {
+    Chip8<Q> chip8;
+    if (!chip8.loadRom(rom)) {
+        return 1;
+    }
+    chip8.loadFonts();
+
+    Debugger<Q> debugger(chip8, instructionsPerFrame, cout);
+    signal(SIGINT, onInterrupt<Q>);
+
+    debugger.command("list 0x200 1");
+    string line;
+    while (true) {
+        cout << "(chip8) " << flush;
+        if (!getline(cin, line) || !debugger.command(line)) {
+            break;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <rom> [--cp_shift] [--sc_jump] [--cosmac_mem] [--ipf <instructions per frame>]" << endl;
+        return 1;
+    }
+
+    string rom = argv[1];
+    bool cpShift = false;
+    bool scJump = false;
+    bool cosmacMem = false;
+    int instructionsPerFrame = 11;
+
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "--cp_shift") cpShift = true;
+        else if (arg == "--sc_jump") scJump = true;
+        else if (arg == "--cosmac_mem") cosmacMem = true;
+        else if (arg == "--ipf" && i + 1 < argc) instructionsPerFrame = atoi(argv[++i]);
+    }
+
+    if (instructionsPerFrame <= 0) {
+        cerr << "--ipf must be a positive integer" << endl;
+        return 1;
+    }
+
+    return withQuirks(cpShift, scJump, cosmacMem, [&](auto quirks) {
+        return debug<decltype(quirks)>(rom, instructionsPerFrame);
+    });
+}
@@ -0,0 +1,618 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "Chip8Batch.h"
+#include "Predecoded.h"
+#include "QuirkDetect.h"
+#include "RomGen.h"
+#include "chip8.h"
+#include "chip8_c.h"
+using namespace std;
+
+/**
+ * Differential lockstep harness
+ *
+ * Runs two interpreter backends side by side on the same ROM and input
+ * stream, and compares the register file, I, pc, sp, timers and a display
+ * hash after every instruction (or every frame). The first divergence is
+ * reported with the address and OP code that caused it.
+ *
+ * A backend is any type with loadRom(), loadFonts(), cycle(), updateTimers(),
+ * memory, pc and keys mask members, and a capture() overload below. Add an overload and a pairing in main() to put a
+ * new execution path under test against the reference Chip8::cycle().
+ */
+
+/**
+ * Architectural state compared between backends
+ */
+struct MachineState {
+    uint8_t registers[16];
+    uint16_t I;
+    uint16_t pc;
+    uint8_t sp;
+    uint8_t delayTimer;
+    uint8_t soundTimer;
+    uint64_t frameHash;
+
+    bool operator==(MachineState const& other) const {
+        return memcmp(registers, other.registers, sizeof(registers)) == 0 &&
+               I == other.I && pc == other.pc && sp == other.sp &&
+               delayTimer == other.delayTimer && soundTimer == other.soundTimer &&
+               frameHash == other.frameHash;
+    }
+};
+
+template <typename Q>
+MachineState capture(Chip8<Q>& chip8, uint64_t& frameHash) {
+    // Only rehash the display after an OP code drew to it
+    if (chip8.drawFlag) {
+        frameHash = chip8.frameHash();
+        chip8.drawFlag = false;
+    }
+
+    MachineState state{};
+    memcpy(state.registers, chip8.registers, sizeof(state.registers));
+    state.I = chip8.I;
+    state.pc = chip8.pc;
+    state.sp = chip8.sp;
+    state.delayTimer = chip8.delayTimer;
+    state.soundTimer = chip8.soundTimer;
+    state.frameHash = frameHash;
+    return state;
+}
+
+/**
+ * Chip8::frameHash() of a display packed one bit per pixel
+ */
+uint64_t hashRows(uint64_t const* rows) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (int y = 0; y < 32; y++) {
+        for (int x = 63; x >= 0; x--) {
+            hash = (hash ^ ((rows[y] >> x) & 0x1)) * 0x100000001B3ull;
+        }
+    }
+    return hash;
+}
+
+/**
+ * Print the fields that differ between two states
+ */
+void printDiff(MachineState const& a, MachineState const& b) {
+    cout << hex << uppercase;
+    for (int i = 0; i < 16; i++) {
+        if (a.registers[i] != b.registers[i]) {
+            cout << "    V" << i << ": " << int(a.registers[i]) << " != " << int(b.registers[i]) << endl;
+        }
+    }
+    if (a.I != b.I) cout << "    I: " << a.I << " != " << b.I << endl;
+    if (a.pc != b.pc) cout << "    pc: " << a.pc << " != " << b.pc << endl;
+    if (a.sp != b.sp) cout << "    sp: " << int(a.sp) << " != " << int(b.sp) << endl;
+    if (a.delayTimer != b.delayTimer) cout << "    delayTimer: " << int(a.delayTimer) << " != " << int(b.delayTimer) << endl;
+    if (a.soundTimer != b.soundTimer) cout << "    soundTimer: " << int(a.soundTimer) << " != " << int(b.soundTimer) << endl;
+    if (a.frameHash != b.frameHash) cout << "    frameHash: " << a.frameHash << " != " << b.frameHash << endl;
+    cout << dec << nouppercase;
+}
+
+/**
+ * Scripted input: every frame there is a 1 in 8 chance of toggling a key.
+ * A seed of 0 means no input at all.
+ */
+struct InputScript {
+    uint32_t state;
+
+    explicit InputScript(uint32_t seed) : state(seed) {}
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    template <typename A, typename B>
+    void apply(A& a, B& b) {
+        if (!state) {
+            return;
+        }
+        uint32_t r = next();
+        if ((r & 0x7) == 0) {
+            int key = (r >> 3) & 0xF;
+            a.keys ^= 1 << key;
+            b.keys ^= 1 << key;
+        }
+    }
+};
+
+/**
+ * Lane 0 of a Chip8Batch under test
+ *
+ * Lane 1 gets the same input as lane 0 and lanes 2 and 3 get their own, so
+ * lane 0 runs both in shared SIMD runs and alone once the lanes diverge.
+ */
+template <typename Q>
+struct BatchLane {
+    static int const LANES = 4;
+    Chip8Batch<Q> batch{LANES};
+    uint16_t keys = 0;
+    InputScript noise{0xC0FFEE};
+
+    bool loadRom(uint8_t const* data, size_t size) { return batch.loadRom(data, size); }
+    void loadFonts() {}
+
+    void cycle() {
+        batch.keys[0] = batch.keys[1] = keys;
+        batch.cycle();
+    }
+
+    void updateTimers() {
+        batch.updateTimers();
+        for (int lane = 2; lane < LANES; lane++) {
+            uint32_t r = noise.next();
+            if ((r & 0x7) == 0) {
+                batch.keys[lane] ^= 1 << ((r >> 3) & 0xF);
+            }
+        }
+    }
+};
+
+template <typename Q>
+MachineState capture(BatchLane<Q>& lane, uint64_t& frameHash) {
+    Chip8Batch<Q>& batch = lane.batch;
+    if (batch.drawFlag[0]) {
+        frameHash = hashRows(batch.display(0));
+        batch.drawFlag[0] = 0;
+    }
+
+    MachineState state{};
+    for (int i = 0; i < 16; i++) {
+        state.registers[i] = batch.registerOf(0, i);
+    }
+    state.I = batch.I[0];
+    state.pc = batch.pc[0];
+    state.sp = batch.sp[0];
+    state.delayTimer = batch.delayTimer[0];
+    state.soundTimer = batch.soundTimer[0];
+    state.frameHash = frameHash;
+    return state;
+}
+
+/**
+ * Predecoded core, taking its translations from a cache in a scratch directory
+ *
+ * Each ROM and profile runs twice: the first run decodes and stores the
+ * translation, the second maps the stored file, so both paths are compared.
+ */
+static TranslationCache* translationCache;
+static long translationSources[3]; // Runs per TranslationSource
+
+template <typename Q>
+struct PredecodedRun {
+    Predecoded<Q> core{translationCache};
+    uint16_t keys = 0;
+
+    bool loadRom(uint8_t const* data, size_t size) {
+        bool loaded = core.loadRom(data, size);
+        translationSources[core.source()]++;
+        return loaded;
+    }
+    void loadFonts() {}
+
+    void cycle() {
+        core.chip8.keys = keys;
+        core.cycle();
+    }
+
+    void updateTimers() { core.updateTimers(); }
+};
+
+template <typename Q>
+MachineState capture(PredecodedRun<Q>& run, uint64_t& frameHash) {
+    return capture(run.core.chip8, frameHash);
+}
+
+/**
+ * Options shared by every lockstep run
+ */
+struct Options {
+    int frames = 600; // 10 seconds of emulated time
+    int instructionsPerFrame = 11; // ~700 instructions per second
+    bool perInstruction = true; // Compare after every instruction, otherwise every frame
+    uint32_t inputSeed = 1;
+};
+
+/**
+ * Run backends A and B in lockstep on a ROM
+ *
+ * @param finalState - If set, receives the final state of A
+ * @return True if the backends never diverged
+ */
+template <typename A, typename B>
+bool lockstep(string const& name, vector<uint8_t> const& rom, Options const& options, MachineState* finalState = nullptr) {
+    A a;
+    B b;
+    a.loadRom(rom.data(), rom.size());
+    a.loadFonts();
+    b.loadRom(rom.data(), rom.size());
+    b.loadFonts();
+    InputScript input(options.inputSeed);
+    uint64_t hashA = 0;
+    uint64_t hashB = 0;
+    capture(a, hashA);
+    capture(b, hashB);
+
+    long executed = 0;
+    for (int frame = 0; frame < options.frames; frame++) {
+        input.apply(a, b);
+
+        for (int i = 0; i < options.instructionsPerFrame; i++) {
+            uint16_t address = a.pc;
+            uint16_t opcode = (a.memory[address] << 8) | a.memory[(address + 1) & 0xFFF];
+            a.cycle();
+            b.cycle();
+            executed++;
+
+            if (options.perInstruction || i + 1 == options.instructionsPerFrame) {
+                MachineState sa = capture(a, hashA);
+                MachineState sb = capture(b, hashB);
+                if (!(sa == sb)) {
+                    cout << "DIVERGED " << name << " at frame " << frame << ", instruction " << executed
+                         << hex << uppercase << setfill('0')
+                         << ": address 0x" << setw(3) << address << ", OP code " << setw(4) << opcode
+                         << dec << nouppercase << setfill(' ') << endl;
+                    if (!options.perInstruction) {
+                        cout << "    (compared per frame; the OP code is the last one of the frame)" << endl;
+                    }
+                    printDiff(sa, sb);
+                    return false;
+                }
+            }
+        }
+
+        a.updateTimers();
+        b.updateTimers();
+        MachineState sa = capture(a, hashA);
+        MachineState sb = capture(b, hashB);
+        if (!(sa == sb)) {
+            cout << "DIVERGED " << name << " at frame " << frame << " while updating timers" << endl;
+            printDiff(sa, sb);
+            return false;
+        }
+    }
+
+    if (finalState) {
+        *finalState = capture(a, hashA);
+    }
+    return true;
+}
+
+/**
+ * Read a ROM file into a byte vector
+ */
+bool readRom(string const& path, vector<uint8_t>& rom) {
+    ifstream file{path, ios::binary};
+    if (!file.is_open()) {
+        return false;
+    }
+    rom.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    return true;
+}
+
+/**
+ * Run a ROM through the C interface next to Chip8<Q>, comparing the
+ * framebuffer and its changed flag with the core's display every frame
+ *
+ * Half way the state is serialized; the second half is then run again from
+ * it in a new instance, which must serialize back to the same bytes and draw
+ * the same frames. A short buffer and an instance of another profile must
+ * refuse the state, so a change to its layout or size shows up here.
+ *
+ * @return True if the C interface matched the core throughout
+ */
+template <typename Q>
+bool checkCInterface(string const& name, vector<uint8_t> const& rom, Options const& options) {
+    struct Keys {
+        uint16_t keys = 0;
+    };
+    uint32_t flags = (Q::CP_SHIFT ? CHIP8_CP_SHIFT : 0) | (Q::SC_JUMP ? CHIP8_SC_JUMP : 0) |
+                     (Q::COSMAC_MEM ? CHIP8_COSMAC_MEM : 0);
+    chip8_config config{flags, uint32_t(options.instructionsPerFrame * 60), 0, 0};
+    int half = options.frames / 2;
+
+    // Run frames [from, to) on both, comparing after each
+    auto run = [&](chip8_core* core, Chip8<Q>& chip8, InputScript& input, Keys& keys, int from, int to) {
+        for (int frame = from; frame < to; frame++) {
+            input.apply(chip8, keys);
+            chip8_set_keys(core, keys.keys);
+            int executed = chip8_run_frame(core);
+            chip8.runFrame(options.instructionsPerFrame);
+
+            int changed;
+            uint64_t const* framebuffer = chip8_get_framebuffer(core, &changed);
+            if (executed != options.instructionsPerFrame || changed != chip8.drawFlag ||
+                memcmp(framebuffer, chip8.display, sizeof(chip8.display)) != 0) {
+                cout << "C INTERFACE " << name << " differs from the core at frame " << frame << endl;
+                return false;
+            }
+            chip8.drawFlag = false;
+        }
+        return true;
+    };
+
+    chip8_core* core = chip8_create(&config, nullptr);
+    chip8_core* restored = chip8_create(&config, nullptr);
+    config.flags ^= CHIP8_COSMAC_MEM;
+    chip8_core* other = chip8_create(&config, nullptr);
+    bool same = false;
+
+    Chip8<Q> chip8;
+    chip8.loadFonts();
+    Keys keys;
+    InputScript input(options.inputSeed);
+    vector<uint8_t> state(CHIP8_STATE_SIZE);
+    vector<uint8_t> again(CHIP8_STATE_SIZE);
+    if (chip8_load_rom(core, rom.data(), rom.size()) != CHIP8_OK || !chip8.loadRom(rom.data(), rom.size())) {
+        cout << "C INTERFACE " << name << " did not load the ROM" << endl;
+    }
+    else if (run(core, chip8, input, keys, 0, half)) {
+        Chip8<Q> savedChip8 = chip8;
+        Keys savedKeys = keys;
+        InputScript savedInput = input;
+        int size = chip8_serialize(core, state.data(), state.size());
+
+        if (size != CHIP8_STATE_SIZE) {
+            cout << "C INTERFACE " << name << " serialized " << size << " bytes, expected " << CHIP8_STATE_SIZE << endl;
+        }
+        else if (chip8_serialize(core, again.data(), CHIP8_STATE_SIZE - 1) != CHIP8_ERROR_BUFFER ||
+                 chip8_deserialize(restored, state.data(), CHIP8_STATE_SIZE - 1) != CHIP8_ERROR_STATE) {
+            cout << "C INTERFACE " << name << " accepted a buffer smaller than the state" << endl;
+        }
+        else if (chip8_deserialize(other, state.data(), state.size()) != CHIP8_ERROR_QUIRKS) {
+            cout << "C INTERFACE " << name << " restored a state into another quirk profile" << endl;
+        }
+        else if (chip8_deserialize(restored, state.data(), state.size()) != CHIP8_OK ||
+                 chip8_serialize(restored, again.data(), again.size()) != CHIP8_STATE_SIZE || state != again) {
+            cout << "C INTERFACE " << name << " did not serialize a restored state to the same bytes" << endl;
+        }
+        else if (run(core, chip8, input, keys, half, options.frames)) {
+            same = run(restored, savedChip8, savedInput, savedKeys, half, options.frames);
+        }
+    }
+
+    chip8_destroy(core);
+    chip8_destroy(restored);
+    chip8_destroy(other);
+    return same;
+}
+
+/**
+ * Run the reference core against every other backend for one quirk profile
+ *
+ * @param runs - Increased by the number of comparisons made
+ * @return Number of comparisons that failed
+ */
+template <typename Q>
+int compareBackends(string const& name, vector<uint8_t> const& rom, Options const& options, int& runs) {
+    int failures = 0;
+    auto count = [&](bool same) {
+        runs++;
+        failures += !same;
+    };
+    count(lockstep<Chip8<Q>, Chip8<RuntimeQuirks>>(name + " [runtime quirks]", rom, options));
+    count(lockstep<Chip8<Q>, BatchLane<Q>>(name + " [batch]", rom, options));
+    count(lockstep<Chip8<Q>, PredecodedRun<Q>>(name + " [predecoded]", rom, options));
+    count(lockstep<Chip8<Q>, PredecodedRun<Q>>(name + " [predecoded, warm]", rom, options));
+    count(checkCInterface<Q>(name + " [C interface]", rom, options));
+    return failures;
+}
+
+/**
+ * Run a ROM under all 8 quirk profiles
+ *
+ * @param runs - Increased by the number of comparisons made
+ * @return Number of comparisons that failed
+ */
+int compareAllProfiles(string const& name, vector<uint8_t> const& rom, Options const& options, int& runs) {
+    int failures = 0;
+    for (int profile = 0; profile < 8; profile++) {
+        bool cp_shift = profile & 4;
+        bool sc_jump = profile & 2;
+        bool cosmac_mem = profile & 1;
+        RuntimeQuirks::CP_SHIFT = cp_shift;
+        RuntimeQuirks::SC_JUMP = sc_jump;
+        RuntimeQuirks::COSMAC_MEM = cosmac_mem;
+
+        string label = name + " " + (cp_shift ? 'S' : '-') + (sc_jump ? 'J' : '-') + (cosmac_mem ? 'M' : '-');
+        failures += withQuirks(cp_shift, sc_jump, cosmac_mem, [&](auto quirks) {
+            return compareBackends<decltype(quirks)>(label, rom, options, runs);
+        });
+    }
+    return failures;
+}
+
+/**
+ * Damage a stored translation in each way the cache validates, and check that
+ * the next start rejects the file, decodes afresh and replaces it, and the
+ * start after that maps the new file
+ */
+int checkTranslationFallback(vector<uint8_t> const& rom) {
+    typedef Predecoded<Quirks<false, false, false>> Core;
+    struct Damage {
+        char const* what;
+        size_t offset; // Byte to change; 0 with truncate
+        bool truncate;
+    };
+    size_t const fileSize = sizeof(TranslationFileHeader) + Translation::ENTRIES * sizeof(DecodedOp);
+    Damage const damages[] = {
+        {"magic", offsetof(TranslationFileHeader, magic), false},
+        {"version", offsetof(TranslationFileHeader, version), false},
+        {"key", offsetof(TranslationFileHeader, romHash), false},
+        {"table", fileSize - 1, false},
+        {"size", 0, true},
+    };
+
+    int failures = 0;
+    string path = translationCache->path({romHash(rom.data(), rom.size()), uint32_t(rom.size()), 0});
+    for (Damage const& damage : damages) {
+        Core(translationCache).loadRom(rom.data(), rom.size());
+        if (damage.truncate) {
+            filesystem::resize_file(path, fileSize - 1);
+        }
+        else {
+            fstream file{path, ios::in | ios::out | ios::binary};
+            file.seekg(damage.offset);
+            char byte = char(file.get() ^ 0x5A);
+            file.seekp(damage.offset);
+            file.put(byte);
+        }
+
+        {
+            Core rejected(translationCache);
+            rejected.loadRom(rom.data(), rom.size());
+            if (rejected.source() != TRANSLATION_STORED || rejected.rejected().empty()) {
+                cout << "TRANSLATION CACHE used a file with a damaged " << damage.what << endl;
+                failures++;
+            }
+        }
+        Core mapped(translationCache);
+        mapped.loadRom(rom.data(), rom.size());
+        if (mapped.source() != TRANSLATION_MAPPED) {
+            cout << "TRANSLATION CACHE did not replace a file with a damaged " << damage.what << endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// Display hash of test_opcode.ch8 after GOLDEN_FRAMES frames with no input
+// and the default quirks. The ROM draws an OK/error mark per OP code test.
+static int const GOLDEN_FRAMES = 120;
+static uint64_t const GOLDEN_HASH = 0x8F21671912C12851ull;
+
+int main(int argc, char* argv[]) {
+    Options options;
+    string romDir = "../roms";
+    int generated = 64;
+    int workloads = 8;
+    int blocks = 256;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "--roms" && i + 1 < argc) {
+            romDir = argv[++i];
+        }
+
+        if (arg == "--generated" && i + 1 < argc) {
+            generated = atoi(argv[++i]);
+        }
+
+        if (arg == "--workloads" && i + 1 < argc) {
+            workloads = atoi(argv[++i]);
+        }
+
+        if (arg == "--blocks" && i + 1 < argc) {
+            blocks = atoi(argv[++i]);
+        }
+
+        if (arg == "--frames" && i + 1 < argc) {
+            options.frames = atoi(argv[++i]);
+        }
+
+        if (arg == "--ipf" && i + 1 < argc) {
+            options.instructionsPerFrame = atoi(argv[++i]);
+        }
+
+        if (arg == "--per-frame") {
+            options.perInstruction = false;
+        }
+
+        if (arg == "--seed" && i + 1 < argc) {
+            options.inputSeed = strtoul(argv[++i], nullptr, 0);
+        }
+    }
+
+    int failures = 0;
+    int runs = 0;
+
+    // A scratch translation cache, so every run starts cold
+    string cacheDirectory = (filesystem::temp_directory_path() / ("chip8-difftest-" + to_string(getpid()))).string();
+    TranslationCache cache(cacheDirectory);
+    translationCache = &cache;
+
+    // Golden fixture
+    vector<uint8_t> rom;
+    if (readRom(romDir + "/test_opcode.ch8", rom)) {
+        Options golden = options;
+        golden.frames = GOLDEN_FRAMES;
+        golden.inputSeed = 0;
+        RuntimeQuirks::CP_SHIFT = RuntimeQuirks::SC_JUMP = RuntimeQuirks::COSMAC_MEM = false;
+        MachineState state{};
+        bool same = lockstep<Chip8<Quirks<false, false, false>>, Chip8<RuntimeQuirks>>("test_opcode.ch8 [golden]", rom, golden, &state);
+        runs++;
+        if (!same || state.frameHash != GOLDEN_HASH) {
+            cout << "GOLDEN MISMATCH test_opcode.ch8: frame hash 0x" << hex << state.frameHash
+                 << ", expected 0x" << GOLDEN_HASH << dec << endl;
+            failures++;
+        }
+    }
+    else {
+        cout << "Golden fixture " << romDir << "/test_opcode.ch8 not found" << endl;
+        failures++;
+    }
+
+    // ROM corpus
+    vector<string> paths;
+    if (filesystem::is_directory(romDir)) {
+        for (auto const& entry : filesystem::directory_iterator(romDir)) {
+            if (entry.path().extension() == ".ch8") {
+                paths.push_back(entry.path().string());
+            }
+        }
+    }
+    sort(paths.begin(), paths.end());
+    for (string const& path : paths) {
+        readRom(path, rom);
+        failures += compareAllProfiles(filesystem::path(path).filename().string(), rom, options, runs);
+    }
+
+    // Generated ROMs: a mix of everything, then each workload profile alone
+    RomGenConfig config;
+    config.blocks = blocks;
+    for (int seed = 1; seed <= generated; seed++) {
+        config.seed = seed;
+        rom = generateRom(config);
+        failures += compareAllProfiles("generated#" + to_string(seed), rom, options, runs);
+    }
+    for (int profile = ROM_DRAW; profile < ROM_PROFILES; profile++) {
+        for (int& weight : config.weights) {
+            weight = 0;
+        }
+        config.weights[profile] = 1;
+        for (int seed = 1; seed <= workloads; seed++) {
+            config.seed = seed;
+            rom = generateRom(config);
+            string name = string(romProfileName(RomProfile(profile))) + "#" + to_string(seed);
+            failures += compareAllProfiles(name, rom, options, runs);
+        }
+    }
+
+    // Translation cache fallback, on the last generated ROM
+    failures += checkTranslationFallback(rom);
+    runs++;
+    cout << translationSources[TRANSLATION_STORED] << " translations stored, "
+         << translationSources[TRANSLATION_MAPPED] << " mapped, "
+         << translationSources[TRANSLATION_DECODED] << " decoded without the cache" << endl;
+    filesystem::remove_all(cacheDirectory);
+
+    cout << runs << " runs, " << failures << " failed" << endl;
+    return failures ? 1 : 0;
+}
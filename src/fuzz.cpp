@@ -0,0 +1,385 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <string>
+#include <vector>
+#include "chip8.h"
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/common_interface_defs.h>
+#endif
+using namespace std;
+
+/**
+ * Persistent-mode fuzzer for the core
+ *
+ * Every input is loaded as a ROM into a core restored from a pristine copy,
+ * so there is no construction, allocation or file access between runs, and
+ * run for a bounded instruction budget with a key toggled every few frames.
+ * Guest edge coverage (previous pc to pc) is recorded in a 64K-bit bitmap;
+ * inputs that reach a new edge join the corpus, and mutations of the corpus
+ * are the next inputs.
+ *
+ * Before each instruction the harness checks for guest faults the core masks
+ * or wraps: CALL with a full stack, RET with an empty one, I-relative
+ * accesses past the end of memory and pc running off memory. The first input
+ * to raise each kind of fault is saved to --crashes, and the number of
+ * distinct faulting addresses is reported. Built with FLAVOR=asan, a
+ * memory error in the core aborts the run and the input is saved as
+ * asan-crash.ch8.
+ *
+ * Build with -DCHIP8_LIBFUZZER and -fsanitize=fuzzer to drive the same target
+ * from libFuzzer instead.
+ */
+
+enum Fault { NO_FAULT, STACK_OVERFLOW, STACK_UNDERFLOW, MEMORY_RANGE, PC_RANGE };
+static char const* const FAULT_NAMES[] = {"none", "stack-overflow", "stack-underflow", "memory-range", "pc-range"};
+
+static int const MAP_SIZE = 1 << 16; // Edges in the coverage bitmap
+static int const MAX_INPUT = 4096 - 0x200;
+
+struct Outcome {
+    Fault fault;
+    uint16_t pc; // Address of the faulting instruction
+    uint16_t instruction;
+    long instructions; // Executed before the run ended
+};
+
+/**
+ * One core and the coverage of the last input it ran
+ */
+template <typename Q>
+class FuzzTarget {
+    public:
+        uint64_t edges[MAP_SIZE / 64]; // Edges hit by the last input
+
+        FuzzTarget(long budget, int instructionsPerFrame) : budget(budget), instructionsPerFrame(instructionsPerFrame) {
+            pristine.loadFonts();
+        }
+
+        Outcome run(uint8_t const* data, size_t size) {
+            memset(edges, 0, sizeof(edges));
+            chip8 = pristine;
+            chip8.loadRom(data, min<size_t>(size, MAX_INPUT));
+
+            Outcome outcome = {NO_FAULT, 0, 0, 0};
+            uint32_t rng = 0x2545F491;
+            long executed = 0;
+            for (long frame = 0; executed < budget; frame++) {
+                if ((frame & 7) == 0) {
+                    rng ^= rng << 13;
+                    rng ^= rng >> 17;
+                    rng ^= rng << 5;
+                    chip8.keys ^= 1 << (rng & 0xF);
+                }
+                for (int i = 0; i < instructionsPerFrame; i++, executed++) {
+                    uint16_t from = chip8.pc;
+                    uint16_t instruction = (chip8.memory[from & 0xFFF] << 8) | chip8.memory[(from + 1) & 0xFFF];
+                    // Keep running after a fault, so a sanitizer build sees what the core does next
+                    Fault fault = outcome.fault == NO_FAULT ? check(instruction) : NO_FAULT;
+                    if (fault != NO_FAULT) {
+                        outcome = {fault, from, instruction, executed};
+                    }
+
+                    chip8.cycle();
+                    uint32_t edge = (((from & 0xFFF) * 0x9E3779B1u) >> 16 ^ (chip8.pc & 0xFFF)) & (MAP_SIZE - 1);
+                    edges[edge / 64] |= uint64_t(1) << (edge % 64);
+
+                    // A jump to itself never does anything else
+                    if (instruction == (0x1000 | from)) {
+                        return outcome;
+                    }
+                }
+                chip8.updateTimers();
+            }
+            return outcome;
+        }
+
+    private:
+        Fault check(uint16_t instruction) const {
+            uint8_t x = (instruction >> 8) & 0xF;
+            if (chip8.pc > 0xFFE) {
+                return PC_RANGE;
+            }
+            switch (instruction >> 12) {
+                case 0x0:
+                    return instruction == 0x00EE && chip8.sp == 0 ? STACK_UNDERFLOW : NO_FAULT;
+                case 0x2:
+                    return chip8.sp >= 16 ? STACK_OVERFLOW : NO_FAULT;
+                case 0xD:
+                    return chip8.I + (instruction & 0xF) > 0x1000 ? MEMORY_RANGE : NO_FAULT;
+                case 0xF:
+                    switch (instruction & 0xFF) {
+                        case 0x33: return chip8.I + 3 > 0x1000 ? MEMORY_RANGE : NO_FAULT;
+                        case 0x55:
+                        case 0x65: return chip8.I + x + 1 > 0x1000 ? MEMORY_RANGE : NO_FAULT;
+                    }
+                    return NO_FAULT;
+            }
+            return NO_FAULT;
+        }
+
+        long budget;
+        int instructionsPerFrame;
+        Chip8<Q> pristine;
+        Chip8<Q> chip8;
+};
+
+#if defined(CHIP8_LIBFUZZER)
+
+extern "C" int LLVMFuzzerTestOneInput(uint8_t const* data, size_t size) {
+    static FuzzTarget<Quirks<false, false, false>>* target = new FuzzTarget<Quirks<false, false, false>>(10000, 11);
+    target->run(data, size);
+    return 0;
+}
+
+#else
+
+struct Options {
+    string corpusDir = "../roms";
+    string crashDir = "fuzz-crashes";
+    long runs = 0; // 0 for no limit
+    double seconds = 60;
+    long budget = 10000; // Instructions per input
+    int instructionsPerFrame = 11;
+    uint32_t seed = 1;
+};
+
+// Instructions the mutator likes to plant: subroutine and stack edges, and
+// I-relative accesses near the end of memory
+static uint16_t const DICTIONARY[] = {
+    0x00EE, 0x00E0, 0x2200, 0x2202, 0x1200, 0xAFFF, 0xAFF8, 0xAF00,
+    0xF01E, 0xFF1E, 0xF033, 0xF055, 0xFF55, 0xF065, 0xFF65, 0xD00F,
+    0xD01F, 0xF00A, 0xB0FF, 0xBFFF, 0x60FF, 0x6F00, 0xE09E, 0xE0A1,
+};
+
+static vector<uint8_t> const* crashInput = nullptr;
+static string crashPath;
+
+#if defined(__SANITIZE_ADDRESS__)
+static void saveCrashInput() {
+    if (crashInput) {
+        ofstream file{crashPath, ios::binary};
+        file.write(reinterpret_cast<char const*>(crashInput->data()), crashInput->size());
+        cerr << "Input saved to " << crashPath << endl;
+    }
+}
+#endif
+
+/**
+ * CHIP-8 aware mutator: instructions are 2 bytes at even offsets, so most
+ * mutations work on whole instructions
+ */
+struct Mutator {
+    uint32_t state;
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    void mutate(vector<uint8_t>& input, vector<vector<uint8_t>> const& corpus) {
+        int count = 1 + (next() & 7);
+        for (int m = 0; m < count; m++) {
+            if (input.size() < 2) {
+                input.resize(2);
+            }
+            size_t words = input.size() / 2;
+            size_t at = (next() % words) * 2;
+            uint16_t word = next() & 0xFFFF;
+            switch (next() % 8) {
+                case 0: // Flip a bit
+                    input[next() % input.size()] ^= 1 << (next() & 7);
+                    break;
+                case 1: // Add to a byte
+                    input[next() % input.size()] += int8_t(next() % 33) - 16;
+                    break;
+                case 2: // Random instruction
+                    input[at] = word >> 8;
+                    input[at + 1] = word & 0xFF;
+                    break;
+                case 3: // Instruction from the dictionary, keeping its low byte random half the time
+                    word = DICTIONARY[next() % size(DICTIONARY)] ^ (next() & 1 ? 0 : word & 0x00F0);
+                    input[at] = word >> 8;
+                    input[at + 1] = word & 0xFF;
+                    break;
+                case 4: // Insert an instruction
+                    if (input.size() + 2 <= MAX_INPUT) {
+                        input.insert(input.begin() + at, {uint8_t(word >> 8), uint8_t(word & 0xFF)});
+                    }
+                    break;
+                case 5: // Delete an instruction
+                    if (input.size() > 2) {
+                        input.erase(input.begin() + at, input.begin() + at + 2);
+                    }
+                    break;
+                case 6: { // Splice in a chunk of another input
+                    vector<uint8_t> const& other = corpus[next() % corpus.size()];
+                    if (other.size() >= 2) {
+                        size_t from = (next() % (other.size() / 2)) * 2;
+                        size_t length = min<size_t>({other.size() - from, input.size() - at, 2 + (next() % 32) * 2});
+                        copy(other.begin() + from, other.begin() + from + length, input.begin() + at);
+                    }
+                    break;
+                }
+                default: // Retarget a jump or call to another instruction of the input
+                    word = 0x200 + (next() % words) * 2;
+                    input[at] = (next() & 1 ? 0x10 : 0x20) | (word >> 8);
+                    input[at + 1] = word & 0xFF;
+                    break;
+            }
+        }
+    }
+};
+
+template <typename Q>
+int fuzz(Options const& options) {
+    FuzzTarget<Q> target(options.budget, options.instructionsPerFrame);
+    vector<uint64_t> covered(MAP_SIZE / 64);
+    vector<vector<uint8_t>> corpus;
+    set<pair<int, uint16_t>> faults;
+    long sites[size(FAULT_NAMES)] = {}; // Distinct faulting addresses per kind
+    long edges = 0;
+    long instructions = 0; // Executed by the mutated inputs
+    filesystem::create_directories(options.crashDir);
+
+    crashPath = options.crashDir + "/asan-crash.ch8";
+#if defined(__SANITIZE_ADDRESS__)
+    __sanitizer_set_death_callback(saveCrashInput);
+#endif
+
+    // Returns true if the input reached an edge no earlier input did
+    auto execute = [&](vector<uint8_t> const& input) {
+        crashInput = &input;
+        Outcome outcome = target.run(input.data(), input.size());
+        instructions += outcome.instructions;
+        bool interesting = false;
+        for (size_t w = 0; w < covered.size(); w++) {
+            uint64_t fresh = target.edges[w] & ~covered[w];
+            if (fresh) {
+                covered[w] |= fresh;
+                edges += __builtin_popcountll(fresh);
+                interesting = true;
+            }
+        }
+
+        if (outcome.fault != NO_FAULT && faults.insert({outcome.fault, outcome.pc}).second &&
+            sites[outcome.fault]++ == 0) {
+            string name = options.crashDir + "/" + FAULT_NAMES[outcome.fault] + ".ch8";
+            ofstream file{name, ios::binary};
+            file.write(reinterpret_cast<char const*>(input.data()), input.size());
+            cout << FAULT_NAMES[outcome.fault] << " at 0x" << hex << uppercase << setfill('0') << setw(3) << outcome.pc
+                 << " (" << setw(4) << outcome.instruction << ") after " << dec << outcome.instructions
+                 << " instructions, saved " << name << setfill(' ') << nouppercase << endl;
+        }
+        return interesting;
+    };
+
+    if (filesystem::is_directory(options.corpusDir)) {
+        vector<string> paths;
+        for (auto const& entry : filesystem::directory_iterator(options.corpusDir)) {
+            if (entry.path().extension() == ".ch8") {
+                paths.push_back(entry.path().string());
+            }
+        }
+        sort(paths.begin(), paths.end());
+        for (string const& path : paths) {
+            ifstream file{path, ios::binary};
+            vector<uint8_t> rom{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+            rom.resize(min<size_t>(rom.size(), MAX_INPUT));
+            execute(rom);
+            corpus.push_back(rom);
+        }
+    }
+    if (corpus.empty()) {
+        corpus.push_back({0x12, 0x00});
+        execute(corpus.back());
+    }
+    cout << "Seeded " << corpus.size() << " inputs, " << edges << " edges" << endl;
+
+    Mutator mutator{options.seed ? options.seed : 1};
+    vector<uint8_t> input;
+    long runs = 0;
+    instructions = 0;
+    auto start = chrono::steady_clock::now();
+    auto lastReport = start;
+    double elapsed = 0;
+    while ((options.runs == 0 || runs < options.runs) && elapsed < options.seconds) {
+        input = corpus[mutator.next() % corpus.size()];
+        mutator.mutate(input, corpus);
+        if (execute(input)) {
+            corpus.push_back(input);
+        }
+        runs++;
+
+        // Check the clock every 256 runs only
+        if ((runs & 255) == 0 || runs == options.runs) {
+            auto now = chrono::steady_clock::now();
+            elapsed = chrono::duration<double>(now - start).count();
+            if (now - lastReport > chrono::seconds(5)) {
+                lastReport = now;
+                cout << "#" << runs << fixed << setprecision(0) << "  " << runs / elapsed << " execs/s  "
+                     << setprecision(1) << instructions / elapsed / 1e6 << "M instructions/s  corpus "
+                     << corpus.size() << "  edges " << edges << "  faults " << faults.size() << endl;
+            }
+        }
+    }
+    crashInput = nullptr;
+    elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << runs << " runs in " << fixed << setprecision(1) << elapsed << "s, " << setprecision(0)
+         << runs / elapsed << " execs/s, " << setprecision(1) << instructions / elapsed / 1e6
+         << "M instructions/s, corpus " << corpus.size() << ", " << edges << " edges, "
+         << faults.size() << " faulting addresses" << endl;
+    for (int fault = STACK_OVERFLOW; fault <= PC_RANGE; fault++) {
+        cout << "  " << left << setw(16) << FAULT_NAMES[fault] << right << setw(6) << sites[fault] << endl;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    bool cpShift = false;
+    bool scJump = false;
+    bool cosmacMem = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "--cp_shift") cpShift = true;
+        else if (arg == "--sc_jump") scJump = true;
+        else if (arg == "--cosmac_mem") cosmacMem = true;
+        else if (arg == "--corpus" && i + 1 < argc) options.corpusDir = argv[++i];
+        else if (arg == "--crashes" && i + 1 < argc) options.crashDir = argv[++i];
+        else if (arg == "--runs" && i + 1 < argc) options.runs = atol(argv[++i]);
+        else if (arg == "--seconds" && i + 1 < argc) options.seconds = atof(argv[++i]);
+        else if (arg == "--budget" && i + 1 < argc) options.budget = atol(argv[++i]);
+        else if (arg == "--ipf" && i + 1 < argc) options.instructionsPerFrame = atoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) options.seed = strtoul(argv[++i], nullptr, 0);
+        else {
+            cerr << "Usage: " << argv[0] << " [--corpus ../roms] [--crashes fuzz-crashes] [--runs N] [--seconds 60]"
+                 << " [--budget 10000] [--ipf 11] [--seed 1] [--cp_shift] [--sc_jump] [--cosmac_mem]" << endl;
+            return 1;
+        }
+    }
+
+    if (options.budget <= 0 || options.instructionsPerFrame <= 0) {
+        cerr << "--budget and --ipf must be positive integers" << endl;
+        return 1;
+    }
+
+    return withQuirks(cpShift, scJump, cosmacMem, [&](auto quirks) {
+        return fuzz<decltype(quirks)>(options);
+    });
+}
+
+#endif
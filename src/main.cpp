@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "chip8.h"
+#include "AudioPacer.h"
+#include "PerfCounters.h"
+#include "QuirkDetect.h"
+#include "Recorder.h"
+#include "Trace.h"
+#include "Window.h"
+using namespace std;
+
+/**
+ * Command-line options
+ */
+struct Options {
+    string rom;
+    bool cp_shift = false;   // Set true for alternate implementation of OP_8xy6 and OP_8xyE
+    bool sc_jump = false;    // Set true for alternate implementation of OP_Bnnn
+    bool cosmac_mem = false; // Set true for alternate implementation of OP_Fx55 and OP_Fx65
+    bool auto_quirks = false; // Pick the three quirk flags by running the ROM under each profile
+    int scale = 20;          // Scaling for window size
+    int speed = 700;         // Speed of the emulator
+    bool vip_timing = false; // Set true to charge COSMAC VIP cycle costs instead of a flat speed
+    string record;           // Record gameplay to this file
+    bool record_raw = false; // Also export the recording as Y4M video and WAV audio
+    string trace;            // Write a binary trace to this file
+    string trace_categories = "draw,frame,input"; // Trace categories to record
+    bool perf_counters = false; // Read host performance counters around the execution loop
+    int run_ahead = 0;       // Present the display this many frames ahead of the input
+    bool audio_sync = false; // Pace frames by the audio device's clock instead of the system clock
+    int audio_latency = 50;  // Audio queued ahead with audio_sync, in milliseconds
+};
+
+/**
+ * Run the emulator until the window is closed
+ *
+ * Emulation advances one 60Hz frame at a time: either a flat number of
+ * instructions per frame, or as many as fit in a frame of COSMAC VIP time.
+ *
+ * With run-ahead, each frame also copies the core and runs the copy
+ * options.run_ahead frames further with the keys held now. The copy's display
+ * and beep are presented and the copy is then dropped, so a ROM that reacts
+ * to input a few frames late shows the reaction on the next frame. The
+ * recording, the trace and the perf counters only see the real frames.
+ *
+ * With audio sync, each frame queues its samples of the beep (or silence) and
+ * AudioPacer sets the time to the next frame from the audio queue's fill
+ * level, so emulation follows the sound card's clock instead of the system's.
+ *
+ * @param options - Parsed command-line options
+ */
+template <typename Q>
+int run(Options const& options) {
+    Chip8<Q> chip8;
+    Window window(Chip8<Q>::WIDTH, Chip8<Q>::HEIGHT, options.scale, options.audio_sync);
+
+    if (!chip8.loadRom(options.rom)) {
+        return 1;
+    }
+    chip8.loadFonts();
+
+    unique_ptr<Recorder> recorder;
+    if (!options.record.empty()) {
+        recorder = make_unique<Recorder>(options.record, options.record_raw);
+        if (!recorder->isOpen()) {
+            return 1;
+        }
+    }
+
+    if (options.perf_counters && !PerfCounters::start()) {
+        cout << "No hardware performance counters on this host; --perf_counters reports time only" << endl;
+    }
+
+    auto const framePeriod = chrono::nanoseconds(1000000000 / 60);
+    auto start = chrono::steady_clock::now();
+    auto nextFrame = start;
+    long frame = 0;
+
+    // Spread speed instructions per second evenly over 60 frames
+    auto frameInstructions = [&](long n) {
+        return int((n + 1) * options.speed / 60 - n * options.speed / 60);
+    };
+
+    AudioPacer pacer(Window::AUDIO_RATE, Window::AUDIO_RATE * options.audio_latency / 1000);
+    if (options.audio_sync) {
+        // Start with the target latency queued, as silence
+        window.queueAudio(pacer.target());
+    }
+
+    Chip8<Q> ahead;
+    uint64_t presented[Chip8<Q>::HEIGHT] = {};
+    chrono::duration<double> snapshotTime{0};
+    chrono::duration<double> aheadTime{0};
+
+    bool quit = false;
+    while (!quit) {
+        if (Trace::enabled(TRACE_INPUT)) {
+            uint16_t previous = chip8.keys;
+            quit = window.processInput(chip8.keys);
+            for (int k = 0; k < 16; k++) {
+                if (((chip8.keys ^ previous) >> k) & 1) {
+                    Trace::input(k, chip8.key(k));
+                }
+            }
+        }
+        else {
+            quit = window.processInput(chip8.keys);
+        }
+
+        // Does nothing without --perf_counters
+        PerfCounters::beginFrame();
+        int executed;
+        if (options.vip_timing) {
+            executed = chip8.runFrameVip();
+        }
+        else {
+            executed = frameInstructions(frame);
+            chip8.runFrame(executed);
+        }
+        PerfCounters::endFrame(executed);
+        frame++;
+
+        Chip8<Q> const* shown = &chip8;
+        if (options.run_ahead > 0) {
+            auto snapshotStart = chrono::steady_clock::now();
+            ahead = chip8;
+            auto aheadStart = chrono::steady_clock::now();
+            uint8_t categories = Trace::pause();
+            for (int n = 0; n < options.run_ahead; n++) {
+                if (options.vip_timing) {
+                    ahead.runFrameVip();
+                }
+                else {
+                    ahead.runFrame(frameInstructions(frame + n));
+                }
+            }
+            Trace::resume(categories);
+            snapshotTime += aheadStart - snapshotStart;
+            aheadTime += chrono::steady_clock::now() - aheadStart;
+            shown = &ahead;
+
+            // The speculative display can change without a draw, when this
+            // frame's guess differs from the last one
+            if (memcmp(ahead.display, presented, sizeof(presented)) != 0) {
+                memcpy(presented, ahead.display, sizeof(presented));
+                window.update(presented);
+            }
+            chip8.drawFlag = false;
+        }
+        else if (chip8.drawFlag) {
+            window.update(chip8.display);
+            chip8.drawFlag = false;
+        }
+
+        if (shown->soundTimer > 0) {
+            window.startBeep();
+        }
+        else {
+            window.stopBeep();
+        }
+
+        if (recorder) {
+            recorder->push(chip8.display, chip8.soundTimer > 0);
+        }
+
+        if (options.audio_sync) {
+            window.queueAudio(pacer.frameSamples());
+            nextFrame += pacer.framePeriod(window.queuedSamples());
+            // After a stall, e.g. a dragged window, resume instead of racing to catch up
+            nextFrame = max(nextFrame, chrono::steady_clock::now() - framePeriod);
+        }
+        else {
+            nextFrame += framePeriod;
+        }
+        this_thread::sleep_until(nextFrame);
+    }
+
+    if (options.perf_counters) {
+        PerfCounters::stop();
+        PerfCounters::report(cout);
+    }
+
+    if (options.run_ahead > 0 && frame > 0) {
+        double snapshot = snapshotTime.count() / frame * 1e6;
+        double speculative = aheadTime.count() / frame * 1e6;
+        cout << "Run-ahead of " << options.run_ahead << " frames took " << snapshot + speculative
+             << " us per frame (snapshot " << snapshot << " us, speculative frames " << speculative << " us), "
+             << 100 * (snapshot + speculative) / (1e6 / 60) << "% of the 60Hz frame budget" << endl;
+    }
+
+    if (options.audio_sync && pacer.frames > 0) {
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Audio sync: " << pacer.frames / elapsed << " frames/s, audio queue averaged "
+             << pacer.fillSum / pacer.frames * 1000 / pacer.rate() << " ms for a target of "
+             << pacer.target() * 1000 / pacer.rate() << " ms, frame period adjusted by "
+             << pacer.minAdjustment * 100 << "% to " << pacer.maxAdjustmentSeen * 100 << "%, "
+             << pacer.underruns << " underruns, " << pacer.catchUps << " hard corrections" << endl;
+    }
+
+    if (recorder) {
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        double pushSeconds = recorder->pushSeconds();
+        uint64_t captured = recorder->framesCaptured();
+        uint64_t dropped = recorder->framesDropped();
+        recorder.reset(); // Drain the queue and close the files
+        cout << "Recorded " << captured - dropped << " of " << captured << " frames to " << options.record
+             << " (" << dropped << " dropped); recording used " << 100 * pushSeconds / elapsed
+             << "% of the emulation thread" << endl;
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    cout << "Starting..." << endl;
+
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <rom> [--cp_shift] [--sc_jump] [--cosmac_mem] [--auto_quirks] [--scale <value>] [--speed <value>] [--vip_timing] [--record <file> [--record_raw]] [--trace <file> [--trace_categories <list>]] [--perf_counters] [--run_ahead <frames>] [--audio_sync [--audio_latency <ms>]]" << endl;
+        return 1;
+    }
+
+    Options options;
+    options.rom = argv[1];
+
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "--cp_shift") {
+            options.cp_shift = true;
+        }
+
+        if (arg == "--sc_jump") {
+            options.sc_jump = true;
+        }
+
+        if (arg == "--cosmac_mem") {
+            options.cosmac_mem = true;
+        }
+
+        if (arg == "--auto_quirks") {
+            options.auto_quirks = true;
+        }
+
+        if (arg == "--vip_timing") {
+            options.vip_timing = true;
+        }
+
+        if (arg == "--scale" && i + 1 < argc) {
+            options.scale = atoi(argv[++i]);
+        }
+
+        if (arg == "--speed" && i + 1 < argc) {
+            options.speed = atoi(argv[++i]);
+        }
+
+        if (arg == "--record" && i + 1 < argc) {
+            options.record = argv[++i];
+        }
+
+        if (arg == "--record_raw") {
+            options.record_raw = true;
+        }
+
+        if (arg == "--trace" && i + 1 < argc) {
+            options.trace = argv[++i];
+        }
+
+        if (arg == "--trace_categories" && i + 1 < argc) {
+            options.trace_categories = argv[++i];
+        }
+
+        if (arg == "--perf_counters") {
+            options.perf_counters = true;
+        }
+
+        if (arg == "--run_ahead" && i + 1 < argc) {
+            options.run_ahead = atoi(argv[++i]);
+        }
+
+        if (arg == "--audio_sync") {
+            options.audio_sync = true;
+        }
+
+        if (arg == "--audio_latency" && i + 1 < argc) {
+            options.audio_latency = atoi(argv[++i]);
+        }
+    }
+
+    if (options.scale <= 0 || options.speed <= 0) {
+        cerr << "--scale and --speed must be positive integers" << endl;
+        return 1;
+    }
+
+    if (options.audio_latency < 20 || options.audio_latency > 1000) {
+        cerr << "--audio_latency takes 20 to 1000 milliseconds" << endl;
+        return 1;
+    }
+
+    if (options.run_ahead < 0) {
+        cerr << "--run_ahead takes a number of frames" << endl;
+        return 1;
+    }
+
+    if (!options.trace.empty()) {
+        uint8_t categories = Trace::parseCategories(options.trace_categories);
+        if (!categories) {
+            cerr << "--trace_categories takes a list of instruction, draw, frame, input or all" << endl;
+            return 1;
+        }
+        if (!Trace::start(options.trace, categories)) {
+            return 1;
+        }
+    }
+
+    if (options.auto_quirks) {
+        ifstream file{options.rom, ios::binary};
+        vector<uint8_t> rom{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+        if (!rom.empty()) {
+            QuirkDetection detection = detectQuirksCached(rom.data(), rom.size());
+            options.cp_shift = detection.flags.cpShift;
+            options.sc_jump = detection.flags.scJump;
+            options.cosmac_mem = detection.flags.cosmacMem;
+            cout << "Quirks: " << detection.flags.describe() << (detection.cached ? " (cached, " : " (detected in ")
+                 << detection.seconds * 1000 << " ms)" << endl;
+        }
+    }
+
+    // Pick the specialized core once; the loop never tests the quirk flags
+    int status = withQuirks(options.cp_shift, options.sc_jump, options.cosmac_mem, [&](auto quirks) {
+        return run<decltype(quirks)>(options);
+    });
+
+    if (!options.trace.empty()) {
+        Trace::stop();
+        cout << "Traced " << Trace::recordsWritten() << " records to " << options.trace
+             << " (" << Trace::recordsDropped() << " dropped)" << endl;
+    }
+    return status;
+}
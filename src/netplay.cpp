@@ -0,0 +1,211 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Netplay.h"
+#include "Search.h"
+using namespace std;
+
+/**
+ * Headless rollback netplay peer
+ *
+ * Plays one keypad half of a two-player session against another chip8-netplay
+ * over UDP, with scripted input, at 60 frames per second. --latency, --jitter
+ * and --loss impair the packets this peer sends. After --frames frames both
+ * peers wait until they have each other's input for every frame, then print
+ * the final state hash. Each peer also replays both players' scripts offline
+ * without prediction and checks the rollback run ended in the same state.
+ *
+ * On loopback:
+ *   ./chip8-netplay rom.ch8 --player 1 --port 7001 --peer 127.0.0.1:7002 --latency 40 --loss 0.1 &
+ *   ./chip8-netplay rom.ch8 --player 2 --port 7002 --peer 127.0.0.1:7001 --latency 40 --loss 0.1
+ */
+
+/**
+ * Keys a player holds in each frame: every 6 frames a key of their half is
+ * pressed or released, and now and then everything is released
+ */
+static vector<uint16_t> scriptKeys(uint16_t mask, uint32_t seed, uint32_t frames) {
+    vector<uint16_t> keys(frames);
+    uint16_t held = 0;
+    for (uint32_t f = 0; f < frames; f++) {
+        if (f % 6 == 0) {
+            uint32_t r = (seed + f / 6) * 0x9E3779B9u;
+            r ^= r >> 15;
+            r *= 0x85EBCA6Bu;
+            r ^= r >> 13;
+            held = r % 16 == 0 ? 0 : held ^ (1 << ((r >> 8) % 16));
+        }
+        keys[f] = held & mask;
+    }
+    return keys;
+}
+
+template <typename Q>
+int play(vector<uint8_t> const& rom, uint32_t session, uint32_t frames, uint32_t inputSeed,
+         RollbackConfig const& rollbackConfig, NetplayConfig const& config) {
+    Chip8<Q> start;
+    start.loadRom(rom.data(), rom.size());
+    start.loadFonts();
+
+    NetplaySession<Q> netplay(start, session, rollbackConfig, config);
+    string error;
+    if (!netplay.open(error)) {
+        cerr << error << endl;
+        return 1;
+    }
+
+    vector<uint16_t> scripts[2];
+    for (int player = 0; player < 2; player++) {
+        scripts[player] = scriptKeys(PLAYER_KEYS[player], inputSeed * 2 + player, frames);
+    }
+
+    auto const framePeriod = chrono::nanoseconds(1000000000 / 60);
+    auto begin = chrono::steady_clock::now();
+    auto nextFrame = begin;
+    auto lastProgress = begin;
+    while (netplay.simulation().currentFrame() < frames) {
+        if (netplay.tick(scripts[config.player][netplay.simulation().currentFrame()])) {
+            lastProgress = nextFrame;
+        }
+        else if (nextFrame - lastProgress > chrono::seconds(10)) {
+            cerr << "No input from the peer for 10s";
+            if (netplay.stats().foreignPackets) {
+                cerr << "; it sent " << netplay.stats().foreignPackets
+                     << " packets for another session (ROM, quirks, --speed or --vip_timing differ)";
+            }
+            cerr << endl;
+            return 2;
+        }
+        nextFrame += framePeriod;
+        this_thread::sleep_until(nextFrame);
+    }
+
+    // Keep exchanging packets until both sides have every input, then a
+    // second more so the last acknowledgements get through
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(10);
+    int linger = 60;
+    while (linger > 0 && chrono::steady_clock::now() < deadline) {
+        netplay.tick(0, false);
+        linger -= netplay.settled(frames);
+        nextFrame += framePeriod;
+        this_thread::sleep_until(nextFrame);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+    // The same inputs without a network or prediction
+    Chip8<Q> offline = start;
+    for (uint32_t f = 0; f < frames; f++) {
+        offline.keys = scripts[0][f] | scripts[1][f];
+        int64_t speed = rollbackConfig.speed;
+        if (rollbackConfig.vipTiming) {
+            offline.runFrameVip();
+        }
+        else {
+            offline.runFrame(int((f + 1) * speed / 60 - f * speed / 60));
+        }
+    }
+
+    RollbackStats const& rollback = netplay.simulation().stats();
+    NetplayStats const& stats = netplay.stats();
+    UdpLink const& link = netplay.connection();
+    uint64_t finalHash = 0;
+    bool settled = netplay.settled(frames) && netplay.simulation().checksum(frames, finalHash);
+    bool matches = settled && finalHash == InputSearch<Q>::stateHash(offline);
+
+    cout << fixed << setprecision(1)
+         << "player " << config.player + 1 << ": " << frames << " frames in " << seconds << "s, "
+         << stats.stalls << " stalled" << endl
+         << "  rollbacks " << rollback.rollbacks << ", " << rollback.resimulatedFrames << " frames re-run, deepest "
+         << rollback.maxDepth << "; " << setprecision(2)
+         << (rollback.rollbacks ? rollback.rollbackSeconds / rollback.rollbacks * 1e6 : 0) << " us average, "
+         << rollback.maxRollbackSeconds * 1e6 << " us worst, against a 16667 us frame" << endl
+         << "  packets sent " << link.sent << ", dropped by the shim " << link.dropped << ", received "
+         << stats.packetsReceived << "; " << stats.checksumsCompared << " checksums compared" << endl;
+    if (!settled) {
+        cout << "  NOT SETTLED: the peer did not confirm every frame" << endl;
+        return 2;
+    }
+    cout << "  final state 0x" << hex << finalHash << dec
+         << (matches ? ", matches the offline run" : ", DIFFERS from the offline run") << endl;
+    if (stats.desynced) {
+        cout << "  DESYNC: checksums differ from frame " << stats.desyncFrame << endl;
+    }
+    return matches && !stats.desynced ? 0 : 3;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <rom> --player 1|2 [--port 7001] [--peer 127.0.0.1:7002] [--frames 600]"
+             << " [--latency <ms>] [--jitter <ms>] [--loss <0-1>] [--prediction 8] [--seed 1] [--speed 700]"
+             << " [--vip_timing] [--cp_shift] [--sc_jump] [--cosmac_mem]" << endl;
+        return 1;
+    }
+
+    string path = argv[1];
+    bool cpShift = false;
+    bool scJump = false;
+    bool cosmacMem = false;
+    uint32_t frames = 600;
+    uint32_t inputSeed = 1;
+    RollbackConfig rollbackConfig;
+    NetplayConfig config;
+    config.player = -1;
+
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "--cp_shift") cpShift = true;
+        else if (arg == "--sc_jump") scJump = true;
+        else if (arg == "--cosmac_mem") cosmacMem = true;
+        else if (arg == "--vip_timing") rollbackConfig.vipTiming = true;
+        else if (arg == "--player" && i + 1 < argc) config.player = atoi(argv[++i]) - 1;
+        else if (arg == "--port" && i + 1 < argc) config.port = atoi(argv[++i]);
+        else if (arg == "--peer" && i + 1 < argc) {
+            string peer = argv[++i];
+            size_t colon = peer.rfind(':');
+            if (colon == string::npos) {
+                cerr << "--peer takes host:port" << endl;
+                return 1;
+            }
+            config.peerHost = peer.substr(0, colon);
+            config.peerPort = atoi(peer.c_str() + colon + 1);
+        }
+        else if (arg == "--frames" && i + 1 < argc) frames = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--latency" && i + 1 < argc) config.latencyMs = atoi(argv[++i]);
+        else if (arg == "--jitter" && i + 1 < argc) config.jitterMs = atoi(argv[++i]);
+        else if (arg == "--loss" && i + 1 < argc) config.loss = atof(argv[++i]);
+        else if (arg == "--prediction" && i + 1 < argc) rollbackConfig.maxPrediction = atoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) inputSeed = strtoul(argv[++i], nullptr, 0);
+        else if (arg == "--speed" && i + 1 < argc) rollbackConfig.speed = atoi(argv[++i]);
+    }
+
+    if (config.player != 0 && config.player != 1) {
+        cerr << "--player takes 1 or 2" << endl;
+        return 1;
+    }
+    if (rollbackConfig.speed <= 0 || frames == 0) {
+        cerr << "--speed and --frames must be positive integers" << endl;
+        return 1;
+    }
+    // The shim's randomness differs per player, so both directions are not lost alike
+    config.seed = inputSeed * 2 + config.player;
+
+    ifstream file{path, ios::binary};
+    vector<uint8_t> rom{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+    if (rom.empty()) {
+        cerr << "Unable to read " << path << endl;
+        return 1;
+    }
+
+    int profile = cpShift << 2 | scJump << 1 | int(cosmacMem);
+    uint32_t session = netplaySession(rom.data(), rom.size(), profile, rollbackConfig);
+    return withQuirks(cpShift, scJump, cosmacMem, [&](auto quirks) {
+        return play<decltype(quirks)>(rom, session, frames, inputSeed, rollbackConfig, config);
+    });
+}
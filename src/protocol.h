@@ -0,0 +1,70 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstdint>
+
+/**
+ * Wire protocol between chip8-server and its viewers
+ *
+ * Every message is a MessageHeader followed by `length` bytes of payload.
+ * Integers are in host byte order: both ends are on the same host, joined
+ * by a Unix socket.
+ *
+ * Viewer -> server:
+ *   MSG_START  StartMessage followed by the ROM image. Creates the session.
+ *   MSG_KEY    KeyMessage. Presses or releases one key of the keypad.
+ *
+ * Server -> viewer:
+ *   MSG_FRAME  FrameMessage followed by 8 bytes for every bit set in
+ *              rowMask, in row order. Only rows that changed since the last
+ *              FRAME are sent; the first FRAME of a session carries every row.
+ *   MSG_ERROR  Human-readable reason, after which the server closes the socket.
+ */
+
+#define CHIP8_SOCKET_PATH "/tmp/chip8.sock"
+
+enum MessageType : uint8_t {
+    MSG_START = 1,
+    MSG_KEY = 2,
+    MSG_FRAME = 3,
+    MSG_ERROR = 4,
+};
+
+#pragma pack(push, 1)
+
+struct MessageHeader {
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t length; // Payload bytes after the header
+};
+
+enum StartFlags : uint8_t {
+    START_CP_SHIFT = 1 << 0,
+    START_SC_JUMP = 1 << 1,
+    START_COSMAC_MEM = 1 << 2,
+    START_VIP_TIMING = 1 << 3,
+};
+
+struct StartMessage {
+    uint8_t flags; // StartFlags
+    uint8_t reserved;
+    uint16_t speed; // Instructions per second in flat-rate mode
+};
+
+struct KeyMessage {
+    uint8_t key; // 0x0 - 0xF
+    uint8_t pressed;
+};
+
+struct FrameMessage {
+    uint32_t frame; // Frame number since the session started
+    uint32_t rowMask; // Bit y is set if row y follows
+    uint8_t delayTimer;
+    uint8_t soundTimer; // The viewer beeps while this is non-zero
+};
+
+#pragma pack(pop)
+
+static int const MAX_MESSAGE = sizeof(MessageHeader) + 0xFFFF;
+
+#endif
@@ -0,0 +1,136 @@
+#include <cctype>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "Search.h"
+using namespace std;
+
+/**
+ * Input search over the headless core
+ *
+ * Runs the ROM for --skip frames with no input, then searches for the
+ * shortest sequence of held keys, in steps of --hold frames, that reaches
+ * the goal: a debugger condition (--goal "PC == 0x2F0 && V3 > 2"), a display
+ * (--frame-hash), or both. Prints the inputs as runs of frames.
+ */
+
+static string keyList(uint16_t mask) {
+    if (mask == 0) {
+        return "-";
+    }
+    string list;
+    for (int key = 0; key < 16; key++) {
+        if (mask & (1 << key)) {
+            list += "0123456789ABCDEF"[key];
+        }
+    }
+    return list;
+}
+
+template <typename Q>
+int search(string const& rom, int skipFrames, SearchConfig const& config, SearchGoal const& goal) {
+    Chip8<Q> chip8;
+    if (!chip8.loadRom(rom)) {
+        return 1;
+    }
+    chip8.loadFonts();
+    for (int frame = 0; frame < skipFrames; frame++) {
+        chip8.runFrame(config.instructionsPerFrame);
+    }
+
+    InputSearch<Q> search(config);
+    SearchResult result = search.run(chip8, goal);
+
+    if (result.found) {
+        cout << "Found after " << result.inputs.size() << " frames" << endl;
+    }
+    else {
+        cout << "Not found within " << result.depth << " steps" << endl;
+    }
+    cout << result.states << " states, " << result.duplicates << " duplicates pruned, "
+         << result.dropped << " dropped, " << fixed << setprecision(2) << result.seconds << "s, "
+         << setprecision(0) << result.states / result.seconds << " states/s" << endl;
+
+    // Frame numbers count from the end of --skip
+    for (size_t first = 0; first < result.inputs.size();) {
+        size_t last = first;
+        while (last + 1 < result.inputs.size() && result.inputs[last + 1] == result.inputs[first]) {
+            last++;
+        }
+        cout << "frames " << setw(5) << first << "-" << setw(5) << left << last << right
+             << " keys " << keyList(result.inputs[first]) << endl;
+        first = last + 1;
+    }
+    return result.found ? 0 : 2;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <rom> [--goal <expression>] [--frame-hash <hash>] [--keys <hex digits>]"
+             << " [--hold 6] [--depth 200] [--frontier 20000] [--skip <frames>] [--ipf 11] [--threads N]"
+             << " [--per-frame] [--cp_shift] [--sc_jump] [--cosmac_mem]" << endl;
+        return 1;
+    }
+
+    string rom = argv[1];
+    bool cpShift = false;
+    bool scJump = false;
+    bool cosmacMem = false;
+    string keys = "0123456789ABCDEF";
+    int skipFrames = 0;
+    SearchConfig config;
+    SearchGoal goal;
+
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "--cp_shift") cpShift = true;
+        else if (arg == "--sc_jump") scJump = true;
+        else if (arg == "--cosmac_mem") cosmacMem = true;
+        else if (arg == "--goal" && i + 1 < argc) {
+            string error;
+            if (!goal.condition.parse(argv[++i], error)) {
+                cerr << "Invalid --goal: " << error << endl;
+                return 1;
+            }
+            goal.hasCondition = true;
+        }
+        else if (arg == "--frame-hash" && i + 1 < argc) {
+            goal.frameHash = strtoull(argv[++i], nullptr, 0);
+            goal.hasFrameHash = true;
+        }
+        else if (arg == "--keys" && i + 1 < argc) keys = argv[++i];
+        else if (arg == "--hold" && i + 1 < argc) config.holdFrames = atoi(argv[++i]);
+        else if (arg == "--depth" && i + 1 < argc) config.maxDepth = atoi(argv[++i]);
+        else if (arg == "--frontier" && i + 1 < argc) config.maxFrontier = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--skip" && i + 1 < argc) skipFrames = atoi(argv[++i]);
+        else if (arg == "--ipf" && i + 1 < argc) config.instructionsPerFrame = atoi(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc) config.threads = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--per-frame") config.perInstruction = false;
+    }
+
+    if (!goal.hasCondition && !goal.hasFrameHash) {
+        cerr << "Give a goal with --goal, --frame-hash or both" << endl;
+        return 1;
+    }
+    if (config.holdFrames <= 0 || config.instructionsPerFrame <= 0 || config.maxFrontier == 0) {
+        cerr << "--hold, --ipf and --frontier must be positive integers" << endl;
+        return 1;
+    }
+
+    // Every step tries releasing all keys and pressing each listed key alone
+    config.actions.push_back(0);
+    for (char digit : keys) {
+        size_t key = string("0123456789ABCDEF").find(char(toupper(digit)));
+        if (key == string::npos) {
+            cerr << "--keys takes hex digits, e.g. 456" << endl;
+            return 1;
+        }
+        config.actions.push_back(uint16_t(1 << key));
+    }
+
+    return withQuirks(cpShift, scJump, cosmacMem, [&](auto quirks) {
+        return search<decltype(quirks)>(rom, skipFrames, config, goal);
+    });
+}
@@ -0,0 +1,447 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "Emulator.h"
+#include "Trace.h"
+#include "WorkerPool.h"
+#include "protocol.h"
+using namespace std;
+
+/**
+ * Multi-session CHIP-8 server
+ *
+ * Hosts many headless sessions on one box. Viewers connect over a Unix domain
+ * socket, start a session by sending a ROM (see protocol.h), send key events
+ * and receive the rows of the display that changed each frame, together with
+ * the timers.
+ *
+ * One thread runs an epoll loop over the sockets. Every 1/60 s it hands all
+ * sessions to a fixed worker pool, which runs one frame per session, encodes
+ * the delta and writes it to the socket without blocking. Sockets are only
+ * touched by the workers while the epoll thread waits for the frame to finish.
+ */
+
+static TranslationCache* translations; // Set by --predecode
+
+static size_t const MAX_PENDING_OUTPUT = 64 * 1024; // Frames are skipped while a viewer is this far behind
+
+/**
+ * One connected viewer and its session
+ */
+struct Connection {
+    int fd;
+    vector<uint8_t> input; // Bytes received but not parsed yet
+    vector<uint8_t> output; // Bytes queued but not sent yet
+    unique_ptr<Emulator> session;
+    uint64_t sentRows[Emulator::HEIGHT]{}; // Display as of the last queued FRAME
+    bool sentAny = false;
+    uint32_t frame = 0;
+    bool dead = false;
+};
+
+/**
+ * Counters for one worker, padded so workers never share a cache line
+ */
+struct alignas(64) WorkerStats {
+    uint64_t cpuNanoseconds = 0;
+    uint64_t sessionFrames = 0;
+    uint64_t bytesQueued = 0;
+    uint64_t skippedFrames = 0;
+};
+
+static uint64_t threadCpuNanoseconds() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return uint64_t(now.tv_sec) * 1000000000ull + now.tv_nsec;
+}
+
+static void appendMessage(vector<uint8_t>& out, uint8_t type, void const* payload, size_t length) {
+    MessageHeader header{type, 0, uint16_t(length)};
+    uint8_t const* bytes = reinterpret_cast<uint8_t const*>(&header);
+    out.insert(out.end(), bytes, bytes + sizeof(header));
+    bytes = reinterpret_cast<uint8_t const*>(payload);
+    out.insert(out.end(), bytes, bytes + length);
+}
+
+/**
+ * Send as much queued output as the socket takes without blocking
+ * @return False if the connection is broken
+ */
+static bool flush(Connection& connection) {
+    size_t sent = 0;
+    while (sent < connection.output.size()) {
+        ssize_t n = send(connection.fd, connection.output.data() + sent, connection.output.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        sent += n;
+    }
+    connection.output.erase(connection.output.begin(), connection.output.begin() + sent);
+    return true;
+}
+
+/**
+ * Run one frame of a session and queue the rows that changed
+ */
+static void step(Connection& connection, WorkerStats& stats) {
+    uint64_t start = threadCpuNanoseconds();
+    Emulator& session = *connection.session;
+    session.runFrame();
+
+    if (connection.output.size() > MAX_PENDING_OUTPUT) {
+        // The next FRAME will carry every change since the last queued one
+        stats.skippedFrames++;
+    }
+    else {
+        uint8_t payload[sizeof(FrameMessage) + Emulator::HEIGHT * 8];
+        FrameMessage message{connection.frame, 0, session.delayTimer(), session.soundTimer()};
+        size_t length = sizeof(FrameMessage);
+        for (int y = 0; y < Emulator::HEIGHT; y++) {
+            uint64_t bits = session.row(y);
+            if (!connection.sentAny || bits != connection.sentRows[y]) {
+                message.rowMask |= 1u << y;
+                connection.sentRows[y] = bits;
+                memcpy(payload + length, &bits, 8);
+                length += 8;
+            }
+        }
+        memcpy(payload, &message, sizeof(message));
+        appendMessage(connection.output, MSG_FRAME, payload, length);
+        connection.sentAny = true;
+        stats.bytesQueued += sizeof(MessageHeader) + length;
+    }
+    connection.frame++;
+
+    if (!flush(connection)) {
+        connection.dead = true;
+    }
+    stats.sessionFrames++;
+    stats.cpuNanoseconds += threadCpuNanoseconds() - start;
+}
+
+/**
+ * Send an error to a viewer and mark the connection for closing
+ */
+static void fail(Connection& connection, string const& reason) {
+    appendMessage(connection.output, MSG_ERROR, reason.data(), reason.size());
+    flush(connection);
+    connection.dead = true;
+}
+
+/**
+ * Parse every complete message in the input buffer
+ */
+static void handleInput(Connection& connection) {
+    size_t offset = 0;
+    while (!connection.dead && connection.input.size() - offset >= sizeof(MessageHeader)) {
+        MessageHeader header;
+        memcpy(&header, connection.input.data() + offset, sizeof(header));
+        if (connection.input.size() - offset < sizeof(header) + header.length) {
+            break;
+        }
+        uint8_t const* payload = connection.input.data() + offset + sizeof(header);
+        offset += sizeof(header) + header.length;
+
+        if (header.type == MSG_START) {
+            if (connection.session || header.length < sizeof(StartMessage)) {
+                fail(connection, "malformed START");
+                break;
+            }
+            StartMessage start;
+            memcpy(&start, payload, sizeof(start));
+            EmulatorConfig config;
+            config.cpShift = start.flags & START_CP_SHIFT;
+            config.scJump = start.flags & START_SC_JUMP;
+            config.cosmacMem = start.flags & START_COSMAC_MEM;
+            config.vipTiming = start.flags & START_VIP_TIMING;
+            config.speed = start.speed ? start.speed : 700;
+            config.translations = translations;
+            connection.session = makeEmulator(config);
+            if (!connection.session->loadRom(payload + sizeof(start), header.length - sizeof(start))) {
+                connection.session.reset();
+                fail(connection, "ROM too large");
+            }
+        }
+        else if (header.type == MSG_KEY && header.length == sizeof(KeyMessage) && connection.session) {
+            KeyMessage key;
+            memcpy(&key, payload, sizeof(key));
+            connection.session->setKey(key.key, key.pressed);
+        }
+        else {
+            fail(connection, "unexpected message");
+        }
+    }
+    connection.input.erase(connection.input.begin(), connection.input.begin() + offset);
+}
+
+/**
+ * Read everything available on a socket
+ * @return False if the peer closed the connection or the socket failed
+ */
+static bool readAll(Connection& connection) {
+    uint8_t buffer[16384];
+    while (true) {
+        ssize_t n = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            connection.input.insert(connection.input.end(), buffer, buffer + n);
+            if (connection.input.size() > size_t(4 * MAX_MESSAGE)) {
+                return false;
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        return false;
+    }
+}
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop(int) {
+    stopRequested = 1;
+}
+
+int main(int argc, char* argv[]) {
+    string socketPath = CHIP8_SOCKET_PATH;
+    size_t workers = 0;
+    double statsInterval = 5.0;
+    string tracePath;
+    string traceCategories = "draw,frame";
+    bool predecode = false;
+    string translationDirectory;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "--socket" && i + 1 < argc) {
+            socketPath = argv[++i];
+        }
+
+        if (arg == "--workers" && i + 1 < argc) {
+            workers = atoi(argv[++i]);
+        }
+
+        if (arg == "--stats" && i + 1 < argc) {
+            statsInterval = atof(argv[++i]);
+        }
+
+        if (arg == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+        }
+
+        if (arg == "--trace_categories" && i + 1 < argc) {
+            traceCategories = argv[++i];
+        }
+
+        if (arg == "--predecode") {
+            predecode = true;
+        }
+
+        if (arg == "--translation_cache" && i + 1 < argc) {
+            translationDirectory = argv[++i];
+            predecode = true;
+        }
+    }
+
+    // Sessions of the same ROM share one translation, and a restarted server maps the stored ones
+    unique_ptr<TranslationCache> cache;
+    if (predecode) {
+        cache = make_unique<TranslationCache>(translationDirectory);
+        translations = cache.get();
+    }
+
+    // Every worker thread traces into its own ring
+    if (!tracePath.empty()) {
+        uint8_t categories = Trace::parseCategories(traceCategories);
+        if (!categories) {
+            cerr << "--trace_categories takes a list of instruction, draw, frame, input or all" << endl;
+            return 1;
+        }
+        if (!Trace::start(tracePath, categories)) {
+            return 1;
+        }
+    }
+
+    signal(SIGINT, requestStop);
+    signal(SIGTERM, requestStop);
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (listener < 0 || socketPath.size() >= sizeof(address.sun_path)) {
+        cerr << "Unable to create socket " << socketPath << endl;
+        return 1;
+    }
+    strcpy(address.sun_path, socketPath.c_str());
+    unlink(socketPath.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listener, SOMAXCONN) < 0) {
+        cerr << "Unable to listen on " << socketPath << ": " << strerror(errno) << endl;
+        return 1;
+    }
+
+    int epoll = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listener;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event);
+
+    WorkerPool pool(workers);
+    vector<WorkerStats> stats(pool.size());
+    unordered_map<int, unique_ptr<Connection>> connections;
+    vector<Connection*> active;
+
+    cout << "Listening on " << socketPath << " with " << pool.size() << " workers";
+    if (translations) {
+        string directory = translationDirectory.empty() ? TranslationCache::defaultDirectory() : translationDirectory;
+        cout << ", predecoded, translations in " << (directory.empty() ? "memory only" : directory);
+    }
+    cout << endl;
+
+    auto const framePeriod = chrono::nanoseconds(1000000000 / 60);
+    auto nextFrame = chrono::steady_clock::now() + framePeriod;
+    auto nextStats = chrono::steady_clock::now() + chrono::duration_cast<chrono::nanoseconds>(chrono::duration<double>(statsInterval));
+    auto statsStart = chrono::steady_clock::now();
+    chrono::nanoseconds frameWall{0};
+    uint64_t ticks = 0;
+    uint64_t lateTicks = 0;
+    size_t peakSessions = 0;
+
+    auto closeConnection = [&](int fd) {
+        epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        connections.erase(fd);
+    };
+
+    epoll_event events[256];
+    while (!stopRequested) {
+        auto now = chrono::steady_clock::now();
+        int timeout = now < nextFrame ? int(chrono::duration_cast<chrono::milliseconds>(nextFrame - now).count()) : 0;
+        int ready = epoll_wait(epoll, events, 256, timeout);
+
+        for (int e = 0; e < ready; e++) {
+            int fd = events[e].data.fd;
+            if (fd == listener) {
+                int client;
+                while ((client = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    auto connection = make_unique<Connection>();
+                    connection->fd = client;
+                    epoll_event clientEvent{};
+                    clientEvent.events = EPOLLIN | EPOLLRDHUP;
+                    clientEvent.data.fd = client;
+                    epoll_ctl(epoll, EPOLL_CTL_ADD, client, &clientEvent);
+                    connections[client] = move(connection);
+                }
+                continue;
+            }
+
+            auto found = connections.find(fd);
+            if (found == connections.end()) {
+                continue;
+            }
+            Connection& connection = *found->second;
+            bool open = readAll(connection);
+            handleInput(connection);
+            if (!open || connection.dead || (events[e].events & (EPOLLHUP | EPOLLERR))) {
+                closeConnection(fd);
+            }
+        }
+
+        now = chrono::steady_clock::now();
+        if (now >= nextFrame) {
+            active.clear();
+            for (auto& entry : connections) {
+                if (entry.second->session) {
+                    active.push_back(entry.second.get());
+                }
+            }
+            peakSessions = max(peakSessions, active.size());
+
+            pool.parallelFor(active.size(), [&](size_t item, size_t worker) {
+                step(*active[item], stats[worker]);
+            });
+            auto finished = chrono::steady_clock::now();
+            frameWall += finished - now;
+            ticks++;
+
+            for (Connection* connection : active) {
+                if (connection->dead) {
+                    closeConnection(connection->fd);
+                }
+            }
+
+            // Never queue up a backlog of frames after a stall
+            nextFrame += framePeriod;
+            if (finished > nextFrame) {
+                lateTicks++;
+                nextFrame = finished + framePeriod;
+            }
+        }
+
+        if (now >= nextStats) {
+            WorkerStats total;
+            for (WorkerStats& worker : stats) {
+                total.cpuNanoseconds += worker.cpuNanoseconds;
+                total.sessionFrames += worker.sessionFrames;
+                total.bytesQueued += worker.bytesQueued;
+                total.skippedFrames += worker.skippedFrames;
+                worker = WorkerStats();
+            }
+            double seconds = chrono::duration<double>(now - statsStart).count();
+            double wallPerTick = ticks ? chrono::duration<double>(frameWall).count() / ticks : 0;
+            double cpuPerFrame = total.sessionFrames ? total.cpuNanoseconds / 1e3 / total.sessionFrames : 0;
+            // Sessions the pool could step within one frame period at the measured cost
+            double density = cpuPerFrame > 0 ? pool.size() * (1e6 / 60) / cpuPerFrame : 0;
+
+            cout << fixed << setprecision(2)
+                 << "sessions " << active.size() << " (peak " << peakSessions << ")"
+                 << " | ticks " << ticks << ", late " << lateTicks
+                 << " | frame wall " << wallPerTick * 1e3 << " ms"
+                 << " | cpu/session-frame " << cpuPerFrame << " us"
+                 << " | est. capacity " << setprecision(0) << density << " sessions"
+                 << " | out " << setprecision(1) << total.bytesQueued / seconds / 1024 << " KiB/s"
+                 << ", skipped " << total.skippedFrames << endl;
+
+            ticks = 0;
+            lateTicks = 0;
+            frameWall = chrono::nanoseconds(0);
+            statsStart = now;
+            nextStats = now + chrono::duration_cast<chrono::nanoseconds>(chrono::duration<double>(statsInterval));
+        }
+    }
+
+    for (auto& entry : connections) {
+        close(entry.first);
+    }
+    close(listener);
+    close(epoll);
+    unlink(socketPath.c_str());
+    Trace::stop();
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include "chip8.h"
+#include "Terminal.h"
+using namespace std;
+
+/**
+ * Terminal front end
+ *
+ * Runs a ROM at 60 frames per second and draws it in the terminal with
+ * Terminal, for machines without X or SDL, e.g. over SSH. On exit prints the
+ * bytes written per frame and the CPU time used, so the cost of watching a
+ * session is visible. --frames stops after that many frames, which also
+ * allows measuring with stdout redirected.
+ */
+
+struct TermOptions {
+    TerminalCells cells = CELLS_HALF_BLOCK;
+    int speed = 700;
+    bool vipTiming = false;
+    int holdMs = 150;
+    bool bell = false;
+    long frames = 0; // 0 runs until quit
+};
+
+static double cpuSeconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}
+
+template <typename Q>
+int run(vector<uint8_t> const& rom, string const& name, TermOptions const& options) {
+    Chip8<Q> chip8;
+    chip8.loadRom(rom.data(), rom.size());
+    chip8.loadFonts();
+
+    auto const framePeriod = chrono::nanoseconds(1000000000 / 60);
+    auto start = chrono::steady_clock::now();
+    auto nextFrame = start;
+    double cpuStart = cpuSeconds();
+    long frame = 0;
+    uint64_t bytes;
+    uint64_t updates;
+
+    {
+        Terminal terminal(options.cells, options.holdMs, options.bell);
+        terminal.status(name + (terminal.interactive() ? "  (Esc quits)" : ""));
+
+        while (options.frames == 0 || frame < options.frames) {
+            if (terminal.processInput(chip8.keys)) {
+                break;
+            }
+
+            if (options.vipTiming) {
+                chip8.runFrameVip();
+            }
+            else {
+                chip8.runFrame(int((frame + 1) * options.speed / 60 - frame * options.speed / 60));
+            }
+            frame++;
+
+            if (chip8.drawFlag) {
+                terminal.update(chip8.display);
+                chip8.drawFlag = false;
+            }
+            if (chip8.soundTimer > 0) {
+                terminal.startBeep();
+            }
+            else {
+                terminal.stopBeep();
+            }
+
+            nextFrame += framePeriod;
+            this_thread::sleep_until(nextFrame);
+        }
+        bytes = terminal.bytesWritten();
+        updates = terminal.updatesWritten();
+    }
+
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double cpu = cpuSeconds() - cpuStart;
+    cerr << fixed << setprecision(1)
+         << frame << " frames in " << elapsed << " s, " << updates << " redrawn; "
+         << bytes << " bytes written, " << (frame ? double(bytes) / frame : 0) << " per frame; CPU "
+         << 100 * cpu / elapsed << "% of one core" << endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <rom> [--cells half|braille] [--speed 700] [--vip_timing]"
+             << " [--hold-ms 150] [--bell] [--frames N] [--cp_shift] [--sc_jump] [--cosmac_mem]" << endl;
+        return 1;
+    }
+
+    string path = argv[1];
+    bool cpShift = false;
+    bool scJump = false;
+    bool cosmacMem = false;
+    TermOptions options;
+
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "--cp_shift") cpShift = true;
+        else if (arg == "--sc_jump") scJump = true;
+        else if (arg == "--cosmac_mem") cosmacMem = true;
+        else if (arg == "--vip_timing") options.vipTiming = true;
+        else if (arg == "--bell") options.bell = true;
+        else if (arg == "--speed" && i + 1 < argc) options.speed = atoi(argv[++i]);
+        else if (arg == "--hold-ms" && i + 1 < argc) options.holdMs = atoi(argv[++i]);
+        else if (arg == "--frames" && i + 1 < argc) options.frames = atol(argv[++i]);
+        else if (arg == "--cells" && i + 1 < argc) {
+            string cells = argv[++i];
+            if (cells == "half") options.cells = CELLS_HALF_BLOCK;
+            else if (cells == "braille") options.cells = CELLS_BRAILLE;
+            else {
+                cerr << "--cells takes half or braille" << endl;
+                return 1;
+            }
+        }
+    }
+
+    if (options.speed <= 0) {
+        cerr << "--speed must be a positive integer" << endl;
+        return 1;
+    }
+
+    ifstream file{path, ios::binary};
+    vector<uint8_t> rom{istreambuf_iterator<char>(file), istreambuf_iterator<char>()};
+    if (rom.empty()) {
+        cerr << "Unable to read " << path << endl;
+        return 1;
+    }
+
+    string name = path.substr(path.find_last_of('/') + 1);
+    return withQuirks(cpShift, scJump, cosmacMem, [&](auto quirks) {
+        return run<decltype(quirks)>(rom, name, options);
+    });
+}
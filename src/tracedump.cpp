@@ -0,0 +1,135 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include "Disassembler.h"
+#include "Trace.h"
+using namespace std;
+
+/**
+ * Offline decoder for trace files written by Trace
+ *
+ * Prints one line per record, optionally filtered by category and thread,
+ * or with --stats only the number of records per category and thread.
+ */
+
+static char const* categoryName(uint8_t category) {
+    switch (category) {
+        case TRACE_INSTRUCTION: return "INSN";
+        case TRACE_DRAW: return "DRAW";
+        case TRACE_FRAME: return "FRAME";
+        case TRACE_INPUT: return "INPUT";
+        case TRACE_LOST: return "LOST";
+        default: return "?";
+    }
+}
+
+static void printRecord(TraceRecord const& record) {
+    cout << setfill(' ') << setw(14) << fixed << setprecision(6) << record.time / 1e9
+         << " t" << left << setw(3) << record.thread << setw(6) << categoryName(record.category) << right
+         << setfill('0') << hex << uppercase;
+
+    switch (record.category) {
+        case TRACE_INSTRUCTION: {
+            string text = disassemble(record.opcode);
+            cout << setw(3) << record.pc << " " << setw(4) << record.opcode << "  "
+                 << text << string(text.size() < 18 ? 18 - text.size() : 1, ' ');
+            for (int r = 0; r < 16; r++) {
+                if (record.changed & (1 << r)) {
+                    cout << " V" << r << "=" << setw(2) << int(record.data[r]);
+                }
+            }
+            cout << " I=" << setw(3) << record.I;
+            break;
+        }
+
+        case TRACE_DRAW:
+            cout << setw(3) << record.pc << " " << setw(4) << record.opcode << dec
+                 << "  x=" << int(record.data[0]) << " y=" << int(record.data[1])
+                 << " n=" << int(record.data[2]) << " collision=" << int(record.data[3]);
+            break;
+
+        case TRACE_FRAME:
+            cout << setw(3) << record.pc << dec << "  DT=" << int(record.data[0]) << " ST=" << int(record.data[1]);
+            break;
+
+        case TRACE_INPUT:
+            cout << "key " << int(record.data[0]) << (record.data[1] ? " down" : " up");
+            break;
+
+        case TRACE_LOST: {
+            uint32_t count;
+            memcpy(&count, record.data, sizeof(count));
+            cout << dec << count << " records dropped, ring full";
+            break;
+        }
+    }
+    cout << dec << nouppercase << endl;
+}
+
+int main(int argc, char* argv[]) {
+    string path;
+    uint8_t categories = 0xFF;
+    long thread = -1;
+    bool stats = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "--categories" && i + 1 < argc) categories = Trace::parseCategories(argv[++i]) | TRACE_LOST;
+        else if (arg == "--thread" && i + 1 < argc) thread = atol(argv[++i]);
+        else if (arg == "--stats") stats = true;
+        else path = arg;
+    }
+
+    if (path.empty()) {
+        cerr << "Usage: " << argv[0] << " <trace> [--categories instruction,draw,frame,input] [--thread N] [--stats]" << endl;
+        return 1;
+    }
+
+    FILE* file = fopen(path.c_str(), "rb");
+    uint8_t header[16];
+    if (!file || fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, "C8TRACE", 8) != 0) {
+        cerr << "Not a trace file: " << path << endl;
+        return 1;
+    }
+    uint16_t version;
+    uint16_t recordSize;
+    uint16_t orderMark;
+    memcpy(&version, header + 8, 2);
+    memcpy(&recordSize, header + 10, 2);
+    memcpy(&orderMark, header + 12, 2);
+    if (orderMark != Trace::ORDER_MARK) {
+        cerr << "Trace written on a host of another byte order: " << path << endl;
+        return 1;
+    }
+    if (version != Trace::VERSION || recordSize != sizeof(TraceRecord)) {
+        cerr << "Unsupported trace version " << version << " with " << recordSize << " byte records" << endl;
+        return 1;
+    }
+
+    map<pair<uint16_t, uint8_t>, uint64_t> counts;
+    TraceRecord record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (!(record.category & categories) || (thread >= 0 && record.thread != thread)) {
+            continue;
+        }
+        if (stats) {
+            counts[{record.thread, record.category}]++;
+        }
+        else {
+            printRecord(record);
+        }
+    }
+    fclose(file);
+
+    for (auto const& entry : counts) {
+        cout << "thread " << entry.first.first << " " << left << setw(6) << categoryName(entry.first.second) << right
+             << " " << entry.second << endl;
+    }
+    return 0;
+}